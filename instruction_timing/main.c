@@ -1,138 +1,151 @@
 #include "ch32fun.h"
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
 
-// Include the test instruction definitions
-// #include "test_instructions.h"
-
-// #define TEST_INSTR "nop\nnop\nnop\nnop"
-// #define TEST_INSTR "nop\nnop\nnop\nnop\nnop\nnop\nnop\nnop"
-// #define TEST_INSTR "nop\nnop"
-// #define TEST_INSTR "nop\nnop\nnop"
-// #define TEST_INSTR "nop"
-// #define TEST_INSTR ""
-// 32 bit NOP instruction
-// #define TEST_INSTR "mv x0,x0"
-#define TEST_INSTR "mv x0,x0\nmv x0,x0"
-// #define TEST_INSTR "mv x0,x0\nmv x0,x0\nmv x0,x0\nmv x0,x0\nmv x0,x0\nmv x0,x0\nmv x0,x0\nmv x0,x0"
-// store
-// #define TEST_INSTR "sw %[val_to_store], 0(%[addr_reg])"
-// #define TEST_INSTR "sw %[val_to_store], 0(%[addr_reg])\nsw %[val_to_store], 0(%[addr_reg])"
-// #define TEST_INSTR "sw %[val_to_store], 0(%[addr_reg])\nsw %[val_to_store], 0(%[addr_reg])\nsw %[val_to_store], 0(%[addr_reg])"
-// #define TEST_INSTR "sw %[val_to_store], 0(%[addr_reg])\nsw %[val_to_store], 0(%[addr_reg])\nsw %[val_to_store], 0(%[addr_reg])\nsw %[val_to_store], 0(%[addr_reg])"
-// #define TEST_INSTR "sw %[val_to_store], 0(%[addr_reg])\nsw %[val_to_store], 0(%[addr_reg])\nsw %[val_to_store], 0(%[addr_reg])\nsw %[val_to_store], 0(%[addr_reg])\nsw %[val_to_store], 0(%[addr_reg])\nsw %[val_to_store], 0(%[addr_reg])\nsw %[val_to_store], 0(%[addr_reg])\nsw %[val_to_store], 0(%[addr_reg])"
-
-// IO access
-// #define TEST_INSTR "sw %[val_to_store], 0(%[addr_reg])"
-
-// Helper macro to calculate elapsed cycles with wraparound handling
-#define CALC_ELAPSED_CYCLES(start, end) ((end >= start) ? (end - start) : ((0xFFFFFFFF - start) + end + 1))
-
-#define TEST_COUNT_3  10000
+// The table of tests
+#include "test_instructions.h"
+
+#define TEST_COUNT  10000
+#define SCALE_FACTOR 1000  // For 3 decimal places
 
 // ============================================================================
-// Pure assembly test functions to eliminate compiler-generated overhead
+// Pure assembly test bodies to eliminate compiler-generated overhead
+//
+// test_body_<name>_<n>(count, &SysTick->CNT, io, value, ram) runs the loop
+// and returns the elapsed cycles. The body only uses registers and relative
+// branches, so it runs unchanged from any address: the SRAM variant copies
+// the code between the body label and its _end label into sram_code.
 // ============================================================================
 
-// Flash version of test
-__attribute__((noinline))
-uint32_t run_test_flash(uint32_t count) {
-    uint32_t start, end;
-    volatile uint32_t value_to_store = 0x00010000; // Value to store (e.g., reset PD0)
-    volatile uint32_t *ptr_to_target = (volatile uint32_t *)&GPIOD->BCR;
-
-    // Get start time directly from SysTick->CNT
-    start = SysTick->CNT;
-    
-    asm volatile (
-        ".balign 4\n"                    // Align to 4-byte boundary
-        // "nop\n"
-        // Loop with count iterations
-        "1:\n"                           // Loop start label
-        TEST_INSTR "\n"                  // The instruction(s) being tested
-        "addi %[count], %[count], -1\n"  // Decrement counter
-        "bnez %[count], 1b\n"            // Branch to 1b if count is not zero
-        
-        : [count] "+r" (count)
-        : [val_to_store] "r" (value_to_store), [addr_reg] "r" (ptr_to_target)
-        : "memory"
-    );
-    
-    // Get end time directly from SysTick->CNT
-    end = SysTick->CNT;
-    
-    return CALC_ELAPSED_CYCLES(start, end);
+typedef uint32_t (*test_body_fn)(uint32_t count, volatile uint32_t *systick_cnt, volatile uint32_t *io,
+                                 uint32_t value, volatile uint32_t *ram);
+
+#define TEST_BODY(name, n, instr) \
+    asm(".section .text.test_body_" #name "_" #n ",\"ax\",@progbits\n" \
+        ".balign 4\n" \
+        ".global test_body_" #name "_" #n "\n" \
+        "test_body_" #name "_" #n ":\n" \
+        "lw a5, 0(a1)\n"                    /* start time */ \
+        ".balign 4\n"                       /* Align to 4-byte boundary */ \
+        "1:\n"                              /* Loop start label */ \
+        REPEAT_##n(instr)                   /* The instruction(s) being tested */ \
+        "addi a0, a0, -1\n"                 /* Decrement counter */ \
+        "bnez a0, 1b\n"                     /* Branch to 1b if count is not zero */ \
+        "lw t0, 0(a1)\n"                    /* end time */ \
+        "sub a0, t0, a5\n" \
+        "ret\n" \
+        ".global test_body_" #name "_" #n "_end\n" \
+        "test_body_" #name "_" #n "_end:\n" \
+        ".previous\n");
+
+TIMING_TESTS(TEST_BODY)
+
+static uint32_t sram_code[32];          // SRAM copy of the test body being run
+static volatile uint32_t ram_word;      // target of the SRAM loads and stores
+
+static uint32_t run_body(test_body_fn body, uint32_t count) {
+    return body(count, (volatile uint32_t *)&SysTick->CNT, (volatile uint32_t *)&GPIOD->BCR, 0x00010000, &ram_word);
+}
+
+static uint32_t run_in_sram(test_body_fn body, const uint8_t *end, uint32_t count) {
+    uint32_t size = end - (const uint8_t *)body;
+
+    if (size > sizeof(sram_code)) {
+        return 0;
+    }
+    memcpy(sram_code, (const void *)body, size);
+    asm volatile("" ::: "memory");     // no instruction cache, the copy is visible right away
+    return run_body((test_body_fn)(void *)sram_code, count);
+}
+
+// Paired entry points: the body in place in flash, or copied to SRAM
+#define TEST_FUNCTIONS(name, n, instr) \
+    uint32_t test_body_##name##_##n(uint32_t, volatile uint32_t *, volatile uint32_t *, uint32_t, volatile uint32_t *); \
+    extern const uint8_t test_body_##name##_##n##_end[]; \
+    __attribute__((noinline)) uint32_t run_test_flash_##name##_##n(uint32_t count) { \
+        return run_body(test_body_##name##_##n, count); \
+    } \
+    __attribute__((noinline)) uint32_t run_test_sram_##name##_##n(uint32_t count) { \
+        return run_in_sram(test_body_##name##_##n, test_body_##name##_##n##_end, count); \
+    }
+
+TIMING_TESTS(TEST_FUNCTIONS)
+
+typedef struct {
+    const char *name;
+    const char *instr;
+    uint8_t repeat;
+    uint32_t (*flash)(uint32_t count);
+    uint32_t (*sram)(uint32_t count);
+} timing_test_t;
+
+#define TEST_ENTRY(name, n, instr) {#name, instr, n, run_test_flash_##name##_##n, run_test_sram_##name##_##n},
+
+static const timing_test_t tests[] = {
+    TIMING_TESTS(TEST_ENTRY)
+};
+
+// Print value / SCALE_FACTOR with 3 decimals
+static void print_fixed(int32_t scaled) {
+    printf("%s%ld.%03ld", (scaled < 0 && (scaled / SCALE_FACTOR) == 0) ? "-" : "", scaled / SCALE_FACTOR,
+           (scaled % SCALE_FACTOR) < 0 ? -(scaled % SCALE_FACTOR) : (scaled % SCALE_FACTOR));
 }
 
-// SRAM version of test (placed in SRAM)
-__attribute__((section(".srodata"))) __attribute__((used)) __attribute__((noinline))
-uint32_t run_test_sram(uint32_t count) {
-    uint32_t start, end;
-    volatile uint32_t value_to_store = 0x00010000; // Value to store (e.g., reset PD0)
-    volatile uint32_t *ptr_to_target = (volatile uint32_t *)&GPIOD->BCR;
-
-    // Get start time directly from SysTick->CNT
-    start = SysTick->CNT;
-    
-    asm volatile (
-        ".balign 4\n"                    // Align to 4-byte boundary
-        // "nop\n"
-        // Loop with count iterations
-        "1:\n"                           // Loop start label
-        TEST_INSTR "\n"                  // The instruction(s) being tested
-        "addi %[count], %[count], -1\n"  // Decrement counter
-        "bnez %[count], 1b\n"            // Branch to 1b if count is not zero
-        
-        : [count] "+r" (count)
-        : [val_to_store] "r" (value_to_store), [addr_reg] "r" (ptr_to_target)
-        : "memory"
-    );
-    
-    // Get end time directly from SysTick->CNT
-    end = SysTick->CNT;
-    
-    return CALC_ELAPSED_CYCLES(start, end);
+static int32_t per_iteration(int32_t cycles) {
+    return (int32_t)(((int64_t)cycles * SCALE_FACTOR) / TEST_COUNT);
 }
 
-// Run timing tests for both Flash and SRAM
+// Run every test from flash and SRAM and print one CSV line per test
 void run_instruction_timing_tests(void) {
-    uint32_t cycles_flash_3;
-    uint32_t cycles_sram_3;
-    const int32_t SCALE_FACTOR = 1000; // For 3 decimal places
-    
+    uint32_t base_flash = tests[0].flash(TEST_COUNT);
+    uint32_t base_sram = tests[0].sram(TEST_COUNT);
+
     printf("\n--- Instruction Timing Tests ---\n");
     printf("System Clock: %d MHz\n", FUNCONF_SYSTEM_CORE_CLOCK / 1000000);
-    printf("Testing instruction: %s\n\n", TEST_INSTR);
     printf("Flash Wait States: %ld\n", FLASH->ACTLR & FLASH_ACTLR_LATENCY);
-    
-    printf("Running Flash tests...\n");
-           
-    cycles_flash_3 = run_test_flash(TEST_COUNT_3);
-    int32_t cf3_scaled = (int32_t)(((int64_t)cycles_flash_3 * SCALE_FACTOR) / TEST_COUNT_3);
-    printf("Flash test with %d iterations: %lu cycles (%s%ld.%03ld cycles/iteration)\n", 
-           TEST_COUNT_3, cycles_flash_3, (cf3_scaled < 0 && (cf3_scaled/SCALE_FACTOR)==0)?"-":"", cf3_scaled/SCALE_FACTOR, (cf3_scaled%SCALE_FACTOR)<0?-(cf3_scaled%SCALE_FACTOR):(cf3_scaled%SCALE_FACTOR));
-    
-    printf("\nRunning SRAM tests...\n");   
-          
-    cycles_sram_3 = run_test_sram(TEST_COUNT_3);
-    int32_t cs3_scaled = (int32_t)(((int64_t)cycles_sram_3 * SCALE_FACTOR) / TEST_COUNT_3);
-    printf("SRAM test with %d iterations: %lu cycles (%s%ld.%03ld cycles/iteration)\n", 
-           TEST_COUNT_3, cycles_sram_3, (cs3_scaled < 0 && (cs3_scaled/SCALE_FACTOR)==0)?"-":"", cs3_scaled/SCALE_FACTOR, (cs3_scaled%SCALE_FACTOR)<0?-(cs3_scaled%SCALE_FACTOR):(cs3_scaled%SCALE_FACTOR));
-    
+    printf("Iterations per test: %d\n\n", TEST_COUNT);
+
+    printf("name,repeat,instruction,flash_cycles,sram_cycles,flash_per_iteration,sram_per_iteration,flash_added,sram_added\n");
+    for (uint32_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+        const timing_test_t *t = &tests[i];
+        uint32_t flash = t->flash(TEST_COUNT);
+        uint32_t sram = t->sram(TEST_COUNT);
+
+        printf("%s,%d,\"", t->name, t->repeat);
+        for (const char *c = t->instr; *c; c++) {
+            if (*c == '\n') {
+                printf("; ");
+            } else {
+                printf("%c", *c);
+            }
+        }
+        printf("\",%lu,%lu,", flash, sram);
+        print_fixed(per_iteration(flash));
+        printf(",");
+        print_fixed(per_iteration(sram));
+        printf(",");
+        print_fixed(per_iteration((int32_t)(flash - base_flash)));
+        printf(",");
+        if (sram) {
+            print_fixed(per_iteration((int32_t)(sram - base_sram)));
+        }
+        printf("\n");
+    }
 }
 
 int main() {
     SystemInit();
-    
+
     printf("\nCH32V003 Instruction Timing Test\n");
     printf("================================\n");
-    
+
     run_instruction_timing_tests();
-    
+
     while (1) {
         Delay_Ms(1000);
         printf(".");
     }
-    
+
     return 0;
-}
\ No newline at end of file
+}
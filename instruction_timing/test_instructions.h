@@ -1,49 +1,51 @@
 #ifndef TEST_INSTRUCTIONS_H
 #define TEST_INSTRUCTIONS_H
 
-/* 
- * This file contains different instruction test definitions.
- * To test a different instruction or sequence, uncomment one of
- * these definitions and recompile.
+/*
+ * Table of instruction sequences to time.
+ *
+ * TIMING_TESTS(X) calls X(name, repeat, instruction) once for every test.
+ * main.c expands it into a pair of functions per entry,
+ * run_test_flash_<name>_<repeat>() and run_test_sram_<name>_<repeat>(), that
+ * execute the instruction 'repeat' times inside the counting loop. The
+ * baseline entry is the empty loop and is subtracted from all results.
+ *
+ * Registers available to the instructions:
+ *   a2 = &GPIOD->BCR, a3 = 0x00010000 (store value, resets PD0)
+ *   a4 = pointer to a word in SRAM
+ *   t0, t1, t2 = scratch
+ * a0 (loop counter), a1 and a5 (SysTick) must not be touched. Local labels
+ * have to use numbers other than 1.
+ *
+ * To add a test, add a TIMING_SWEEP() line (repeats 1..8) or a single X().
  */
 
-// Basic instruction tests
-// #define TEST_INSTR "nop"                         // No operation
-// #define TEST_INSTR "addi t0, t0, 1"             // Register-immediate addition
-// #define TEST_INSTR "add t0, t0, t1"              // Register-register addition
-// #define TEST_INSTR "sub t0, t0, t1"              // Register-register subtraction
-// #define TEST_INSTR "and t0, t0, t1"              // Bitwise AND
-// #define TEST_INSTR "or t0, t0, t1"               // Bitwise OR
-// #define TEST_INSTR "xor t0, t0, t1"              // Bitwise XOR
-// #define TEST_INSTR "slli t0, t0, 1"              // Shift Left Logical Immediate
-// #define TEST_INSTR "srli t0, t0, 1"              // Shift Right Logical Immediate
-// #define TEST_INSTR "srai t0, t0, 1"              // Shift Right Arithmetic Immediate
+#define TIMING_SWEEP(X, name, instr) \
+    X(name, 1, instr) X(name, 2, instr) X(name, 3, instr) X(name, 4, instr) \
+    X(name, 5, instr) X(name, 6, instr) X(name, 7, instr) X(name, 8, instr)
 
-// Memory operation tests
-// #define TEST_INSTR "lw t0, 0(t1)"                // Load Word
-// #define TEST_INSTR "sw t0, 0(t1)"                // Store Word
-// #define TEST_INSTR "lb t0, 0(t1)"                // Load Byte
-// #define TEST_INSTR "lbu t0, 0(t1)"               // Load Byte Unsigned
-// #define TEST_INSTR "sb t0, 0(t1)"                // Store Byte
-// #define TEST_INSTR "lh t0, 0(t1)"                // Load Halfword
-// #define TEST_INSTR "lhu t0, 0(t1)"               // Load Halfword Unsigned
-// #define TEST_INSTR "sh t0, 0(t1)"                // Store Halfword
+#define TIMING_TESTS(X) \
+    X(baseline, 0, "") \
+    TIMING_SWEEP(X, nop16,     "nop")                   /* 16 bit NOP */ \
+    TIMING_SWEEP(X, nop32,     ".4byte 0x00000013")     /* 32 bit NOP, never compressed */ \
+    TIMING_SWEEP(X, add,       "add t0, t0, t1")        /* register-register ALU */ \
+    TIMING_SWEEP(X, sw_gpio,   "sw a3, 0(a2)")          /* 16 bit store to GPIO */ \
+    TIMING_SWEEP(X, lw_gpio,   "lw t0, 0(a2)")          /* load from GPIO */ \
+    TIMING_SWEEP(X, sw_sram,   "sw a3, 0(a4)")          /* store to SRAM */ \
+    TIMING_SWEEP(X, lw_sram,   "lw t0, 0(a4)")          /* load from SRAM */ \
+    TIMING_SWEEP(X, jump,      "j 2f\n2:")              /* jump to the next instruction */ \
+    TIMING_SWEEP(X, bnez_nt,   "bnez x0, 2f\n2:")       /* branch not taken */ \
+    TIMING_SWEEP(X, beqz_t,    "beqz x0, 2f\n2:")       /* branch taken */
 
-// Control flow tests
-// #define TEST_INSTR "j 1f\n1:"                    // Jump
-// #define TEST_INSTR "beq t0, t1, 1f\n1:"          // Branch if equal
-// #define TEST_INSTR "bne t0, t1, 1f\n1:"          // Branch if not equal
-// #define TEST_INSTR "blt t0, t1, 1f\n1:"          // Branch if less than
-// #define TEST_INSTR "bge t0, t1, 1f\n1:"          // Branch if greater or equal
+// Assembler source for 'instr' repeated n times
+#define REPEAT_0(instr) ""
+#define REPEAT_1(instr) instr "\n"
+#define REPEAT_2(instr) REPEAT_1(instr) REPEAT_1(instr)
+#define REPEAT_3(instr) REPEAT_2(instr) REPEAT_1(instr)
+#define REPEAT_4(instr) REPEAT_2(instr) REPEAT_2(instr)
+#define REPEAT_5(instr) REPEAT_4(instr) REPEAT_1(instr)
+#define REPEAT_6(instr) REPEAT_4(instr) REPEAT_2(instr)
+#define REPEAT_7(instr) REPEAT_4(instr) REPEAT_3(instr)
+#define REPEAT_8(instr) REPEAT_4(instr) REPEAT_4(instr)
 
-// Instruction sequences for more complex operations
-// #define TEST_INSTR "add t0, t1, t2\nadd t3, t4, t5"  // Two additions
-// #define TEST_INSTR "lw t0, 0(t1)\nsw t0, 0(t2)"      // Load and store sequence
-// #define TEST_INSTR "mul t0, t1, t2"                   // Multiplication (if supported)
-
-// Default test instruction (if none above is selected)
-#ifndef TEST_INSTR
-#define TEST_INSTR "nop"
-#endif
-
-#endif /* TEST_INSTRUCTIONS_H */
\ No newline at end of file
+#endif /* TEST_INSTRUCTIONS_H */
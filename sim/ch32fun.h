@@ -0,0 +1,158 @@
+#ifndef SIM_CH32FUN_H
+#define SIM_CH32FUN_H
+
+// Host stand-in for the ch32fun register block.
+//
+// The firmware sources are compiled as C++ against this header so that every
+// access to a GPIO register turns into a call into the 4164 model (sim4164.c)
+// instead of a memory store. Only the peripherals used by src/ are provided.
+
+#ifndef __cplusplus
+#error "The simulator build compiles the firmware sources as C++ (g++ -x c++)"
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include "funconfig.h"
+
+#define DRAM_SIM 1
+
+#ifndef FUNCONF_SYSTEM_CORE_CLOCK
+#define FUNCONF_SYSTEM_CORE_CLOCK 48000000
+#endif
+
+// The RISC-V interrupt attribute has no meaning on the host (and x86 rejects
+// it for void(void) handlers), so turn it into a harmless one.
+#define interrupt used
+
+// Register identifiers used by the bus model
+enum sim_reg_id {
+    SIM_REG_CFGLR,
+    SIM_REG_INDR,
+    SIM_REG_OUTDR,
+    SIM_REG_BSHR,
+    SIM_REG_BCR,
+    SIM_REG_LCKR,
+    SIM_REG_SYSTICK_CNT,
+    SIM_REG_SYSTICK_CMP,
+};
+
+#define SIM_PORT_A      0
+#define SIM_PORT_C      2
+#define SIM_PORT_D      3
+#define SIM_PORT_SYSTICK 8
+
+extern "C" {
+void sim_bus_write(uint8_t port, uint8_t reg, uint32_t value);
+uint32_t sim_bus_read(uint8_t port, uint8_t reg);
+void sim_delay(uint32_t cycles);
+void SystemInit(void);
+void Delay_Ms(uint32_t ms);
+void Delay_Us(uint32_t us);
+}
+
+// A memory-mapped register whose loads and stores are routed to the model
+struct sim_reg {
+    uint8_t port;
+    uint8_t reg;
+
+    sim_reg &operator=(uint32_t value) { sim_bus_write(port, reg, value); return *this; }
+    sim_reg &operator=(const sim_reg &other) { return *this = (uint32_t)other; }
+    operator uint32_t() const { return sim_bus_read(port, reg); }
+    sim_reg &operator|=(uint32_t value) { return *this = (uint32_t)*this | value; }
+    sim_reg &operator&=(uint32_t value) { return *this = (uint32_t)*this & value; }
+    sim_reg &operator^=(uint32_t value) { return *this = (uint32_t)*this ^ value; }
+};
+
+typedef struct {
+    sim_reg CFGLR;
+    sim_reg INDR;
+    sim_reg OUTDR;
+    sim_reg BSHR;
+    sim_reg BCR;
+    sim_reg LCKR;
+} GPIO_TypeDef;
+
+typedef struct {
+    uint32_t CTLR;
+    uint32_t SR;
+    sim_reg CNT;
+    sim_reg CMP;
+} SysTick_Type;
+
+// Peripherals without a model are plain storage
+typedef struct {
+    volatile uint32_t APB2PCENR;
+    volatile uint32_t APB1PCENR;
+} RCC_TypeDef;
+
+typedef struct {
+    volatile uint32_t CTLR1;
+    volatile uint32_t DMAINTENR;
+    volatile uint32_t INTFR;
+    volatile uint32_t CNT;
+    volatile uint32_t PSC;
+    volatile uint32_t ATRLR;
+} TIM_TypeDef;
+
+typedef struct {
+    volatile uint32_t ACTLR;
+} FLASH_TypeDef;
+
+extern GPIO_TypeDef sim_gpio[4];
+extern SysTick_Type sim_systick;
+extern RCC_TypeDef sim_rcc;
+extern TIM_TypeDef sim_tim1;
+extern FLASH_TypeDef sim_flash;
+
+#define GPIOA   (&sim_gpio[SIM_PORT_A])
+#define GPIOC   (&sim_gpio[SIM_PORT_C])
+#define GPIOD   (&sim_gpio[SIM_PORT_D])
+#define SysTick (&sim_systick)
+#define RCC     (&sim_rcc)
+#define TIM1    (&sim_tim1)
+#define FLASH   (&sim_flash)
+
+#define GPIO_Pin_0 ((uint16_t)0x0001)
+#define GPIO_Pin_1 ((uint16_t)0x0002)
+#define GPIO_Pin_2 ((uint16_t)0x0004)
+#define GPIO_Pin_3 ((uint16_t)0x0008)
+#define GPIO_Pin_4 ((uint16_t)0x0010)
+#define GPIO_Pin_5 ((uint16_t)0x0020)
+#define GPIO_Pin_6 ((uint16_t)0x0040)
+#define GPIO_Pin_7 ((uint16_t)0x0080)
+
+#define RCC_APB2Periph_GPIOA ((uint32_t)0x00000004)
+#define RCC_APB2Periph_GPIOC ((uint32_t)0x00000010)
+#define RCC_APB2Periph_GPIOD ((uint32_t)0x00000020)
+#define RCC_APB2Periph_TIM1  ((uint32_t)0x00000800)
+
+#define TIM_CEN   ((uint16_t)0x0001)
+#define TIM_UIE   ((uint16_t)0x0001)
+#define TIM_CC1IE ((uint16_t)0x0002)
+
+#define SYSTICK_CTLR_STIE (1 << 1)
+#define SYSTICK_SR_CNTIF  (1 << 0)
+
+#define FLASH_ACTLR_LATENCY ((uint32_t)0x00000003)
+
+typedef enum { SysTicK_IRQn = 12, TIM1_UP_IRQn = 35 } IRQn_Type;
+
+extern "C" void sim_nvic_enable(int irq, int enable);
+static inline void NVIC_EnableIRQ(IRQn_Type irq) { sim_nvic_enable(irq, 1); }
+static inline void NVIC_DisableIRQ(IRQn_Type irq) { sim_nvic_enable(irq, 0); }
+
+// Interrupt handlers the model can raise. The TIM1 update and SysTick compare
+// interrupts fire between GPIO accesses, like a real interrupt between
+// instructions.
+void TIM1_UP_IRQHandler(void) __attribute__((weak));
+void SysTick_Handler(void) __attribute__((weak));
+
+// Debug link input. With SIM_CONSOLE set, poll_input() passes stdin to
+// handle_debug_input() in chunks of up to 7 bytes, like the debugger does.
+extern "C" int poll_input(void);
+void handle_debug_input(int numbytes, uint8_t *data) __attribute__((weak));
+static inline void __enable_irq(void) {}
+static inline void __disable_irq(void) {}
+
+#endif // SIM_CH32FUN_H
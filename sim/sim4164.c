@@ -0,0 +1,635 @@
+#include "ch32fun.h"
+#include "dram.h"
+#include "dram_trace.h"
+#include "sim4164.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// 4164 behavioral model
+//
+// Array organisation (matches what the chips in images/ show):
+// - Two banks of 128 rows (row address bit 7), each with its own 256 sense
+//   amplifiers. Rows only share bitlines with rows of the same bank, which is
+//   why dram_copyrow() works inside a bank and not across banks.
+// - Folded bitlines: rows with address bit 6 set sit on the true bitline,
+//   the others on the complement line and therefore store inverted data.
+// - Cells leak towards a physical '1' while powered and read back as a
+//   physical '0' after power-up, giving the striped patterns in
+//   array_after_no_refresh_while_powered.png / array_after_power_down.png.
+//
+// Cell and bitline levels are kept as fractions of VDD. Opening a row shares
+// the cell charge with the bitline, the sense amps latch SIM_T_SENSE cycles
+// later and restore the row. Closing RAS before that (dram_set_row()) leaves
+// the cells at a degraded level; reopening a row before the bitlines are
+// precharged (dram_copyrow()) lets the old bitline levels overwrite the new row.
+// A row whose RAS pulse ended before sensing keeps its wordline up for
+// SIM_T_WL_OFF cycles; opening another row of the bank in that window connects
+// both rows to the bitlines, so the sense amps latch the combined charge
+// (multi-row activation, used for in-array majority).
+//
+// With DRAM_CHIPS > 1 every chip has its own array, bitlines and variation;
+// RAS, CAS, W and the address are shared, so they all follow the same timing.
+
+#define SIM_CHIPS DRAM_CHIPS
+#define SIM_ADDR_PORT DRAM_GPIO_ID(DRAM_ADDR_GPIO)   // ports from the board description
+#define SIM_CTRL_PORT DRAM_GPIO_ID(DRAM_CTRL_GPIO)
+#define SIM_BANKS 2
+#define SIM_CB_CS_RATIO 8.0f    // bitline to cell capacitance
+#define SIM_T_WL_OFF 5          // wordline discharge after an unsensed RAS pulse
+#define SIM_MAX_OPEN 4          // rows that can share the bitlines at once
+
+#define LINE_TRUE 0
+#define LINE_COMP 1
+
+GPIO_TypeDef sim_gpio[4] = {
+    {{0, SIM_REG_CFGLR}, {0, SIM_REG_INDR}, {0, SIM_REG_OUTDR}, {0, SIM_REG_BSHR}, {0, SIM_REG_BCR}, {0, SIM_REG_LCKR}},
+    {{1, SIM_REG_CFGLR}, {1, SIM_REG_INDR}, {1, SIM_REG_OUTDR}, {1, SIM_REG_BSHR}, {1, SIM_REG_BCR}, {1, SIM_REG_LCKR}},
+    {{2, SIM_REG_CFGLR}, {2, SIM_REG_INDR}, {2, SIM_REG_OUTDR}, {2, SIM_REG_BSHR}, {2, SIM_REG_BCR}, {2, SIM_REG_LCKR}},
+    {{3, SIM_REG_CFGLR}, {3, SIM_REG_INDR}, {3, SIM_REG_OUTDR}, {3, SIM_REG_BSHR}, {3, SIM_REG_BCR}, {3, SIM_REG_LCKR}},
+};
+SysTick_Type sim_systick = {0, 0, {SIM_PORT_SYSTICK, SIM_REG_SYSTICK_CNT}, {SIM_PORT_SYSTICK, SIM_REG_SYSTICK_CMP}};
+RCC_TypeDef sim_rcc;
+TIM_TypeDef sim_tim1;
+FLASH_TypeDef sim_flash = {1};
+
+typedef struct {
+    float line[SIM_BANKS][2][SIM_COLS];
+    float cell[SIM_ROWS][SIM_COLS];
+    uint8_t dout;
+
+    // Process variation
+    float tau[SIM_ROWS][SIM_COLS];      // retention time constant, seconds
+    float sense_offset[SIM_COLS];
+    float glitch_keep[SIM_COLS];
+} sim_chip_t;
+
+static struct {
+    int initialized;
+    uint64_t now;
+    uint64_t last_activity;
+    uint64_t idle_exit_cycles;
+    sim_stats_t stats;
+
+    // Pin state
+    uint32_t cfglr[4];
+    uint32_t outdr[4];
+
+    // Chip state
+    uint8_t ras_low;
+    uint8_t sensed;
+    uint8_t row;
+    uint8_t col;
+    uint8_t open_rows[SIM_MAX_OPEN];    // rows connected to the bitlines (sim.row is the last one)
+    uint8_t n_open;
+    uint8_t glitch_pending;             // the last RAS pulse ended before sensing
+    uint64_t t_ras_rise;
+    uint64_t t_ras_fall;
+    uint64_t t_cas_fall;
+    uint64_t t_precharge[SIM_BANKS];
+    uint8_t precharge_pending[SIM_BANKS];
+
+    sim_chip_t chip[SIM_CHIPS];
+    uint64_t t_close[SIM_ROWS];
+    uint64_t t_activated[SIM_ROWS];
+    uint8_t activated[SIM_ROWS];
+
+    // TIM1 update interrupt
+    uint8_t tim1_irq_enabled;
+    uint8_t in_irq;
+    uint64_t tim1_next;
+
+    // SysTick compare interrupt
+    uint8_t systick_irq_enabled;
+    uint32_t systick_cmp;
+    uint64_t systick_match;             // time CNT reaches CMP, 0: not ahead
+} sim;
+
+static uint64_t rng_state;
+
+static uint64_t rng_next(void) {
+    uint64_t z = (rng_state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static float rng_uniform(void) {
+    return (float)((rng_next() >> 40) + 1) / (float)((1ULL << 24) + 1);
+}
+
+static float rng_normal(void) {
+    return sqrtf(-2.0f * logf(rng_uniform())) * cosf(6.2831853f * rng_uniform());
+}
+
+static inline int row_bank(uint8_t row) { return row >> 7; }
+static inline int row_line(uint8_t row) { return (row & 0x40) ? LINE_TRUE : LINE_COMP; }
+
+void sim_reset(uint64_t seed) {
+    memset(&sim, 0, sizeof(sim));
+    rng_state = seed;
+
+    for (int k = 0; k < SIM_CHIPS; k++) {
+        sim_chip_t *ch = &sim.chip[k];
+
+        // Retention: most rows hold data for seconds, a few rows and a
+        // sprinkling of cells are much weaker
+        for (int r = 0; r < SIM_ROWS; r++) {
+            float row_tau = 3.0f * expf(0.4f * rng_normal());
+            if (rng_uniform() < 0.05f) {
+                row_tau *= 0.1f;
+            }
+            for (int c = 0; c < SIM_COLS; c++) {
+                float tau = row_tau * expf(0.25f * rng_normal());
+                if (rng_uniform() < 0.002f) {
+                    tau = 0.02f + 0.2f * rng_uniform();
+                }
+                ch->tau[r][c] = tau;
+            }
+        }
+        for (int c = 0; c < SIM_COLS; c++) {
+            ch->sense_offset[c] = 0.02f * (rng_uniform() - 0.5f);
+            ch->glitch_keep[c] = (rng_uniform() < 0.02f) ? 0.55f + 0.15f * rng_uniform()
+                                                          : 0.05f + 0.35f * rng_uniform();
+        }
+        for (int b = 0; b < SIM_BANKS; b++) {
+            for (int c = 0; c < SIM_COLS; c++) {
+                ch->line[b][LINE_TRUE][c] = 0.5f;
+                ch->line[b][LINE_COMP][c] = 0.5f;
+            }
+        }
+    }
+
+    // Control lines idle high until dram_init() takes over
+    sim.outdr[SIM_CTRL_PORT] = DRAM_RAS_PIN | DRAM_CAS_PIN | DRAM_WR_PIN;
+    sim.idle_exit_cycles = (uint64_t)1000 * (SIM_CLOCK_HZ / 1000);
+    sim.initialized = 1;
+}
+
+static void sim_lazy_init(void) {
+    if (sim.initialized) {
+        return;
+    }
+    const char *seed = getenv("SIM_SEED");
+    sim_reset(seed ? strtoull(seed, NULL, 0) : 4164);
+    const char *idle = getenv("SIM_IDLE_EXIT_MS");
+    if (idle) {
+        sim.idle_exit_cycles = strtoull(idle, NULL, 0) * (SIM_CLOCK_HZ / 1000);
+    }
+}
+
+const sim_stats_t *sim_get_stats(void) {
+    sim.stats.cycles = sim.now;
+    return &sim.stats;
+}
+
+void sim_print_stats(void) {
+    const sim_stats_t *s = sim_get_stats();
+    fprintf(stderr, "[sim] %.3f ms simulated, %u activations, %u CAS cycles (%u reads, %u writes)\n",
+            (double)s->cycles * 1000.0 / SIM_CLOCK_HZ, s->activations, s->cas_cycles, s->reads, s->writes);
+    fprintf(stderr, "[sim] %u RAS glitches, %u multi-row activations, %u short precharges, %u invalid reads, %u tRAS max violations\n",
+            s->glitches, s->multi_activations, s->short_precharges, s->invalid_reads, s->ras_max_violations);
+    fprintf(stderr, "[sim] %u refresh deadline misses, %u interrupts\n", s->refresh_misses, s->interrupts);
+}
+
+// Charge state of a cell after leaking since its row was last closed
+static float cell_level(const sim_chip_t *ch, uint8_t row, uint8_t col, uint64_t t) {
+    float v = ch->cell[row][col];
+    if (v >= 1.0f) {
+        return v;
+    }
+    float dt = (float)(t - sim.t_close[row]) / SIM_CLOCK_HZ;
+    return 1.0f - (1.0f - v) * expf(-dt / ch->tau[row][col]);
+}
+
+uint8_t sim_peek_bit(uint8_t row, uint8_t col) {
+    uint8_t word = 0;
+    sim_lazy_init();
+    for (int k = 0; k < SIM_CHIPS; k++) {
+        uint8_t phys = cell_level(&sim.chip[k], row, col, sim.now) > 0.5f;
+        word |= (row_line(row) == LINE_TRUE ? phys : !phys) << k;
+    }
+    return word;
+}
+
+void sim_poke_bit(uint8_t row, uint8_t col, uint8_t data) {
+    sim_lazy_init();
+    if (sim.ras_low && sim.row == row) {
+        return; // the sense amps own the open row
+    }
+    for (int k = 0; k < SIM_CHIPS; k++) {
+        sim_chip_t *ch = &sim.chip[k];
+        uint8_t bit = (data >> k) & 1;
+        uint8_t phys = row_line(row) == LINE_TRUE ? bit : !bit;
+        for (int c = 0; c < SIM_COLS; c++) {
+            ch->cell[row][c] = cell_level(ch, row, c, sim.now);
+        }
+        ch->cell[row][col] = phys ? 1.0f : 0.0f;
+    }
+    sim.t_close[row] = sim.now;
+}
+
+static void sense(void) {
+    int b = row_bank(sim.row);
+    int l = row_line(sim.row);
+    for (int k = 0; k < SIM_CHIPS; k++) {
+        sim_chip_t *ch = &sim.chip[k];
+        for (int c = 0; c < SIM_COLS; c++) {
+            uint8_t bit = ch->line[b][l][c] - ch->line[b][!l][c] > ch->sense_offset[c];
+            ch->line[b][l][c] = bit;
+            ch->line[b][!l][c] = !bit;
+        }
+        for (int i = 0; i < sim.n_open; i++) {
+            uint8_t r = sim.open_rows[i];
+            for (int c = 0; c < SIM_COLS; c++) {
+                ch->cell[r][c] = ch->line[b][row_line(r)][c];
+            }
+        }
+    }
+    sim.sensed = 1;
+}
+
+static void settle(void) {
+    if (sim.ras_low && !sim.sensed && sim.now - sim.t_ras_fall >= SIM_T_SENSE) {
+        sense();
+    }
+}
+
+// Wordlines of an unsensed RAS pulse went down: the cells are left pulled
+// towards a physical '0'. Longer pulses do less damage.
+static void apply_glitch(void) {
+    float w = (float)(sim.t_ras_rise - sim.t_ras_fall) / SIM_T_SENSE;
+    for (int i = 0; i < sim.n_open; i++) {
+        uint8_t r = sim.open_rows[i];
+        for (int k = 0; k < SIM_CHIPS; k++) {
+            sim_chip_t *ch = &sim.chip[k];
+            for (int c = 0; c < SIM_COLS; c++) {
+                float keep = ch->glitch_keep[c] + (1.0f - ch->glitch_keep[c]) * w * w * w;
+                ch->cell[r][c] *= keep;
+            }
+        }
+        sim.t_close[r] = sim.t_ras_rise;
+    }
+    sim.n_open = 0;
+    sim.glitch_pending = 0;
+}
+
+static void ras_fall(void) {
+    uint8_t row = (uint8_t)sim.outdr[SIM_ADDR_PORT];
+    int b = row_bank(row);
+    int l = row_line(row);
+    int joined = 0;
+
+    if (sim.glitch_pending) {
+        if (sim.now - sim.t_ras_rise <= SIM_T_WL_OFF && row_bank(row) == row_bank(sim.row) &&
+            sim.n_open < SIM_MAX_OPEN) {
+            joined = 1;
+            sim.glitch_pending = 0;
+            sim.precharge_pending[b] = 0; // equalization never started
+            sim.stats.multi_activations++;
+        } else {
+            apply_glitch();
+        }
+    }
+    if (!joined) {
+        sim.n_open = 0;
+    }
+
+    // Finish whatever precharge the bank managed since the last RAS rise
+    if (sim.precharge_pending[b]) {
+        uint64_t dt = sim.now - sim.t_precharge[b];
+        float p = 1.0f;
+        if (dt < SIM_T_RP) {
+            p = (float)dt / SIM_T_RP;
+            sim.stats.short_precharges++;
+        }
+        for (int k = 0; k < SIM_CHIPS; k++) {
+            sim_chip_t *ch = &sim.chip[k];
+            for (int c = 0; c < SIM_COLS; c++) {
+                ch->line[b][LINE_TRUE][c] += (0.5f - ch->line[b][LINE_TRUE][c]) * p;
+                ch->line[b][LINE_COMP][c] += (0.5f - ch->line[b][LINE_COMP][c]) * p;
+            }
+        }
+        sim.precharge_pending[b] = 0;
+    }
+
+    // Charge sharing between the row and its bitlines. Rows that are still
+    // open on the same bitline hold the bitline level and add to its capacitance.
+    float share = SIM_CB_CS_RATIO;
+    for (int i = 0; i < sim.n_open; i++) {
+        if (row_line(sim.open_rows[i]) == l) {
+            share += 1.0f;
+        }
+    }
+    for (int k = 0; k < SIM_CHIPS; k++) {
+        sim_chip_t *ch = &sim.chip[k];
+        for (int c = 0; c < SIM_COLS; c++) {
+            float v = cell_level(ch, row, c, sim.now);
+            float shared = (share * ch->line[b][l][c] + v) / (share + 1.0f);
+            ch->line[b][l][c] = shared;
+            ch->cell[row][c] = shared;
+            for (int i = 0; i < sim.n_open; i++) {
+                if (row_line(sim.open_rows[i]) == l) {
+                    ch->cell[sim.open_rows[i]][c] = shared;
+                }
+            }
+        }
+    }
+    sim.open_rows[sim.n_open++] = row;
+
+    if (sim.activated[row] && sim.now - sim.t_activated[row] > SIM_T_REFRESH) {
+        sim.stats.refresh_misses++;
+    }
+    sim.activated[row] = 1;
+    sim.t_activated[row] = sim.now;
+
+    sim.row = row;
+    sim.ras_low = 1;
+    sim.sensed = 0;
+    sim.t_ras_fall = sim.now;
+    sim.stats.activations++;
+}
+
+static void ras_rise(void) {
+    settle();
+    uint64_t width = sim.now - sim.t_ras_fall;
+    sim.t_ras_rise = sim.now;
+    if (!sim.sensed) {
+        // Wordline closed before the sense amps fired. The damage is done
+        // by apply_glitch() unless another row joins in time.
+        sim.glitch_pending = 1;
+        sim.stats.glitches++;
+    } else {
+        if (width > SIM_T_RAS_MAX) {
+            sim.stats.ras_max_violations++;
+        }
+        for (int i = 0; i < sim.n_open; i++) {
+            sim.t_close[sim.open_rows[i]] = sim.now;
+        }
+        sim.n_open = 0;
+    }
+    sim.ras_low = 0;
+    sim.t_precharge[row_bank(sim.row)] = sim.now;
+    sim.precharge_pending[row_bank(sim.row)] = 1;
+}
+
+static void write_column(void) {
+    int b = row_bank(sim.row);
+    for (int k = 0; k < SIM_CHIPS; k++) {
+        sim_chip_t *ch = &sim.chip[k];
+        uint8_t data = (sim.outdr[SIM_CTRL_PORT] & DRAM_DIN_CHIP_PIN(k)) ? 1 : 0;
+        ch->line[b][LINE_TRUE][sim.col] = data;
+        ch->line[b][LINE_COMP][sim.col] = !data;
+        for (int i = 0; i < sim.n_open; i++) {
+            uint8_t r = sim.open_rows[i];
+            ch->cell[r][sim.col] = ch->line[b][row_line(r)][sim.col];
+        }
+    }
+    sim.stats.writes++;
+}
+
+static void cas_fall(void) {
+    if (!sim.ras_low) {
+        return; // CAS-only cycles do nothing on the 4164
+    }
+    settle();
+    sim.col = (uint8_t)sim.outdr[SIM_ADDR_PORT];
+    sim.t_cas_fall = sim.now;
+    sim.stats.cas_cycles++;
+    if (!(sim.outdr[SIM_CTRL_PORT] & DRAM_WR_PIN)) {
+        write_column(); // early write
+    } else {
+        sim.stats.reads++;
+    }
+}
+
+static void w_fall(uint8_t cas_low) {
+    if (sim.ras_low && cas_low) {
+        settle();
+        write_column(); // late write / read-modify-write
+    }
+}
+
+// DOUT of every chip on its pin of port D
+static uint32_t sample_dout(void) {
+    uint32_t pd = sim.outdr[SIM_CTRL_PORT];
+    uint32_t pins = 0;
+    uint8_t valid = 1;
+
+    settle();
+    if (!sim.ras_low || (pd & DRAM_CAS_PIN) || !(pd & DRAM_WR_PIN)) {
+        valid = 0; // output is high-Z, the pin keeps its last level
+    } else if (!sim.sensed || sim.now - sim.t_cas_fall < SIM_T_CAC || sim.now - sim.t_ras_fall < SIM_T_RAC) {
+        sim.stats.invalid_reads++;
+        valid = 0;
+    }
+    for (int k = 0; k < SIM_CHIPS; k++) {
+        sim_chip_t *ch = &sim.chip[k];
+        if (valid) {
+            ch->dout = ch->line[row_bank(sim.row)][LINE_TRUE][sim.col] > 0.5f;
+        }
+        pins |= ch->dout ? DRAM_DOUT_CHIP_PIN(k) : 0;
+    }
+    return pins;
+}
+
+static void ctrl_port_update(uint32_t old, uint32_t now) {
+    uint32_t rise = ~old & now;
+    uint32_t fall = old & ~now;
+
+    if (rise & DRAM_CAS_PIN) { settle(); }
+    if ((rise & DRAM_RAS_PIN) && sim.ras_low) { ras_rise(); }
+    if ((fall & DRAM_RAS_PIN) && !sim.ras_low) { ras_fall(); }
+    if (fall & DRAM_WR_PIN) { w_fall(!(old & DRAM_CAS_PIN)); }
+    if (fall & DRAM_CAS_PIN) { cas_fall(); }
+}
+
+extern "C" void sim_nvic_enable(int irq, int enable) {
+    if (irq == TIM1_UP_IRQn) {
+        sim.tim1_irq_enabled = enable;
+    }
+    if (irq == SysTicK_IRQn) {
+        sim.systick_irq_enabled = enable;
+    }
+}
+
+static uint8_t tim1_armed(void) {
+    return sim.tim1_irq_enabled && (sim_tim1.CTLR1 & TIM_CEN) && (sim_tim1.DMAINTENR & TIM_UIE) && TIM1_UP_IRQHandler;
+}
+
+static uint8_t systick_armed(void) {
+    return sim.systick_irq_enabled && (sim_systick.CTLR & SYSTICK_CTLR_STIE) && sim.systick_match && SysTick_Handler;
+}
+
+// A new compare value matches when the free-running counter gets there, which
+// for a value just behind it is only after the 32 bit wrap (not modelled)
+static void systick_set_cmp(uint32_t value) {
+    uint32_t ahead = value - (uint32_t)sim.now;
+    sim.systick_cmp = value;
+    sim.systick_match = (ahead < 0x80000000u) ? sim.now + ahead : 0;
+}
+
+// Run the SysTick handler on a compare match and the TIM1 handler for every
+// update event up to the current time
+static void service_interrupts(void) {
+    if (sim.in_irq) {
+        return;
+    }
+    if (systick_armed() && sim.now >= sim.systick_match) {
+        sim.systick_match = 0;
+        sim_systick.SR |= SYSTICK_SR_CNTIF;
+        sim.in_irq = 1;
+        sim.stats.interrupts++;
+        SysTick_Handler();
+        sim.in_irq = 0;
+    }
+    if (!tim1_armed()) {
+        sim.tim1_next = 0;
+        return;
+    }
+    uint64_t period = (uint64_t)(sim_tim1.PSC + 1) * (sim_tim1.ATRLR + 1);
+    if (sim.tim1_next == 0) {
+        sim.tim1_next = sim.now + period;
+    }
+    while (sim.now >= sim.tim1_next) {
+        sim.tim1_next += period;
+        sim.in_irq = 1;
+        sim.stats.interrupts++;
+        TIM1_UP_IRQHandler();
+        sim.in_irq = 0;
+    }
+}
+
+// Time of the next interrupt, 0: none pending
+static uint64_t next_interrupt(void) {
+    uint64_t next = sim.tim1_next;
+    if (systick_armed() && (!next || sim.systick_match < next)) {
+        next = sim.systick_match;
+    }
+    return next;
+}
+
+extern "C" void sim_bus_write(uint8_t port, uint8_t reg, uint32_t value) {
+    sim_lazy_init();
+    sim.now += SIM_BUS_CYCLES;
+    if (!sim.in_irq) {
+        sim.last_activity = sim.now;
+    }
+
+    if (reg == SIM_REG_SYSTICK_CMP) {
+        systick_set_cmp(value);
+        service_interrupts();
+        return;
+    }
+
+    uint32_t old = sim.outdr[port];
+    switch (reg) {
+    case SIM_REG_CFGLR: sim.cfglr[port] = value; return;
+    case SIM_REG_OUTDR: sim.outdr[port] = value & 0xFFFF; break;
+    case SIM_REG_BSHR:  sim.outdr[port] = (old | (value & 0xFFFF)) & ~(value >> 16); break;
+    case SIM_REG_BCR:   sim.outdr[port] = old & ~(value & 0xFFFF); break;
+    default: return;
+    }
+    if (port == SIM_CTRL_PORT) {
+        ctrl_port_update(old, sim.outdr[port]);
+    }
+    if (port == SIM_ADDR_PORT || port == SIM_CTRL_PORT) {
+        dram_trace_record((uint32_t)sim.now, sim.outdr[SIM_ADDR_PORT], sim.outdr[SIM_CTRL_PORT]);
+    }
+    service_interrupts();
+}
+
+extern "C" uint32_t sim_bus_read(uint8_t port, uint8_t reg) {
+    sim_lazy_init();
+    service_interrupts();
+    sim.now += SIM_BUS_CYCLES;
+    switch (reg) {
+    case SIM_REG_CFGLR: return sim.cfglr[port];
+    case SIM_REG_OUTDR: return sim.outdr[port];
+    case SIM_REG_SYSTICK_CNT: return (uint32_t)sim.now;
+    case SIM_REG_SYSTICK_CMP: return sim.systick_cmp;
+    case SIM_REG_INDR:
+        if (port == SIM_CTRL_PORT) {
+            uint32_t pins = 0;
+            for (int k = 0; k < SIM_CHIPS; k++) {
+                pins |= DRAM_DOUT_CHIP_PIN(k);
+            }
+            return (sim.outdr[port] & ~pins) | sample_dout();
+        }
+        return sim.outdr[port];
+    default: return 0;
+    }
+}
+
+void sim_advance(uint64_t cycles) {
+    sim_lazy_init();
+    uint64_t target = sim.now + cycles;
+    service_interrupts();
+    uint64_t next;
+    while (!sim.in_irq && (next = next_interrupt()) && next <= target) {
+        if (sim.now < next) {
+            sim.now = next;
+        }
+        service_interrupts();
+    }
+    if (sim.now < target) {
+        sim.now = target;
+    }
+}
+
+extern "C" void sim_delay(uint32_t cycles) {
+    sim_advance(cycles);
+}
+
+extern "C" void SystemInit(void) {
+    sim_lazy_init();
+}
+
+// Failed checks of the test sections, counted by main.c
+extern uint16_t test_failures;
+
+// The firmware ends in an endless Delay_Ms() loop. Once the main program has
+// not touched the pins for SIM_IDLE_EXIT_MS of simulated time (interrupt
+// handlers do not count) the run is over. The exit status is 1 if any check
+// of main.c failed.
+extern "C" void Delay_Ms(uint32_t ms) {
+    sim_advance((uint64_t)ms * (SIM_CLOCK_HZ / 1000));
+    if (sim.now - sim.last_activity >= sim.idle_exit_cycles) {
+        fflush(stdout);
+        sim_print_stats();
+        fprintf(stderr, "[sim] %u failed checks\n", test_failures);
+        exit(test_failures ? 1 : 0);
+    }
+}
+
+// Debug link input from stdin, only with SIM_CONSOLE set so that a plain run
+// does not wait for a terminal. Input counts as activity; after the end of
+// input the idle timeout ends the run as usual.
+extern "C" int poll_input(void) {
+    static int open = -1;
+    uint8_t buf[7];
+    ssize_t n;
+
+    if (open < 0) {
+        open = getenv("SIM_CONSOLE") != NULL;
+    }
+    if (!open) {
+        return 0;
+    }
+    fflush(stdout);
+    n = read(0, buf, sizeof(buf));
+    if (n <= 0) {
+        open = 0;
+        return 0;
+    }
+    sim.last_activity = sim.now;
+    if (handle_debug_input) {
+        handle_debug_input((int)n, buf);
+    }
+    return (int)n;
+}
+
+extern "C" void Delay_Us(uint32_t us) {
+    sim_advance((uint64_t)us * (SIM_CLOCK_HZ / 1000000));
+}
@@ -0,0 +1,61 @@
+#ifndef SIM4164_H
+#define SIM4164_H
+
+#include <stdint.h>
+
+// Behavioral model of a 4164 (64K x 1) DRAM wired to the CH32V003 as in the
+// README. Time advances in CPU cycles at 48 MHz: every GPIO load or store costs
+// SIM_BUS_CYCLES and the DELAY_x_CYCLES() macros in dram.c add their NOP count.
+// Cycles spent on non-bus instructions are not modelled.
+
+#define SIM_ROWS 256
+#define SIM_COLS 256
+#define SIM_CLOCK_HZ 48000000
+
+#define SIM_BUS_CYCLES 2        // GPIO store/load on the shared bus
+
+// Chip timing (cycles at 48 MHz). These describe a fast part rather than the
+// datasheet worst case, which is what the boards in images/ behave like.
+#define SIM_T_SENSE   4         // RAS fall until the sense amplifiers latch
+#define SIM_T_RAC     6         // RAS fall until DOUT is valid
+#define SIM_T_CAC     3         // CAS fall until DOUT is valid
+#define SIM_T_RP      5         // bitline precharge after RAS rise
+#define SIM_T_RAS_MAX 480       // 10 us maximum RAS low time
+#define SIM_T_REFRESH (SIM_CLOCK_HZ / 250)  // every row within 4 ms
+
+typedef struct {
+    uint64_t cycles;            // simulated time
+    uint32_t activations;       // RAS falling edges
+    uint32_t cas_cycles;        // CAS falling edges while RAS low
+    uint32_t reads;
+    uint32_t writes;
+    uint32_t glitches;          // RAS pulses shorter than SIM_T_SENSE
+    uint32_t multi_activations; // rows opened while an unsensed row was still connected
+    uint32_t short_precharges;  // RAS fall before precharge completed
+    uint32_t invalid_reads;     // DOUT sampled before tRAC/tCAC
+    uint32_t ras_max_violations;
+    uint32_t refresh_misses;    // row activated more than SIM_T_REFRESH after its previous activation
+    uint32_t interrupts;
+} sim_stats_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void sim_reset(uint64_t seed);
+const sim_stats_t *sim_get_stats(void);
+void sim_print_stats(void);
+
+// Direct array access for checking results without going through the pins,
+// one bit per chip as in dram_read_bit()
+uint8_t sim_peek_bit(uint8_t row, uint8_t col);
+void sim_poke_bit(uint8_t row, uint8_t col, uint8_t data);
+
+// Advance simulated time without bus activity (SysTick keeps counting)
+void sim_advance(uint64_t cycles);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SIM4164_H
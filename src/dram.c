@@ -1,98 +1,345 @@
 #include "dram.h"
+#include "dram_refresh.h"
+#include "dram_trace.h"
+#include "dram_stats.h"
 #include <stdio.h>
 
+#if defined(DRAM_TRACE) && !defined(DRAM_SIM)
+// Trace build: every GPIO access below samples the pins first (dram_trace.c)
+#undef DRAM_ADDR_PORT
+#undef DRAM_CTRL_PORT
+#define DRAM_ADDR_PORT ((GPIO_TypeDef *)dram_trace_access((void *)DRAM_GPIO(DRAM_ADDR_GPIO)))
+#define DRAM_CTRL_PORT ((GPIO_TypeDef *)dram_trace_access((void *)DRAM_GPIO(DRAM_CTRL_GPIO)))
+#endif
+
 // Compile-time delay macros for exact cycle counts without loop overhead
+#ifdef DRAM_SIM
+// Host simulator (sim/): advance the simulated clock instead of executing NOPs
+#define DELAY_1_CYCLES() sim_delay(1)
+#define DELAY_2_CYCLES() sim_delay(2)
+#define DELAY_3_CYCLES() sim_delay(3)
+#define DELAY_4_CYCLES() sim_delay(4)
+#define DELAY_5_CYCLES() sim_delay(5)
+#else
 #define DELAY_1_CYCLES() __asm volatile ("nop")
 #define DELAY_2_CYCLES() __asm volatile ("nop\nnop")
 #define DELAY_3_CYCLES() __asm volatile ("nop\nnop\nnop")
 #define DELAY_4_CYCLES() __asm volatile ("nop\nnop\nnop\nnop")
 #define DELAY_5_CYCLES() __asm volatile ("nop\nnop\nnop\nnop\nnop")
+#endif
 
 // Specific delay macros for each timing parameter
 #define DELAY_RAS_CYCLES() DELAY_5_CYCLES() // ~100ns
 #define DELAY_CAS_CYCLES() DELAY_5_CYCLES() // ~100ns
 #define DELAY_RCD_CYCLES() DELAY_2_CYCLES()  // ~20ns
 #define DELAY_RP_CYCLES()  DELAY_5_CYCLES() // ~100ns
+#define DELAY_CP_CYCLES()  DELAY_2_CYCLES() // ~40ns, CAS precharge in page mode; the next address store adds the rest
+
+// Runtime delay for the calibrated kernels: n iterations of a two instruction
+// loop, 4n-2 cycles from SRAM (taken branches cost 3 cycles, see instruction_timing/)
+#ifdef DRAM_SIM
+#define DELAY_LOOP(n) sim_delay(4 * (n) - 2)
+#else
+#define DELAY_LOOP(n) do { uint32_t _d = (n); __asm volatile ("1: addi %0, %0, -1\nbnez %0, 1b" : "+r"(_d)); } while (0)
+#endif
+
+dram_timing_t dram_timing = DRAM_TIMING_DATASHEET;
+
+// Data pins. DRAM_DIN_BSHR() is the BSHR value that puts a column word on the
+// DIN pins (set for a 1, reset for a 0), branch-free.
+#if DRAM_CHIPS == 1
+#define DRAM_DIN_BSHR(word) (((uint32_t)DRAM_DIN_PIN << 16) >> (((word) & 1) << 4))
+#define DRAM_DATA_DRIVE()   do { } while (0)
+#define DRAM_DATA_RELEASE() do { } while (0)
+#else
+#define DRAM_DQ_PINS     (DRAM_DQ_PIN(0) | DRAM_DQ_PIN(1) | (DRAM_CHIPS > 2 ? DRAM_DQ_PIN(2) | DRAM_DQ_PIN(3) : 0))
+#define DQ_SET_BIT(w, k) ((k) < DRAM_CHIPS ? (((w) >> (k)) & 1u) << DRAM_DQ_BIT(k) : 0)
+#define DQ_SET(w)        (DQ_SET_BIT(w, 0) | DQ_SET_BIT(w, 1) | DQ_SET_BIT(w, 2) | DQ_SET_BIT(w, 3))
+#define DQ_BSHR(w)       (DQ_SET(w) | ((uint32_t)(DRAM_DQ_PINS & ~DQ_SET(w)) << 16))
+
+// Shift table from column word to BSHR value, in SRAM for the kernels
+static uint32_t dq_bshr[16] = {
+    DQ_BSHR(0),  DQ_BSHR(1),  DQ_BSHR(2),  DQ_BSHR(3),  DQ_BSHR(4),  DQ_BSHR(5),  DQ_BSHR(6),  DQ_BSHR(7),
+    DQ_BSHR(8),  DQ_BSHR(9),  DQ_BSHR(10), DQ_BSHR(11), DQ_BSHR(12), DQ_BSHR(13), DQ_BSHR(14), DQ_BSHR(15),
+};
+#define DRAM_DIN_BSHR(word) dq_bshr[(word) & DRAM_WORD_MASK]
+
+// The common I/O pins only drive during writes; the control port CFGLR for
+// both cases is worked out once by dram_init()
+static uint32_t cfg_drive, cfg_release;
+#define DRAM_DATA_DRIVE()   (DRAM_CTRL_PORT->CFGLR = cfg_drive)
+#define DRAM_DATA_RELEASE() (DRAM_CTRL_PORT->CFGLR = cfg_release)
+#endif
+
+// Pin changes that go out together in one BSHR store. All pins share the
+// control port, and the 4164 latches DIN on the later of the CAS and W falling
+// edges with zero setup time, so the data can change on that same edge.
+#define BSHR_LOW(pins)           ((uint32_t)(pins) << 16)
+#define DIN_CAS_LOW_BSHR(word)   (DRAM_DIN_BSHR(word) | BSHR_LOW(DRAM_CAS_PIN))
+#define DIN_WR_LOW_BSHR(word)    (DRAM_DIN_BSHR(word) | BSHR_LOW(DRAM_WR_PIN))
+
+// CFGLR fields of the control port: 4 bits per pin, push-pull output at
+// 50 MHz (0x3) or floating input (0x4)
+#define CFG_FIELD(bit, mode)     ((uint32_t)(mode) << (4 * (bit)))
+#define CFG_OUT                  0x3
+#define CFG_IN                   0x4
+#define CTRL_CFG_MASK  (CFG_FIELD(DRAM_RAS_BIT, 0xF) | CFG_FIELD(DRAM_CAS_BIT, 0xF) | CFG_FIELD(DRAM_WR_BIT, 0xF))
+#define CTRL_CFG_OUT   (CFG_FIELD(DRAM_RAS_BIT, CFG_OUT) | CFG_FIELD(DRAM_CAS_BIT, CFG_OUT) | CFG_FIELD(DRAM_WR_BIT, CFG_OUT))
+#if DRAM_CHIPS == 1
+#define DATA_CFG_MASK    (CFG_FIELD(DRAM_DIN_BIT, 0xF) | CFG_FIELD(DRAM_DOUT_BIT, 0xF))
+#define DATA_CFG_RELEASE (CFG_FIELD(DRAM_DIN_BIT, CFG_OUT) | CFG_FIELD(DRAM_DOUT_BIT, CFG_IN))
+#else
+#define DQ_CFG(k, mode)  ((k) < DRAM_CHIPS ? CFG_FIELD(DRAM_DQ_BIT(k), mode) : 0)
+#define DQ_CFG_ALL(mode) (DQ_CFG(0, mode) | DQ_CFG(1, mode) | DQ_CFG(2, mode) | DQ_CFG(3, mode))
+#define DATA_CFG_MASK    DQ_CFG_ALL(0xF)
+#define DATA_CFG_RELEASE DQ_CFG_ALL(CFG_IN)
+#define DATA_CFG_DRIVE   DQ_CFG_ALL(CFG_OUT)
+#endif
+
+// Every public primitive lets the refresh engine run first and then keeps it
+// (and the refresh timer interrupt) away from the pins until it is done.
+// dram_busy counts, so primitives can nest (the scrubber runs them from
+// inside the refresh engine).
+#define DRAM_OP_BEGIN() do { dram_refresh_poll(); dram_busy++; } while (0)
+#define DRAM_OP_END()   do { dram_busy--; } while (0)
+
+// ----------------------------------------------------------------------------
+// Open-page policy
+//
+// With open-page mode enabled, dram_read_bit(), dram_write_bit(),
+// dram_read_fpm() and dram_write_fpm() leave RAS low after the access. A
+// following access to the same row only needs CAS cycles. The row is closed
+// on a row miss, by any other primitive (refresh, copy, bursts), and when
+// the access would run past the 10 us tRAS maximum, measured with SysTick.
+// Opening a row arms the SysTick compare for DRAM_PAGE_CLOSE_MARGIN before
+// tRAS max; the SysTick interrupt calls dram_page_timeout(), which closes a
+// row left open by idle code. An access that ends with less than the margin
+// left closes the row itself, so the bound holds between calls even with
+// the interrupt late or masked.
+// ----------------------------------------------------------------------------
+
+#define DRAM_TRAS_MAX_CYCLES (FUNCONF_SYSTEM_CORE_CLOCK / 100000) // 10 us
+#if defined(DRAM_TRACE) && !defined(DRAM_SIM)
+#define DRAM_COLUMN_CYCLES   (34 + 4 * dram_trace_cost())   // plus sampling the pins for 4 GPIO accesses
+#else
+#define DRAM_COLUMN_CYCLES   34 // one page mode column including loop overhead (dram_read_fpm from flash: 33.6)
+#endif
+#define DRAM_PAGE_CLOSE_MARGIN 96 // interrupt entry and handler, or return and the next call, until RAS is high
+
+static uint8_t open_page_enabled = 0;
+static volatile int16_t open_row = -1;
+static uint32_t open_since;
+static dram_page_stats_t page_stats;
+
+// Close the open row, if any
+void dram_close_page(void) {
+    dram_busy++;                    // keep dram_page_timeout() out
+    if (open_row >= 0) {
+        DRAM_CTRL_PORT->BSHR = DRAM_RAS_PIN; // RAS high (inactive)
+        DRAM_STATS_RAS_HIGH();
+        DELAY_RP_CYCLES();          // RAS precharge time
+        dram_refresh_mark(open_row);
+        open_row = -1;
+    }
+    dram_busy--;
+}
+
+// SysTick compare interrupt: the open row is about to reach tRAS max
+void dram_page_timeout(void) {
+    if (open_row < 0) {
+        return;
+    }
+    if (dram_busy) {
+        // A primitive on this row closes it in dram_deactivate(); anything
+        // else holding the pins gets another try shortly
+        SysTick->CMP = SysTick->CNT + DRAM_PAGE_CLOSE_MARGIN / 2;
+        return;
+    }
+    dram_close_page();
+}
+
+// Returns the previous setting
+uint8_t dram_set_open_page(uint8_t enable) {
+    uint8_t previous = open_page_enabled;
+    dram_close_page();
+    open_page_enabled = enable;
+    return previous;
+}
+
+void dram_get_page_stats(dram_page_stats_t *stats) {
+    *stats = page_stats;
+}
+
+void dram_reset_page_stats(void) {
+    page_stats.hits = 0;
+    page_stats.misses = 0;
+    page_stats.expired = 0;
+    page_stats.activations = 0;
+}
+
+// The open row just went active: restart the tRAS budget and its timeout
+static inline void dram_page_opened(void) {
+    open_since = SysTick->CNT;
+    SysTick->CMP = open_since + DRAM_TRAS_MAX_CYCLES - DRAM_PAGE_CLOSE_MARGIN;
+}
+
+// Make 'row' the active row for an access of 'cols' columns. On return RAS is
+// low and tRCD has passed.
+static void dram_activate(uint8_t row, uint8_t cols) {
+    if (open_page_enabled) {
+        if (open_row == row) {
+            // Page mode loops reopen the row every DRAM_STRIDED_BURST_COLS columns
+            if (cols > DRAM_STRIDED_BURST_COLS) {
+                cols = DRAM_STRIDED_BURST_COLS;
+            }
+            if (SysTick->CNT - open_since + (uint32_t)cols * DRAM_COLUMN_CYCLES < DRAM_TRAS_MAX_CYCLES) {
+                page_stats.hits++;
+                return;
+            }
+            page_stats.expired++;
+        } else {
+            page_stats.misses++;
+        }
+        dram_close_page();
+    }
+
+    // Set row address
+    DRAM_ADDR_PORT->OUTDR = row;
+    DELAY_2_CYCLES(); // Delay for address setup time
+    DRAM_CTRL_PORT->BCR = DRAM_RAS_PIN;  // RAS low (active)
+    DRAM_STATS_RAS_LOW();
+    DRAM_STATS_ADD(activations, 1);
+    page_stats.activations++;
+    dram_refresh_mark(row);
+    DELAY_RCD_CYCLES();        // RAS to CAS delay
+
+    if (open_page_enabled) {
+        open_row = row;
+        dram_page_opened();
+    }
+}
+
+// Close and reopen the active row in the middle of a page mode loop, so that
+// no RAS cycle runs longer than DRAM_STRIDED_BURST_COLS columns
+static void dram_reactivate(uint8_t row) {
+    DRAM_CTRL_PORT->BSHR = DRAM_RAS_PIN; // RAS high (inactive)
+    DRAM_STATS_RAS_HIGH();
+    DRAM_ADDR_PORT->OUTDR = row;
+    DELAY_RP_CYCLES();         // RAS precharge time
+    DRAM_CTRL_PORT->BCR = DRAM_RAS_PIN;  // RAS low (active)
+    DRAM_STATS_RAS_LOW();
+    DRAM_STATS_ADD(activations, 1);
+    page_stats.activations++;
+    DELAY_RCD_CYCLES();        // RAS to CAS delay
+    if (open_page_enabled) {
+        dram_page_opened();
+    }
+}
+
+// True when the column loop of a page mode access reaches a RAS cycle boundary
+#define DRAM_REACTIVATE_DUE(bitcount) \
+    ((bitcount) && !(DRAM_BIT_COL(bitcount) & (DRAM_STRIDED_BURST_COLS - 1)))
+
+// End an access started with dram_activate()
+static void dram_deactivate(void) {
+    if (open_page_enabled) {
+        // Keep the row open for the next access, unless the timeout could
+        // no longer close it in time
+        if (SysTick->CNT - open_since + DRAM_PAGE_CLOSE_MARGIN < DRAM_TRAS_MAX_CYCLES) {
+            return;
+        }
+        dram_close_page();
+        return;
+    }
+    DRAM_CTRL_PORT->BSHR = DRAM_RAS_PIN; // RAS high (inactive)
+    DRAM_STATS_RAS_HIGH();
+    DELAY_RP_CYCLES();         // RAS precharge time
+}
 
 // Initialize DRAM interface
 void dram_init(void) {
     
     // Enable GPIO port clocks
-    RCC->APB2PCENR |= RCC_APB2Periph_GPIOC | RCC_APB2Periph_GPIOD;
- 
-    // Set initial pin states
-    GPIOD->BSHR = DRAM_CAS_PIN | DRAM_RAS_PIN; // Set CAS and RAS high (inactive)
-    GPIOD->BSHR = DRAM_WR_PIN;                 // Set W/R high (read mode)
-
-    // Configure PC0-PC7 as outputs for address bus
-    GPIOC->CFGLR &= ~0xFFFFFFFF; // Clear all PC0-PC7 config
-    GPIOC->CFGLR |= 0x33333333;  // Set PC0-PC7 as push-pull outputs, 50MHz
-    
-    // Configure PD pins
-    // PD0 (DIN) as output
-    GPIOD->CFGLR &= ~(0xF << (4 * 0));
-    GPIOD->CFGLR |= (0x3 << (4 * 0)); // Push-pull output, 50MHz
-    
-    // PD2 (CAS) as output
-    GPIOD->CFGLR &= ~(0xF << (4 * 2));
-    GPIOD->CFGLR |= (0x3 << (4 * 2)); // Push-pull output, 50MHz
-    
-    // PD3 (RAS) as output
-    GPIOD->CFGLR &= ~(0xF << (4 * 3));
-    GPIOD->CFGLR |= (0x3 << (4 * 3)); // Push-pull output, 50MHz
-    
-    // PD4 (W/R) as output
-    GPIOD->CFGLR &= ~(0xF << (4 * 4));
-    GPIOD->CFGLR |= (0x3 << (4 * 4)); // Push-pull output, 50MHz
-    
-    // PD5 (DOUT) as input
-    GPIOD->CFGLR &= ~(0xF << (4 * 5));
-    GPIOD->CFGLR |= (0x4 << (4 * 5)); // Input with pull-up/down
-    
+    RCC->APB2PCENR |= DRAM_GPIO_RCC(DRAM_ADDR_GPIO) | DRAM_GPIO_RCC(DRAM_CTRL_GPIO);
+
+    // RAS, CAS and W high (inactive, read mode) in one store
+    DRAM_CTRL_PORT->BSHR = DRAM_CAS_PIN | DRAM_RAS_PIN | DRAM_WR_PIN;
+
+    // Address bus: pins 0-7 as push-pull outputs, 50MHz
+    DRAM_ADDR_PORT->CFGLR = 0x33333333;
+
+    // Control port: control lines as outputs, DOUT (or the common I/O pins)
+    // as inputs; the other pins of the port keep their configuration
+    uint32_t cfg = DRAM_CTRL_PORT->CFGLR & ~(CTRL_CFG_MASK | DATA_CFG_MASK);
+#if DRAM_CHIPS == 1
+    DRAM_CTRL_PORT->CFGLR = cfg | CTRL_CFG_OUT | DATA_CFG_RELEASE;
+#else
+    cfg_release = cfg | CTRL_CFG_OUT | DATA_CFG_RELEASE;
+    cfg_drive = cfg | CTRL_CFG_OUT | DATA_CFG_DRIVE;
+    DRAM_DATA_RELEASE();
+#endif
+
     printf("DRAM pins configured\r\n");
     
 }
 
 // Refresh a single row
 void dram_refresh_row(uint8_t row) {
+    DRAM_OP_BEGIN();
+    dram_refresh_row_raw(row);
+    DRAM_OP_END();
+}
+
+// RAS-only refresh cycle, for callers that already own the pins
+void dram_refresh_row_raw(uint8_t row) {
+    DRAM_STATS_ENTER();
+    dram_close_page();
+
     // RAS-only refresh cycle
     DRAM_ADDR_PORT->OUTDR = row;  // Set row address
-    GPIOD->BCR = DRAM_RAS_PIN;    // RAS low (active)
+    DRAM_CTRL_PORT->BCR = DRAM_RAS_PIN;    // RAS low (active)
+    DRAM_STATS_RAS_LOW();
+    dram_refresh_mark(row);
     DELAY_RAS_CYCLES();          // RAS pulse width    
-    GPIOD->BSHR = DRAM_RAS_PIN;   // RAS high (inactive)
+    DRAM_CTRL_PORT->BSHR = DRAM_RAS_PIN;   // RAS high (inactive)
+    DRAM_STATS_RAS_HIGH();
     DELAY_RP_CYCLES();           // RAS precharge time
+    DRAM_STATS_ADD(activations, 1);
+    DRAM_STATS_ADD(refreshes, 1);
+    DRAM_STATS_LEAVE(DRAM_STATS_REFRESH_ROW);
 }
 
 // Read a bit from DRAM
 uint8_t dram_read_bit(uint8_t row, uint8_t col) {
     uint8_t data;
+
+    DRAM_OP_BEGIN();
+    DRAM_STATS_ENTER();
     
     // Ensure read mode
-    GPIOD->BSHR = DRAM_WR_PIN;  // W/R high (read mode)
+    DRAM_CTRL_PORT->BSHR = DRAM_WR_PIN;  // W/R high (read mode)
     
-    // Set row address
-    DRAM_ADDR_PORT->OUTDR = row;
-    DELAY_2_CYCLES(); // Delay for address setup time    
-    GPIOD->BCR = DRAM_RAS_PIN;  // RAS low (active)    
-    DELAY_RCD_CYCLES();        // RAS to CAS delay
+    dram_activate(row, 1);
    
     // Set column address
     DRAM_ADDR_PORT->OUTDR = col;
-    GPIOD->BCR = DRAM_CAS_PIN;  // CAS low (active)
+    DRAM_CTRL_PORT->BCR = DRAM_CAS_PIN;  // CAS low (active)
     DELAY_CAS_CYCLES();        // CAS pulse width
     
-    // Read data bit
-    data = (GPIOD->INDR & DRAM_DOUT_PIN) ? 1 : 0;
+    // Read data bit(s)
+    data = DRAM_DOUT_WORD(DRAM_CTRL_PORT->INDR);
     
     // End cycle
-    GPIOD->BSHR = DRAM_CAS_PIN; // CAS high (inactive)
-    GPIOD->BSHR = DRAM_RAS_PIN; // RAS high (inactive)
-    DELAY_RP_CYCLES();         // RAS precharge time
+    DRAM_CTRL_PORT->BSHR = DRAM_CAS_PIN; // CAS high (inactive)
+    dram_deactivate();
     
+    DRAM_STATS_ADD(cas_cycles, 1);
+    DRAM_STATS_LEAVE(DRAM_STATS_BIT);
+    DRAM_OP_END();
     return data;
 }
 
-// Read a int32 value from DRAM using fast page mode
+// Read a int32 value from DRAM using fast page mode, DRAM_CHIPS bits per column
 uint32_t dram_read_fpm(uint8_t row, uint8_t col, uint8_t bits) {
     uint32_t data=0;
     uint32_t bitcount=0;
@@ -100,65 +347,64 @@ uint32_t dram_read_fpm(uint8_t row, uint8_t col, uint8_t bits) {
     if (bits>32) {
         bits=32;
     }   
+
+    DRAM_OP_BEGIN();
+    DRAM_STATS_ENTER();
     
     // Ensure read mode
-    GPIOD->BSHR = DRAM_WR_PIN;  // W/R high (read mode)
+    DRAM_CTRL_PORT->BSHR = DRAM_WR_PIN;  // W/R high (read mode)
     
-    // Set row address
-    DRAM_ADDR_PORT->OUTDR = row;
-    DELAY_2_CYCLES(); // Delay for address setup time    
-    GPIOD->BCR = DRAM_RAS_PIN;  // RAS low (active)    
-    DELAY_RCD_CYCLES();        // RAS to CAS delay
+    dram_activate(row, DRAM_BIT_COL(bits));
    
-    for (bitcount=0; bitcount<bits; bitcount++) {
+    for (bitcount=0; bitcount<bits; bitcount+=DRAM_CHIPS) {
+        if (DRAM_REACTIVATE_DUE(bitcount)) {
+            dram_reactivate(row);
+        }
+
         // Set column address
-        DRAM_ADDR_PORT->OUTDR = col + bitcount;
-        GPIOD->BCR = DRAM_CAS_PIN;  // CAS low (active)
+        DRAM_ADDR_PORT->OUTDR = col + DRAM_BIT_COL(bitcount);
+        DRAM_CTRL_PORT->BCR = DRAM_CAS_PIN;  // CAS low (active)
         DELAY_CAS_CYCLES();        // CAS pulse width
         
-        // Read data bit
-        if (GPIOD->INDR & DRAM_DOUT_PIN) {
-            data |= (1<<bitcount);
-        }
+        // Read data bit(s)
+        data |= (uint32_t)DRAM_DOUT_WORD(DRAM_CTRL_PORT->INDR) << bitcount;
         
         // End cycle
-        GPIOD->BSHR = DRAM_CAS_PIN; // CAS high (inactive)
+        DRAM_CTRL_PORT->BSHR = DRAM_CAS_PIN; // CAS high (inactive)
         DELAY_CAS_CYCLES();        // CAS pulse width
     }
 
-    GPIOD->BSHR = DRAM_RAS_PIN; // RAS high (inactive)
-    DELAY_RP_CYCLES();         // RAS precharge time
+    dram_deactivate();
     
+    DRAM_STATS_ADD(cas_cycles, DRAM_BIT_COL(bits + DRAM_CHIPS - 1));
+    DRAM_STATS_LEAVE(DRAM_STATS_FPM);
+    DRAM_OP_END();
     return data;
 }
 
 // Write a bit to DRAM
 void dram_write_bit(uint8_t row, uint8_t col, uint8_t data) {
+    DRAM_OP_BEGIN();
+    DRAM_STATS_ENTER();
+
     // Set write mode
-    GPIOD->BCR = DRAM_WR_PIN;  // W/R low (write mode)
-    
-    // Set data bit
-    if (data) {
-        GPIOD->BSHR = DRAM_DIN_PIN; // Set DIN high for 1
-    } else {
-        GPIOD->BCR = DRAM_DIN_PIN;  // Set DIN low for 0
-    }
+    DRAM_CTRL_PORT->BCR = DRAM_WR_PIN;  // W/R low (write mode)
+    DRAM_DATA_DRIVE();
     
-    // Set row address
-    DRAM_ADDR_PORT->OUTDR = row;
-    GPIOD->BCR = DRAM_RAS_PIN;  // RAS low (active)
-    DELAY_RCD_CYCLES();        // RAS to CAS delay
+    dram_activate(row, 1);
     
-    // Set column address
+    // Set column address, then data bit(s) and CAS low in one store
     DRAM_ADDR_PORT->OUTDR = col;
-    GPIOD->BCR = DRAM_CAS_PIN;  // CAS low (active)
+    DRAM_CTRL_PORT->BSHR = DIN_CAS_LOW_BSHR(data);
     DELAY_CAS_CYCLES();        // CAS pulse width
     
-    // End cycle
-    GPIOD->BSHR = DRAM_CAS_PIN; // CAS high (inactive)
-    GPIOD->BSHR = DRAM_RAS_PIN; // RAS high (inactive)
-    GPIOD->BSHR = DRAM_WR_PIN;  // W/R high (read mode)
-    DELAY_RP_CYCLES();         // RAS precharge time
+    // End cycle: CAS and W/R high
+    DRAM_CTRL_PORT->BSHR = DRAM_CAS_PIN | DRAM_WR_PIN;
+    DRAM_DATA_RELEASE();
+    dram_deactivate();
+    DRAM_STATS_ADD(cas_cycles, 1);
+    DRAM_STATS_LEAVE(DRAM_STATS_BIT);
+    DRAM_OP_END();
 }
 
 // write a int32 value from DRAM using fast page mode
@@ -172,68 +418,561 @@ void dram_write_fpm(uint8_t row, uint8_t col_start, uint32_t data_val, uint8_t b
         bits = 32;
     }
 
+    DRAM_OP_BEGIN();
+    DRAM_STATS_ENTER();
+
     // Set Write Mode
-    GPIOD->BCR = DRAM_WR_PIN;  // W/R low (write mode)
+    DRAM_CTRL_PORT->BCR = DRAM_WR_PIN;  // W/R low (write mode)
+    DRAM_DATA_DRIVE();
 
     // Activate Row
-    DRAM_ADDR_PORT->OUTDR = row; // Set row address
-    DELAY_2_CYCLES();            // Delay for address setup time (consistent with dram_read_fpm)
-    GPIOD->BCR = DRAM_RAS_PIN;   // RAS low (active)
-    DELAY_RCD_CYCLES();          // RAS to CAS delay
+    dram_activate(row, DRAM_BIT_COL(bits));
 
     // Write Data (multiple columns)
-    for (bitcount = 0; bitcount < bits; bitcount++) {
-        // Set column address
-        DRAM_ADDR_PORT->OUTDR = col_start + bitcount;
-
-        // Set data bit on DIN pin
-        if ((data_val >> bitcount) & 1) {
-            GPIOD->BSHR = DRAM_DIN_PIN; // Set DIN high for 1
-        } else {
-            GPIOD->BCR = DRAM_DIN_PIN;  // Set DIN low for 0
+    for (bitcount = 0; bitcount < bits; bitcount += DRAM_CHIPS) {
+        if (DRAM_REACTIVATE_DUE(bitcount)) {
+            dram_reactivate(row);
         }
-        // Small delay for data setup before CAS (t_DS), if necessary, can be added here.
-        // Current implementation assumes instruction timing is sufficient.
 
-        GPIOD->BCR = DRAM_CAS_PIN;  // CAS low (active)
+        // Set column address
+        DRAM_ADDR_PORT->OUTDR = col_start + DRAM_BIT_COL(bitcount);
+
+        // Data bit(s) on the DIN pin(s) and CAS low in one store (t_DS is 0)
+        DRAM_CTRL_PORT->BSHR = DIN_CAS_LOW_BSHR(data_val >> bitcount);
         DELAY_CAS_CYCLES();         // CAS pulse width (t_CAS or t_WP - Write Pulse Width)
 
-        GPIOD->BSHR = DRAM_CAS_PIN; // CAS high (inactive)
+        DRAM_CTRL_PORT->BSHR = DRAM_CAS_PIN; // CAS high (inactive)
         // Delay for CAS high time / CAS cycle time in FPM (t_CH or t_CP)
         DELAY_CAS_CYCLES();
     }
 
     // Deactivate Row and End Cycle
     // W/R should go high before RAS goes high to properly terminate the write cycle.
-    GPIOD->BSHR = DRAM_WR_PIN;  // W/R high (read mode) - W goes high
-    // A small delay might be needed here for tWR (Write Recovery time) if specified by DRAM datasheet,
-    // ensuring W is high for a certain duration before RAS goes high.
-    // For now, assuming direct transition is acceptable or covered by subsequent delays.
-    GPIOD->BSHR = DRAM_RAS_PIN; // RAS high (inactive)
+    DRAM_DATA_RELEASE();
+    DRAM_CTRL_PORT->BSHR = DRAM_WR_PIN;  // W/R high (read mode) - W goes high
+    // No delay for tWR: from the last write to RAS high, the store above and
+    // dram_deactivate() take 8 to 16 cycles in the trace check (tools/dram_trace),
+    // against a minimum of 3 (DRAM_RULE_WR)
+    dram_deactivate();
+    DRAM_STATS_ADD(cas_cycles, DRAM_BIT_COL(bits + DRAM_CHIPS - 1));
+    DRAM_STATS_LEAVE(DRAM_STATS_FPM);
+    DRAM_OP_END();
+}
+
+// One read-modify-write column cycle: DOUT is sampled while CAS is low, then
+// W drops with the new data on DIN (late write) before CAS rises again. fn is
+// called for the bit of each chip, data bits index .. index + DRAM_CHIPS - 1.
+static inline uint8_t dram_rmw_column(uint8_t col, dram_rmw_fn fn, uint8_t index, void *ctx) {
+    uint8_t old_word, new_word = 0;
+
+    // Set column address
+    DRAM_ADDR_PORT->OUTDR = col;
+    DRAM_CTRL_PORT->BCR = DRAM_CAS_PIN;  // CAS low (active)
+    DELAY_CAS_CYCLES();        // CAS access time
+
+    // Read data bit(s) and compute the new ones
+    old_word = DRAM_DOUT_WORD(DRAM_CTRL_PORT->INDR);
+    for (uint8_t k = 0; k < DRAM_CHIPS; k++) {
+        new_word |= (fn((old_word >> k) & 1, index + k, ctx) ? 1 : 0) << k;
+    }
+
+#if DRAM_CHIPS == 1
+    // Late write: data is latched on the falling edge of W, so DIN and W
+    // go low in one store
+    DRAM_CTRL_PORT->BSHR = DIN_WR_LOW_BSHR(new_word);
+    DELAY_CAS_CYCLES();        // Write pulse width (t_WP)
+
+    // End cycle: W/R and CAS high
+    DRAM_CTRL_PORT->BSHR = DRAM_WR_PIN | DRAM_CAS_PIN;
+#else
+    // With common I/O, DOUT drives the pins until CAS rises, so the new data
+    // goes in with a second, early write, CAS cycle on the same column
+    DRAM_CTRL_PORT->BSHR = DRAM_CAS_PIN; // CAS high (inactive)
+    DRAM_CTRL_PORT->BCR = DRAM_WR_PIN;   // W/R low (write)
+    DRAM_DATA_DRIVE();
+    DRAM_CTRL_PORT->BSHR = DIN_CAS_LOW_BSHR(new_word);  // CAS low, data is latched
+    DELAY_CAS_CYCLES();        // Write pulse width (t_WP)
+    DRAM_CTRL_PORT->BSHR = DRAM_CAS_PIN | DRAM_WR_PIN;  // CAS and W/R high
+    DRAM_DATA_RELEASE();
+#endif
+    return old_word;
+}
+
+// Read-modify-write a single column. Returns the old column word.
+uint8_t dram_rmw_bit(uint8_t row, uint8_t col, dram_rmw_fn fn, void *ctx) {
+    uint8_t old_bit;
+
+    DRAM_OP_BEGIN();
+    DRAM_STATS_ENTER();
+
+    // Ensure read mode
+    DRAM_CTRL_PORT->BSHR = DRAM_WR_PIN;  // W/R high (read mode)
+
+    dram_activate(row, 1);
+    old_bit = dram_rmw_column(col, fn, 0, ctx);
+    dram_deactivate();
+    DRAM_STATS_ADD(cas_cycles, 1);
+    DRAM_STATS_LEAVE(DRAM_STATS_RMW);
+
+    DRAM_OP_END();
+    return old_bit;
+}
+
+// Read-modify-write up to 32 data bits in page mode. fn is called once per
+// bit, in bit order, and returns the bit to write back. Returns the old contents.
+uint32_t dram_rmw_fpm(uint8_t row, uint8_t col, uint8_t bits, dram_rmw_fn fn, void *ctx) {
+    uint32_t data = 0;
+
+    if (bits > 32) {
+        bits = 32;
+    }
+
+    DRAM_OP_BEGIN();
+    DRAM_STATS_ENTER();
+
+    // Ensure read mode
+    DRAM_CTRL_PORT->BSHR = DRAM_WR_PIN;  // W/R high (read mode)
+
+    dram_activate(row, DRAM_BIT_COL(bits));
+
+    for (uint8_t bitcount = 0; bitcount < bits; bitcount += DRAM_CHIPS) {
+        if (DRAM_REACTIVATE_DUE(bitcount)) {
+            dram_reactivate(row);
+        }
+        data |= (uint32_t)dram_rmw_column(col + DRAM_BIT_COL(bitcount), fn, bitcount, ctx) << bitcount;
+        DELAY_CP_CYCLES();         // CAS precharge
+    }
+
+    dram_deactivate();
+    DRAM_STATS_ADD(cas_cycles, DRAM_BIT_COL(bits + DRAM_CHIPS - 1));
+    DRAM_STATS_LEAVE(DRAM_STATS_RMW);
+
+    DRAM_OP_END();
+    return data;
+}
+
+static uint8_t rmw_xor(uint8_t old_bit, uint8_t index, void *ctx) {
+    return old_bit ^ ((*(uint32_t *)ctx >> index) & 1);
+}
+
+static uint8_t rmw_increment(uint8_t old_bit, uint8_t index, void *ctx) {
+    uint8_t *carry = (uint8_t *)ctx;
+    uint8_t new_bit = old_bit ^ *carry;
+    (void)index;
+    *carry &= old_bit;
+    return new_bit;
+}
+
+// XOR 'bits' data bits with mask (bit 0 = first bit). Returns the old contents.
+uint32_t dram_rmw_xor(uint8_t row, uint8_t col, uint8_t bits, uint32_t mask) {
+    return dram_rmw_fpm(row, col, bits, rmw_xor, &mask);
+}
+
+// Increment the little-endian counter stored in 'bits' data bits. Returns the old value.
+uint32_t dram_rmw_increment(uint8_t row, uint8_t col, uint8_t bits) {
+    uint8_t carry = 1;
+    return dram_rmw_fpm(row, col, bits, rmw_increment, &carry);
+}
+
+// Read 'count' columns spaced 'stride' apart from one row, in RAS cycles of
+// DRAM_STRIDED_BURST_COLS columns. Column addresses wrap around at 256. The
+// bits are packed LSB first, so the i-th column read lands in bit (i & 7) of
+// buf[i >> 3], or with several chips its word in bits i * DRAM_CHIPS and up.
+void dram_read_strided(uint8_t row, uint8_t col, uint8_t stride, uint16_t count, uint8_t *buf) {
+    uint8_t current_byte = 0;
+    uint8_t shift = 0;
+
+    if (count == 0) {
+        return;
+    }
+
+    DRAM_OP_BEGIN();
+    DRAM_STATS_ENTER();
+    dram_close_page();
+
+    // Set row address
+    DRAM_ADDR_PORT->OUTDR = row;
+    DELAY_2_CYCLES(); // Delay for address setup time
+    DRAM_CTRL_PORT->BSHR = DRAM_WR_PIN | BSHR_LOW(DRAM_RAS_PIN);  // W/R high (read mode), RAS low (active)
+    DRAM_STATS_RAS_LOW();
+    dram_refresh_mark(row);
+    DELAY_RCD_CYCLES();        // RAS to CAS delay
+
+    for (uint16_t i = 0; i < count; i++) {
+        if (i && !(i & (DRAM_STRIDED_BURST_COLS - 1))) {
+            // Start a new RAS cycle before tRAS max runs out
+            DRAM_CTRL_PORT->BSHR = DRAM_RAS_PIN; // RAS high (inactive)
+            DRAM_STATS_RAS_HIGH();
+            DRAM_ADDR_PORT->OUTDR = row;
+            DELAY_RP_CYCLES();         // RAS precharge time
+            DRAM_CTRL_PORT->BCR = DRAM_RAS_PIN;  // RAS low (active)
+            DRAM_STATS_RAS_LOW();
+            DELAY_RCD_CYCLES();        // RAS to CAS delay
+        }
+
+        // Set column address
+        DRAM_ADDR_PORT->OUTDR = col;
+        DRAM_CTRL_PORT->BCR = DRAM_CAS_PIN;  // CAS low (active)
+        DELAY_CAS_CYCLES();        // CAS pulse width
+
+        // Read data bit(s)
+        current_byte |= DRAM_DOUT_WORD(DRAM_CTRL_PORT->INDR) << shift;
+
+        // End cycle
+        DRAM_CTRL_PORT->BSHR = DRAM_CAS_PIN; // CAS high (inactive)
+        DELAY_CAS_CYCLES();        // CAS pulse width
+
+        col += stride;
+        shift += DRAM_CHIPS;
+        if (shift == 8) {
+            *buf++ = current_byte;
+            current_byte = 0;
+            shift = 0;
+        }
+    }
+
+    DRAM_CTRL_PORT->BSHR = DRAM_RAS_PIN; // RAS high (inactive)
+    DRAM_STATS_RAS_HIGH();
+    DELAY_RP_CYCLES();         // RAS precharge time
+    DRAM_STATS_ADD(activations, (count + DRAM_STRIDED_BURST_COLS - 1) / DRAM_STRIDED_BURST_COLS);
+    DRAM_STATS_ADD(cas_cycles, count);
+    DRAM_STATS_LEAVE(DRAM_STATS_STRIDED);
+    DRAM_OP_END();
+
+    // Store a partially filled last byte
+    if (shift) {
+        *buf = current_byte;
+    }
+}
+
+// Write 'count' columns spaced 'stride' apart to one row, in RAS cycles of
+// DRAM_STRIDED_BURST_COLS columns. Same bit packing as dram_read_strided().
+void dram_write_strided(uint8_t row, uint8_t col, uint8_t stride, uint16_t count, const uint8_t *buf) {
+    uint8_t current_byte = 0;
+    uint8_t shift = 8;
+
+    if (count == 0) {
+        return;
+    }
+
+    DRAM_OP_BEGIN();
+    DRAM_STATS_ENTER();
+    dram_close_page();
+
+    DRAM_DATA_DRIVE();
+
+    // Activate Row
+    DRAM_ADDR_PORT->OUTDR = row; // Set row address
+    DELAY_2_CYCLES();            // Delay for address setup time
+    DRAM_CTRL_PORT->BCR = DRAM_WR_PIN | DRAM_RAS_PIN;  // W/R low (write mode), RAS low (active)
+    DRAM_STATS_RAS_LOW();
+    dram_refresh_mark(row);
+    DELAY_RCD_CYCLES();          // RAS to CAS delay
+
+    for (uint16_t i = 0; i < count; i++) {
+        if (shift == 8) {
+            current_byte = *buf++;
+            shift = 0;
+        }
+        if (i && !(i & (DRAM_STRIDED_BURST_COLS - 1))) {
+            // Start a new RAS cycle before tRAS max runs out
+            DRAM_CTRL_PORT->BSHR = DRAM_WR_PIN | DRAM_RAS_PIN;  // W/R high, RAS high (inactive)
+            DRAM_STATS_RAS_HIGH();
+            DRAM_ADDR_PORT->OUTDR = row;
+            DELAY_RP_CYCLES();          // RAS precharge time
+            DRAM_CTRL_PORT->BCR = DRAM_WR_PIN | DRAM_RAS_PIN;   // W/R low, RAS low (active)
+            DRAM_STATS_RAS_LOW();
+            DELAY_RCD_CYCLES();         // RAS to CAS delay
+        }
+
+        // Set column address
+        DRAM_ADDR_PORT->OUTDR = col;
+
+        // Data bit(s) on the DIN pin(s) and CAS low (active)
+        DRAM_CTRL_PORT->BSHR = DIN_CAS_LOW_BSHR(current_byte >> shift);
+        DELAY_CAS_CYCLES();         // CAS pulse width (t_CAS or t_WP - Write Pulse Width)
+
+        DRAM_CTRL_PORT->BSHR = DRAM_CAS_PIN; // CAS high (inactive)
+        DELAY_CAS_CYCLES();         // CAS high time (t_CP)
+
+        col += stride;
+        shift += DRAM_CHIPS;
+    }
+
+    // Deactivate Row and End Cycle
+    DRAM_DATA_RELEASE();
+    DRAM_CTRL_PORT->BSHR = DRAM_WR_PIN | DRAM_RAS_PIN;  // W/R high (read mode), RAS high (inactive)
+    DRAM_STATS_RAS_HIGH();
     DELAY_RP_CYCLES();          // RAS precharge time
+    DRAM_STATS_ADD(activations, (count + DRAM_STRIDED_BURST_COLS - 1) / DRAM_STRIDED_BURST_COLS);
+    DRAM_STATS_ADD(cas_cycles, count);
+    DRAM_STATS_LEAVE(DRAM_STATS_STRIDED);
+    DRAM_OP_END();
+}
+
+// Read 'bits' data bits starting at column 'col' (dram_read_strided() with stride 1)
+void dram_read_cols(uint8_t row, uint8_t col, uint16_t bits, uint8_t *buf) {
+    dram_read_strided(row, col, 1, DRAM_BIT_COL(bits), buf);
+}
+
+// Write 'bits' data bits starting at column 'col' (dram_write_strided() with stride 1)
+void dram_write_cols(uint8_t row, uint8_t col, uint16_t bits, const uint8_t *buf) {
+    dram_write_strided(row, col, 1, DRAM_BIT_COL(bits), buf);
+}
+
+// ----------------------------------------------------------------------------
+// SRAM-resident fast page mode kernels
+//
+// Executing from flash costs 2 cycles per taken branch and stalls on 32 bit
+// fetches (see instruction_timing/), so the kernels below run from SRAM and
+// unroll the column loop in blocks of one byte (8 / DRAM_CHIPS columns), or of
+// half a byte with one chip. DOUT is moved into place with shifts instead of a
+// conditional. A fully unrolled 256 column kernel would need ~8 KB of code, so
+// longer bursts loop over the block; the remaining branch costs one taken
+// branch per block. Half byte blocks keep the two one-chip kernels about 300
+// bytes smaller, which the 2 KB of SRAM need more than the ~3% of speed.
+//
+// The delays are runtime loops set by dram_timing (see dram_timing.c), so one
+// copy of each kernel in SRAM serves every calibrated timing.
+//
+// Trace builds leave the kernels untraced: sampling the pins from flash before
+// each of their accesses would keep RAS low for thousands of cycles per
+// DRAM_BURST_COLS columns, far past tRAS max. Their pin changes show up
+// merged at the next traced access.
+// ----------------------------------------------------------------------------
+
+#if defined(DRAM_TRACE) && !defined(DRAM_SIM)
+#undef DRAM_ADDR_PORT
+#undef DRAM_CTRL_PORT
+#define DRAM_ADDR_PORT DRAM_GPIO(DRAM_ADDR_GPIO)
+#define DRAM_CTRL_PORT DRAM_GPIO(DRAM_CTRL_GPIO)
+#endif
+
+// Move the DOUT bit(s) of an INDR sample to the position of column k of the block, branch-free
+#if DRAM_CHIPS == 1
+#define DOUT_TO_BIT(indr, k) (((((uint32_t)(indr)) & DRAM_DOUT_PIN) << 16) >> (DRAM_DOUT_BIT + 16 - (k)))
+#else
+#define DOUT_TO_BIT(indr, k) ((uint32_t)DRAM_DOUT_WORD(indr) << ((k) * DRAM_CHIPS))
+#endif
+
+// BSHR value for the DIN pin(s) of column k of the block and CAS low
+#define DIN_CAS_BSHR(data, k) DIN_CAS_LOW_BSHR((data) >> ((k) * DRAM_CHIPS))
+
+// Columns and data bits per unrolled block. Reads shift the blocks of a byte
+// down and fill in the top FPM_BLOCK_BITS bits, writes take the bottom ones.
+#if DRAM_CHIPS == 1
+#define FPM_BLOCK_COLS 4
+#else
+#define FPM_BLOCK_COLS (8 / DRAM_CHIPS)
+#endif
+#define FPM_BLOCK_BITS (FPM_BLOCK_COLS * DRAM_CHIPS)
+#define FPM_BLOCK_TOP  (8 / DRAM_CHIPS - FPM_BLOCK_COLS)
+
+// Column delays come from dram_timing (copied into 't' at kernel entry)
+#define FPM_READ_COLUMN(k)                        \
+    DRAM_ADDR_PORT->OUTDR = (uint8_t)(col + (k)); \
+    DRAM_CTRL_PORT->BCR = DRAM_CAS_PIN;           \
+    DELAY_LOOP(t.cas);                            \
+    data |= DOUT_TO_BIT(DRAM_CTRL_PORT->INDR, (k) + FPM_BLOCK_TOP); \
+    DRAM_CTRL_PORT->BSHR = DRAM_CAS_PIN;          \
+    DELAY_LOOP(t.cp);
+
+#define FPM_WRITE_COLUMN(k)                       \
+    DRAM_ADDR_PORT->OUTDR = (uint8_t)(col + (k)); \
+    DRAM_CTRL_PORT->BSHR = DIN_CAS_BSHR(data, k); \
+    DELAY_LOOP(t.cas);                            \
+    DRAM_CTRL_PORT->BSHR = DRAM_CAS_PIN;          \
+    DELAY_LOOP(t.cp);
+
+#if FPM_BLOCK_COLS == 4
+#define FPM_READ_BLOCK()  FPM_READ_COLUMN(0) FPM_READ_COLUMN(1) FPM_READ_COLUMN(2) FPM_READ_COLUMN(3)
+#define FPM_WRITE_BLOCK() FPM_WRITE_COLUMN(0) FPM_WRITE_COLUMN(1) FPM_WRITE_COLUMN(2) FPM_WRITE_COLUMN(3)
+#else
+#define FPM_READ_BLOCK()  FPM_READ_COLUMN(0) FPM_READ_COLUMN(1)
+#define FPM_WRITE_BLOCK() FPM_WRITE_COLUMN(0) FPM_WRITE_COLUMN(1)
+#endif
+
+// Read nbytes*8 bits starting at col into buf (LSB first), one RAS cycle per
+// DRAM_BURST_BYTES
+DRAM_SRAM_FUNC
+static void dram_fpm_read_kernel(uint8_t row, uint8_t col, uint8_t *buf, uint8_t nbytes) {
+    const dram_timing_t t = dram_timing;
+    uint8_t burst = DRAM_BURST_BYTES;
+    DRAM_OP_BEGIN();
+    DRAM_STATS_ENTER();
+    DRAM_STATS_ADD(activations, (nbytes + DRAM_BURST_BYTES - 1) / DRAM_BURST_BYTES);
+    page_stats.activations += (nbytes + DRAM_BURST_BYTES - 1) / DRAM_BURST_BYTES;
+    DRAM_STATS_ADD(cas_cycles, (uint32_t)nbytes * 8 / DRAM_CHIPS);
+    dram_close_page();
+
+    // Set row address
+    DRAM_ADDR_PORT->OUTDR = row;
+    DELAY_2_CYCLES(); // Delay for address setup time
+    DRAM_CTRL_PORT->BSHR = DRAM_WR_PIN | BSHR_LOW(DRAM_RAS_PIN);  // W/R high (read mode), RAS low (active)
+    DRAM_STATS_RAS_LOW();
+    dram_refresh_mark(row);
+    DELAY_LOOP(t.rcd);         // RAS to CAS delay
+
+    do {
+        uint32_t data = 0;
+        for (uint8_t bit = 0; bit < 8; bit += FPM_BLOCK_BITS) {
+            data >>= FPM_BLOCK_BITS;
+            FPM_READ_BLOCK()
+            col += FPM_BLOCK_COLS;
+        }
+        *buf++ = data;
+        if (--burst == 0 && nbytes > 1) {
+            // Start a new RAS cycle before tRAS max runs out
+            DRAM_CTRL_PORT->BSHR = DRAM_RAS_PIN; // RAS high (inactive)
+            DRAM_STATS_RAS_HIGH();
+            DRAM_ADDR_PORT->OUTDR = row;
+            DELAY_LOOP(t.rp);          // RAS precharge time
+            DRAM_CTRL_PORT->BCR = DRAM_RAS_PIN;  // RAS low (active)
+            DRAM_STATS_RAS_LOW();
+            DELAY_LOOP(t.rcd);         // RAS to CAS delay
+            burst = DRAM_BURST_BYTES;
+        }
+    } while (--nbytes);
+
+    DRAM_CTRL_PORT->BSHR = DRAM_RAS_PIN; // RAS high (inactive)
+    DRAM_STATS_RAS_HIGH();
+    DELAY_LOOP(t.rp);          // RAS precharge time
+    DRAM_STATS_LEAVE(DRAM_STATS_READ_BURST);
+    DRAM_OP_END();
+}
+
+// Write nbytes*8 bits starting at col from buf (LSB first), one RAS cycle per
+// DRAM_BURST_BYTES
+DRAM_SRAM_FUNC
+static void dram_fpm_write_kernel(uint8_t row, uint8_t col, const uint8_t *buf, uint8_t nbytes) {
+    const dram_timing_t t = dram_timing;
+    uint8_t burst = DRAM_BURST_BYTES;
+    DRAM_OP_BEGIN();
+    DRAM_STATS_ENTER();
+    DRAM_STATS_ADD(activations, (nbytes + DRAM_BURST_BYTES - 1) / DRAM_BURST_BYTES);
+    page_stats.activations += (nbytes + DRAM_BURST_BYTES - 1) / DRAM_BURST_BYTES;
+    DRAM_STATS_ADD(cas_cycles, (uint32_t)nbytes * 8 / DRAM_CHIPS);
+    dram_close_page();
+
+    DRAM_DATA_DRIVE();
+
+    // Activate Row
+    DRAM_ADDR_PORT->OUTDR = row; // Set row address
+    DELAY_2_CYCLES();            // Delay for address setup time
+    DRAM_CTRL_PORT->BCR = DRAM_WR_PIN | DRAM_RAS_PIN;  // W/R low (write mode), RAS low (active)
+    DRAM_STATS_RAS_LOW();
+    dram_refresh_mark(row);
+    DELAY_LOOP(t.rcd);           // RAS to CAS delay
+
+    do {
+        uint32_t data = *buf++;
+        for (uint8_t bit = 0; bit < 8; bit += FPM_BLOCK_BITS) {
+            FPM_WRITE_BLOCK()
+            data >>= FPM_BLOCK_BITS;
+            col += FPM_BLOCK_COLS;
+        }
+        if (--burst == 0 && nbytes > 1) {
+            // Start a new RAS cycle before tRAS max runs out
+            DRAM_CTRL_PORT->BSHR = DRAM_WR_PIN | DRAM_RAS_PIN;  // W/R high, RAS high (inactive)
+            DRAM_STATS_RAS_HIGH();
+            DRAM_ADDR_PORT->OUTDR = row;
+            DELAY_LOOP(t.rp);           // RAS precharge time
+            DRAM_CTRL_PORT->BCR = DRAM_WR_PIN | DRAM_RAS_PIN;   // W/R low, RAS low (active)
+            DRAM_STATS_RAS_LOW();
+            DELAY_LOOP(t.rcd);          // RAS to CAS delay
+            burst = DRAM_BURST_BYTES;
+        }
+    } while (--nbytes);
+
+    // Deactivate Row and End Cycle
+    DRAM_DATA_RELEASE();
+    DRAM_CTRL_PORT->BSHR = DRAM_WR_PIN | DRAM_RAS_PIN;  // W/R high (read mode), RAS high (inactive)
+    DRAM_STATS_RAS_HIGH();
+    DELAY_LOOP(t.rp);           // RAS precharge time
+    DRAM_STATS_LEAVE(DRAM_STATS_WRITE_BURST);
+    DRAM_OP_END();
+}
+
+#if defined(DRAM_TRACE) && !defined(DRAM_SIM)
+#undef DRAM_ADDR_PORT
+#undef DRAM_CTRL_PORT
+#define DRAM_ADDR_PORT ((GPIO_TypeDef *)dram_trace_access((void *)DRAM_GPIO(DRAM_ADDR_GPIO)))
+#define DRAM_CTRL_PORT ((GPIO_TypeDef *)dram_trace_access((void *)DRAM_GPIO(DRAM_CTRL_GPIO)))
+#endif
+
+uint8_t dram_read_fpm8(uint8_t row, uint8_t col) {
+    uint8_t buf[1];
+    dram_fpm_read_kernel(row, col, buf, 1);
+    return buf[0];
+}
+
+uint16_t dram_read_fpm16(uint8_t row, uint8_t col) {
+    uint8_t buf[2];
+    dram_fpm_read_kernel(row, col, buf, 2);
+    return buf[0] | (buf[1] << 8);
+}
+
+uint32_t dram_read_fpm32(uint8_t row, uint8_t col) {
+    uint8_t buf[4];
+    dram_fpm_read_kernel(row, col, buf, 4);
+    return buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+void dram_write_fpm8(uint8_t row, uint8_t col, uint8_t data) {
+    dram_fpm_write_kernel(row, col, &data, 1);
+}
+
+void dram_write_fpm16(uint8_t row, uint8_t col, uint16_t data) {
+    uint8_t buf[2] = {(uint8_t)data, (uint8_t)(data >> 8)};
+    dram_fpm_write_kernel(row, col, buf, 2);
+}
+
+void dram_write_fpm32(uint8_t row, uint8_t col, uint32_t data) {
+    uint8_t buf[4] = {(uint8_t)data, (uint8_t)(data >> 8), (uint8_t)(data >> 16), (uint8_t)(data >> 24)};
+    dram_fpm_write_kernel(row, col, buf, 4);
+}
+
+// Read a complete row (256 columns), DRAM_BURST_COLS columns per RAS cycle
+void dram_read_row(uint8_t row, uint8_t buf[DRAM_ROW_BYTES]) {
+    dram_fpm_read_kernel(row, 0, buf, DRAM_ROW_BYTES);
+}
+
+// Write a complete row (256 columns), DRAM_BURST_COLS columns per RAS cycle
+void dram_write_row(uint8_t row, const uint8_t buf[DRAM_ROW_BYTES]) {
+    dram_fpm_write_kernel(row, 0, buf, DRAM_ROW_BYTES);
+}
+
+// nbytes*8 data bits starting at col, one RAS cycle per DRAM_BURST_BYTES
+void dram_read_burst(uint8_t row, uint8_t col, uint8_t *buf, uint8_t nbytes) {
+    dram_fpm_read_kernel(row, col, buf, nbytes);
+}
+
+void dram_write_burst(uint8_t row, uint8_t col, const uint8_t *buf, uint8_t nbytes) {
+    dram_fpm_write_kernel(row, col, buf, nbytes);
 }
 
 // Read and diplay rows from the DRAM using fast page mode
 void dram_readpages_fpm(uint8_t startrow, uint8_t rows) {
-    uint32_t read_val;
+    uint8_t page_buffer[DRAM_ROW_BYTES];
+
+    for (uint16_t row = startrow; row < startrow+rows; row++) {
+        dram_read_row(row, page_buffer);
 
-    for (uint8_t row = startrow; row < startrow+rows; row++) {
         // Print the row number at the start
         printf("Row %02X: ", row);
-        
-        // Read and print 8 32-bit values from the row (256 bits total)
-        for (uint8_t col = 0; col < 8; col++) {
-            read_val = dram_read_fpm(row, col * 32, 32); // Reading 32 bits starting at columns 0, 32, 64, ...
-            printf("%08lX ", read_val);
+
+        // Print the row as 8 32-bit values, column 0 in the LSB of the first one
+        for (uint8_t i = 0; i < DRAM_ROW_BYTES; i += 4) {
+            printf("%02X%02X%02X%02X ", page_buffer[i+3], page_buffer[i+2], page_buffer[i+1], page_buffer[i]);
         }
-        
+
         printf("\r\n"); // Add a newline after printing the row
     }
 }
 
 // Prints the first 16 bits of every pages in the dram
 void dram_scan_array() {
-    uint32_t read_val;
+    uint8_t read_buf[2];
     uint8_t dram_row;
 
     // Print header row
@@ -247,96 +986,241 @@ void dram_scan_array() {
         printf("%X0: ", grid_row); // Print grid row header (e.g., 0_:, 1_:, ..., F_:)
         for (uint8_t grid_col = 0; grid_col < 16; grid_col++) { // Iterate 16 times for grid columns (0-F)
             dram_row = (grid_row << 4) | grid_col; // Calculate actual DRAM row (0-255)
-            read_val = dram_read_fpm(dram_row, 0, 16); // Read first 16 bits from column 0
-            printf("%04lX ", read_val & 0xFFFF); // Print 16-bit value (4 hex chars)
+            dram_read_cols(dram_row, 0, 16, read_buf); // Read first 16 bits from column 0
+            printf("%02X%02X ", read_buf[1], read_buf[0]); // Print 16-bit value (4 hex chars)
         }
         printf("\r\n"); 
     }
     // printf("DRAM Scan Complete.\r\n");
 }
 
-// Test DRAM functionality
+// Read and display rows as a byte-wise hex dump
 void dram_readpages(uint8_t startrow,uint8_t rows) {
-    uint8_t read_val;
-    uint8_t page_buffer[32]; // Buffer to hold 256 bits (32 bytes)
-    uint8_t current_byte;
-    uint8_t bit_index;
-
-    for (uint8_t row = startrow; row < startrow+rows; row++) {
-        current_byte = 0;
-        bit_index = 0;
-
-        // Read the current page (Row 'row', Columns 0-255)
-        for (uint16_t col = 0; col < 256; col++) {
-            read_val = dram_read_bit(row, (uint8_t)col); // Read bit from current row, current column
-
-            // Assemble bits into bytes
-            if (read_val) {
-                current_byte |= (1 << bit_index);
-            }
+    uint8_t page_buffer[DRAM_ROW_BYTES]; // Buffer to hold 256 bits (32 bytes)
 
-            bit_index++;
-            if (bit_index == 8) {
-                page_buffer[col / 8] = current_byte;
-                current_byte = 0;
-                bit_index = 0;
-            }
-        }
+    for (uint16_t row = startrow; row < startrow+rows; row++) {
+        dram_read_row(row, page_buffer);
 
         // Print the hex dump of the current page on a single line
         printf("Row %02X: ", row); // Print row number at the start
-        for (uint8_t i = 0; i < 32; i++) {
+        for (uint8_t i = 0; i < DRAM_ROW_BYTES; i++) {
             printf("%02X ", page_buffer[i]);
         }
         printf("\r\n"); // Add a single newline after printing all 32 bytes
     }
 }
 
+// Fill a full page (256 columns) with a repeating 32 bit pattern, eight bytes
+// (the longest burst, with four chips) at a time
 void dram_write_page(uint8_t row, uint32_t pattern) {
-    // Write a full page (256 bits) to DRAM
-    for (uint16_t col = 0; col < 256; col++) {
-        dram_write_bit(row, (uint8_t)col, (pattern>>(col&31))&1); // Write each bit
+    uint8_t page_buffer[8];
+
+    for (uint8_t i = 0; i < sizeof(page_buffer); i++) {
+        page_buffer[i] = pattern >> (8 * (i & 3));
+    }
+    for (uint16_t i = 0; i < DRAM_ROW_BYTES; i += sizeof(page_buffer)) {
+        dram_fpm_write_kernel(row, DRAM_BIT_COL(8 * i), page_buffer, sizeof(page_buffer));
     }
 }
 
 // Refresh a single row
 void dram_set_row(uint8_t row,int32_t reps) {
+    dram_set_row_pulse(row, reps, 0);
+}
+
+// dram_set_row() with RAS held low for 'width' delay loop iterations per
+// glitch; width 0 is the shortest pulse, two back-to-back stores
+void dram_set_row_pulse(uint8_t row, int32_t reps, uint8_t width) {
+    DRAM_OP_BEGIN();
+    DRAM_STATS_ENTER();
+    dram_close_page();
+    DRAM_TRACE_ENTER(DRAM_TRACE_TAG_SET_ROW);
+
     // RAS-only refresh cycle
-    GPIOD->BSHR = DRAM_RAS_PIN;   // RAS high (inactive)
-    GPIOD->BSHR = DRAM_CAS_PIN;   // CAS high (inactive)
+    DRAM_CTRL_PORT->BSHR = DRAM_RAS_PIN;   // RAS high (inactive)
+    DRAM_CTRL_PORT->BSHR = DRAM_CAS_PIN;   // CAS high (inactive)
     DRAM_ADDR_PORT->OUTDR = row;  // Set row address
     DELAY_3_CYCLES();             // Make sure row address is latched
 
-    for (int32_t i=0; i<reps; i++) {
-        GPIOD->BCR = DRAM_RAS_PIN;    // RAS low (active)
-        GPIOD->BSHR = DRAM_RAS_PIN;   // RAS high (inactive)
-        DELAY_RP_CYCLES();            // RAS precharge time -> ensureds bitlines are at VDD/2
+    if (width == 0) {
+        for (int32_t i=0; i<reps; i++) {
+            DRAM_CTRL_PORT->BCR = DRAM_RAS_PIN;    // RAS low (active)
+            DRAM_CTRL_PORT->BSHR = DRAM_RAS_PIN;   // RAS high (inactive)
+            DELAY_RP_CYCLES();            // RAS precharge time -> ensureds bitlines are at VDD/2
+        }
+    } else {
+        for (int32_t i=0; i<reps; i++) {
+            DRAM_CTRL_PORT->BCR = DRAM_RAS_PIN;    // RAS low (active)
+            DELAY_LOOP(width);
+            DRAM_CTRL_PORT->BSHR = DRAM_RAS_PIN;   // RAS high (inactive)
+            DELAY_RP_CYCLES();
+        }
     }
 
-    dram_refresh_row(row);             // Refresh the row to ensure stable levels on the cells
+    DRAM_TRACE_LEAVE();
+    dram_refresh_row_raw(row);         // Refresh the row to ensure stable levels on the cells
+    DRAM_STATS_ADD(activations, reps > 0 ? reps : 0);
+    DRAM_STATS_LEAVE(DRAM_STATS_SET_ROW);
+    DRAM_OP_END();
 }
 
 // Copy a row to another row
 void dram_copyrow(uint8_t row1, uint8_t row2) {
+    DRAM_OP_BEGIN();
+    DRAM_STATS_ENTER();
+    dram_close_page();
+    DRAM_TRACE_ENTER(DRAM_TRACE_TAG_COPYROW);
+
     // Ensure read mode
-    GPIOD->BSHR = DRAM_WR_PIN;  // W/R high (read mode)
+    DRAM_CTRL_PORT->BSHR = DRAM_WR_PIN;  // W/R high (read mode)
     
     // Set row address
     DRAM_ADDR_PORT->OUTDR = row1;
     DELAY_RP_CYCLES();         // RAS precharge time
-    GPIOD->BCR = DRAM_RAS_PIN;  // RAS low (active)  
+    DRAM_CTRL_PORT->BCR = DRAM_RAS_PIN;  // RAS low (active)  
+    dram_refresh_mark(row1);
     DELAY_RCD_CYCLES();         // RAS to CAS delay
     DRAM_ADDR_PORT->OUTDR = row2;
     DELAY_2_CYCLES();           // RAS to CAS delay
 
     // Open row2 while bitlines are still precharged with row1 content
-    GPIOD->BSHR = DRAM_RAS_PIN; // RAS high (inactive)
+    DRAM_CTRL_PORT->BSHR = DRAM_RAS_PIN; // RAS high (inactive)
     // violate RAS precharge time
-    GPIOD->BCR = DRAM_RAS_PIN;  // RAS low (active)    
+    DRAM_CTRL_PORT->BCR = DRAM_RAS_PIN;  // RAS low (active)    
+    dram_refresh_mark(row2);
      
     DELAY_RAS_CYCLES();         // CAS pulse width
         
     // End cycle
-    GPIOD->BSHR = DRAM_RAS_PIN; // RAS high (inactive)
+    DRAM_CTRL_PORT->BSHR = DRAM_RAS_PIN; // RAS high (inactive)
+    DELAY_RP_CYCLES();          // RAS precharge time
+    DRAM_TRACE_LEAVE();
+    DRAM_STATS_ADD(activations, 2);
+    DRAM_STATS_LEAVE(DRAM_STATS_COPYROW);
+    DRAM_OP_END();
+}
+// Open rows r0, r1 and r2 at the same time. The first two RAS pulses end
+// before the sense amplifiers fire and the next row is opened while the word
+// line of the previous one is still up, so all three rows share the bitlines
+// and the sense amplifiers latch the bitwise majority into all of them. The
+// rows must share sense amplifiers (see dram_copy.h).
+void dram_activate_triple(uint8_t r0, uint8_t r1, uint8_t r2) {
+    DRAM_OP_BEGIN();
+    DRAM_STATS_ENTER();
+    dram_close_page();
+    DRAM_TRACE_ENTER(DRAM_TRACE_TAG_TRIPLE);
+
+    // Ensure read mode
+    DRAM_CTRL_PORT->BSHR = DRAM_WR_PIN;  // W/R high (read mode)
+
+    DRAM_ADDR_PORT->OUTDR = r0;
+    DELAY_RP_CYCLES();          // RAS precharge time
+    DRAM_CTRL_PORT->BCR = DRAM_RAS_PIN;  // RAS low, r0 shares its charge
+    DRAM_CTRL_PORT->BSHR = DRAM_RAS_PIN; // RAS high before sensing
+    DRAM_ADDR_PORT->OUTDR = r1;
+    DRAM_CTRL_PORT->BCR = DRAM_RAS_PIN;  // RAS low, r1 joins r0
+    DRAM_CTRL_PORT->BSHR = DRAM_RAS_PIN; // RAS high before sensing
+    DRAM_ADDR_PORT->OUTDR = r2;
+    DRAM_CTRL_PORT->BCR = DRAM_RAS_PIN;  // RAS low, r2 joins and the sense amps fire
+    dram_refresh_mark(r0);
+    dram_refresh_mark(r1);
+    dram_refresh_mark(r2);
+    DELAY_RAS_CYCLES();         // restore the result into all three rows
+
+    // End cycle
+    DRAM_CTRL_PORT->BSHR = DRAM_RAS_PIN; // RAS high (inactive)
     DELAY_RP_CYCLES();          // RAS precharge time
+    DRAM_TRACE_LEAVE();
+    DRAM_STATS_ADD(activations, 3);
+    DRAM_STATS_LEAVE(DRAM_STATS_IN_ARRAY);
+    DRAM_OP_END();
+}
+
+
+// Copy row src into each of the rows in dst with one RAS cycle per row: after
+// the first copy the bitlines still hold the data, so every further row only
+// needs another short-precharge activation (see dram_copyrow()).
+void dram_copyrow_fanout(uint8_t src, const uint8_t *dst, uint8_t count) {
+    DRAM_OP_BEGIN();
+    DRAM_STATS_ENTER();
+    dram_close_page();
+    DRAM_STATS_ADD(activations, 1 + count);
+    DRAM_TRACE_ENTER(DRAM_TRACE_TAG_COPYROW);
+
+    // Ensure read mode
+    DRAM_CTRL_PORT->BSHR = DRAM_WR_PIN;  // W/R high (read mode)
+
+    // Sense the source row
+    DRAM_ADDR_PORT->OUTDR = src;
+    DELAY_RP_CYCLES();          // RAS precharge time
+    DRAM_CTRL_PORT->BCR = DRAM_RAS_PIN;  // RAS low (active)
+    dram_refresh_mark(src);
+    DELAY_RAS_CYCLES();         // let the sense amplifiers latch
+
+    while (count--) {
+        DRAM_ADDR_PORT->OUTDR = *dst;
+        DELAY_2_CYCLES();           // Delay for address setup time
+
+        // violate RAS precharge time
+        DRAM_CTRL_PORT->BSHR = DRAM_RAS_PIN; // RAS high (inactive)
+        DRAM_CTRL_PORT->BCR = DRAM_RAS_PIN;  // RAS low (active)
+        dram_refresh_mark(*dst++);
+
+        DELAY_RAS_CYCLES();         // restore the copied data into the row
+    }
+
+    // End cycle
+    DRAM_CTRL_PORT->BSHR = DRAM_RAS_PIN; // RAS high (inactive)
+    DELAY_RP_CYCLES();          // RAS precharge time
+    DRAM_TRACE_LEAVE();
+    DRAM_STATS_LEAVE(DRAM_STATS_IN_ARRAY);
+    DRAM_OP_END();
+}
+
+#ifdef DRAM_WITH_HAMMER
+// Alternate RAS-only activations of rows a and b, 'pairs' times each pair
+// (a == b hammers a single row), as fast as the calibrated kernel timing
+// allows: the row address goes out during the precharge, and RAS stays low
+// for t.rcd + t.cas, the time a kernel access holds the row open before its
+// first column, but at least tRAS min so that every activation restores its
+// row. Runs from SRAM and keeps the refresh engine out, so callers split long
+// runs into chunks well inside the refresh interval. Only built with the
+// hammer module, since SRAM functions are kept even when nothing calls them.
+#define DRAM_TRAS_MIN_LOOPS 3   // 10 cycles, tRAS min of the 4164-20 is 200 ns (9.6 cycles)
+
+DRAM_SRAM_FUNC
+void dram_hammer_rows(uint8_t a, uint8_t b, uint32_t pairs) {
+    const dram_timing_t t = dram_timing;
+    uint8_t ras = t.rcd + t.cas;
+
+    if (pairs == 0) {
+        return;
+    }
+    if (ras < DRAM_TRAS_MIN_LOOPS) {
+        ras = DRAM_TRAS_MIN_LOOPS;
+    }
+    DRAM_OP_BEGIN();
+    DRAM_STATS_ENTER();
+    dram_close_page();
+    DRAM_STATS_ADD(activations, 2 * pairs);
+
+    do {
+        DRAM_ADDR_PORT->OUTDR = a;
+        DELAY_LOOP(t.rp);                   // RAS precharge, with the address store
+        DRAM_CTRL_PORT->BCR = DRAM_RAS_PIN;  // RAS low, row a restored
+        DELAY_LOOP(ras);
+        DRAM_CTRL_PORT->BSHR = DRAM_RAS_PIN; // RAS high
+        DRAM_ADDR_PORT->OUTDR = b;
+        DELAY_LOOP(t.rp);
+        DRAM_CTRL_PORT->BCR = DRAM_RAS_PIN;  // RAS low, row b restored
+        DELAY_LOOP(ras);
+        DRAM_CTRL_PORT->BSHR = DRAM_RAS_PIN; // RAS high
+    } while (--pairs);
+
+    dram_refresh_mark(a);
+    dram_refresh_mark(b);
+    DELAY_LOOP(t.rp);
+    DRAM_STATS_LEAVE(DRAM_STATS_HAMMER);
+    DRAM_OP_END();
 }
+#endif
@@ -3,36 +3,187 @@
 
 #include "ch32fun.h"
 
-// Pin definitions for 4164 DRAM according to updated README
-// Address bus on PORT C
-#define DRAM_ADDR_PORT GPIOC
-#define DRAM_ADDR_MASK 0xFF  // PC0-PC7 for address bus
-
-// Control pins on PORT D
-#define DRAM_DIN_PIN  GPIO_Pin_0  // PD0 for Data In
-#define DRAM_CAS_PIN  GPIO_Pin_2  // PD2 for Column Address Strobe
-#define DRAM_RAS_PIN  GPIO_Pin_3  // PD3 for Row Address Strobe
-#define DRAM_WR_PIN   GPIO_Pin_4  // PD4 for Write/Read control
-#define DRAM_DOUT_PIN GPIO_Pin_5  // PD5 for Data Out
+// Number of 4164s on the bus: 1, 2 or 4. The chips share the address bus,
+// RAS, CAS and W, so every column cycle moves one bit per chip (a column
+// "word", bit k = chip k) and the row operations (refresh, copy, compute) act
+// on all of them at once.
+#ifndef DRAM_CHIPS
+#define DRAM_CHIPS 1
+#endif
+
+// Ports and pin numbers come from the board description
+#include "dram_board.h"
+
+#define DRAM_GPIO_(x)     GPIO##x
+#define DRAM_GPIO(x)      DRAM_GPIO_(x)
+#define DRAM_GPIO_RCC_(x) RCC_APB2Periph_GPIO##x
+#define DRAM_GPIO_RCC(x)  DRAM_GPIO_RCC_(x)
+#define DRAM_GPIO_ID_A    0
+#define DRAM_GPIO_ID_C    2
+#define DRAM_GPIO_ID_D    3
+#define DRAM_GPIO_ID_(x)  DRAM_GPIO_ID_##x
+#define DRAM_GPIO_ID(x)   DRAM_GPIO_ID_(x)   // port number, usable in #if
+
+#define DRAM_ADDR_PORT    DRAM_GPIO(DRAM_ADDR_GPIO)
+#define DRAM_CTRL_PORT    DRAM_GPIO(DRAM_CTRL_GPIO)
+#define DRAM_ADDR_MASK    0xFF  // pins 0-7 of the address port
+
+#define DRAM_CAS_PIN  (1u << DRAM_CAS_BIT)  // Column Address Strobe
+#define DRAM_RAS_PIN  (1u << DRAM_RAS_BIT)  // Row Address Strobe
+#define DRAM_WR_PIN   (1u << DRAM_WR_BIT)   // Write/Read control
+
+// DRAM_DOUT_WORD() gathers the column word from an INDR value of the control
+// port with constant shifts
+#define DRAM_DOUT_TERM(indr, k) (((((uint32_t)(indr)) >> DRAM_DOUT_CHIP_BIT(k)) & 1) << (k))
+
+#if DRAM_CHIPS == 1
+#define DRAM_DIN_PIN  (1u << DRAM_DIN_BIT)   // Data In
+#define DRAM_DOUT_PIN (1u << DRAM_DOUT_BIT)  // Data Out
+#define DRAM_DIN_CHIP_BIT(k)  DRAM_DIN_BIT
+#define DRAM_DOUT_CHIP_BIT(k) DRAM_DOUT_BIT
+#define DRAM_DOUT_WORD(indr)  DRAM_DOUT_TERM(indr, 0)
+#elif DRAM_CHIPS == 2 || DRAM_CHIPS == 4
+// There are not enough pins for a DIN and a DOUT line per chip, so DIN and
+// DOUT of each chip are tied together (common I/O). The pins are inputs
+// except during early write cycles, when DOUT stays high-Z.
+#define DRAM_DQ_PIN(k)        (1u << DRAM_DQ_BIT(k))
+#define DRAM_DIN_CHIP_BIT(k)  DRAM_DQ_BIT(k)
+#define DRAM_DOUT_CHIP_BIT(k) DRAM_DQ_BIT(k)
+#if DRAM_CHIPS == 2
+#define DRAM_DQ_BIT(k)        ((k) ? DRAM_DQ1_BIT : DRAM_DQ0_BIT)
+#define DRAM_DOUT_WORD(indr)  (DRAM_DOUT_TERM(indr, 0) | DRAM_DOUT_TERM(indr, 1))
+#else
+#define DRAM_DQ_BIT(k)        ((k) == 0 ? DRAM_DQ0_BIT : (k) == 1 ? DRAM_DQ1_BIT : (k) == 2 ? DRAM_DQ2_BIT : DRAM_DQ3_BIT)
+#if DRAM_DQ1_BIT > 0 && DRAM_DQ2_BIT == DRAM_DQ1_BIT + 1 && DRAM_DQ3_BIT == DRAM_DQ1_BIT + 2
+// chips 1-3 on adjacent pins (the default board): one shift for the three
+#define DRAM_DOUT_WORD(indr)  (DRAM_DOUT_TERM(indr, 0) | ((((uint32_t)(indr)) >> (DRAM_DQ1_BIT - 1)) & 0x0E))
+#else
+#define DRAM_DOUT_WORD(indr)  (DRAM_DOUT_TERM(indr, 0) | DRAM_DOUT_TERM(indr, 1) | \
+                               DRAM_DOUT_TERM(indr, 2) | DRAM_DOUT_TERM(indr, 3))
+#endif
+#endif
+#else
+#error "DRAM_CHIPS must be 1, 2 or 4"
+#endif
+
+#define DRAM_DIN_CHIP_PIN(k)  (1u << DRAM_DIN_CHIP_BIT(k))
+#define DRAM_DOUT_CHIP_PIN(k) (1u << DRAM_DOUT_CHIP_BIT(k))
+
+#define DRAM_WORD_MASK ((1 << DRAM_CHIPS) - 1)
+
+// Array geometry. Data bits are interleaved over the chips: bit b of a row
+// lives in column b / DRAM_CHIPS of chip b % DRAM_CHIPS, so the burst
+// primitives take a column address and count data bits.
+#define DRAM_COLS      256
+#define DRAM_ROW_BITS  (DRAM_COLS * DRAM_CHIPS)
+#define DRAM_ROW_BYTES (DRAM_ROW_BITS / 8)
+#define DRAM_BIT_COL(bit) ((bit) / DRAM_CHIPS)   // column holding data bit 'bit'
+
+// Code that has to run from SRAM (no flash wait states, see instruction_timing/)
+#ifdef DRAM_SIM
+#define DRAM_SRAM_FUNC __attribute__((noinline))
+#else
+#define DRAM_SRAM_FUNC __attribute__((section(".srodata"))) __attribute__((used)) __attribute__((noinline))
+#endif
+
+// Open-page statistics
+typedef struct {
+    uint32_t hits;      // accesses that found their row already open
+    uint32_t misses;    // accesses that had to close another row first
+    uint32_t expired;   // row hits that were reopened because of tRAS max
+    uint32_t activations; // RAS activations of the page mode primitives and SRAM kernels, open page or not
+} dram_page_stats_t;
+
+// Timing of the SRAM kernels, in iterations of a delay loop that takes 4n-2
+// cycles (n >= 1). The other primitives use the fixed datasheet delays.
+typedef struct {
+    uint8_t rcd;    // RAS to CAS delay
+    uint8_t cas;    // CAS low time before DOUT is sampled / write pulse
+    uint8_t cp;     // CAS precharge between page mode columns
+    uint8_t rp;     // RAS precharge
+} dram_timing_t;
+
+#define DRAM_TIMING_DATASHEET {1, 2, 1, 2}  // at least the datasheet values at 48 MHz
+#define DRAM_TIMING_MAX 4
+
+extern dram_timing_t dram_timing;
 
 // Function prototypes
 void dram_init(void);
 
+// Open-page mode: keep the last row active between dram_read_bit/dram_write_bit/dram_read_fpm/dram_write_fpm calls
+uint8_t dram_set_open_page(uint8_t enable);
+void dram_close_page(void);
+void dram_page_timeout(void);   // from the SysTick compare interrupt, see dram.c
+void dram_get_page_stats(dram_page_stats_t *stats);
+void dram_reset_page_stats(void);
+
+// Single column: one bit per chip (the column word)
 void dram_write_bit(uint8_t row, uint8_t col, uint8_t data);
 uint8_t dram_read_bit(uint8_t row, uint8_t col);
 
+// Up to 32 data bits starting at a column; bits is a multiple of DRAM_CHIPS
 void dram_write_fpm(uint8_t row, uint8_t col_start, uint32_t data_val, uint8_t bits);
 uint32_t dram_read_fpm(uint8_t row, uint8_t col, uint8_t bits);
 
+// Read-modify-write: returns the bit to store, given its old value and its
+// position within the burst (data bit index, see DRAM_BIT_COL())
+typedef uint8_t (*dram_rmw_fn)(uint8_t old_bit, uint8_t index, void *ctx);
+
+uint8_t dram_rmw_bit(uint8_t row, uint8_t col, dram_rmw_fn fn, void *ctx);
+uint32_t dram_rmw_fpm(uint8_t row, uint8_t col, uint8_t bits, dram_rmw_fn fn, void *ctx);
+uint32_t dram_rmw_xor(uint8_t row, uint8_t col, uint8_t bits, uint32_t mask);
+uint32_t dram_rmw_increment(uint8_t row, uint8_t col, uint8_t bits);
+
+// Burst access, bits packed LSB first (column 0 = bit 0 of buf[0]). The
+// strided variants count columns, the others data bits. RAS must not stay low
+// longer than the 10 us tRAS max, so longer bursts are split into RAS cycles
+// of DRAM_BURST_COLS columns in the SRAM kernels (dram_read_row(), ~13 cycles
+// per column) and DRAM_STRIDED_BURST_COLS in the flash loops (the strided and
+// column variants, dram_read_fpm(), dram_write_fpm() and dram_rmw_fpm(), up
+// to ~34 cycles per column on hardware).
+#define DRAM_BURST_COLS         16
+#if defined(DRAM_TRACE) && !defined(DRAM_SIM)
+#define DRAM_STRIDED_BURST_COLS 1   // the traced flash loops take hundreds of cycles per column
+#else
+#define DRAM_STRIDED_BURST_COLS 8
+#endif
+#define DRAM_BURST_BYTES        (DRAM_BURST_COLS * DRAM_CHIPS / 8)
+void dram_read_row(uint8_t row, uint8_t buf[DRAM_ROW_BYTES]);
+void dram_write_row(uint8_t row, const uint8_t buf[DRAM_ROW_BYTES]);
+// Any number of bytes through the same kernels, for walking a row in
+// DRAM_BURST_BYTES pieces without a row sized buffer
+void dram_read_burst(uint8_t row, uint8_t col, uint8_t *buf, uint8_t nbytes);
+void dram_write_burst(uint8_t row, uint8_t col, const uint8_t *buf, uint8_t nbytes);
+void dram_read_cols(uint8_t row, uint8_t col, uint16_t bits, uint8_t *buf);
+void dram_write_cols(uint8_t row, uint8_t col, uint16_t bits, const uint8_t *buf);
+void dram_read_strided(uint8_t row, uint8_t col, uint8_t stride, uint16_t count, uint8_t *buf);
+void dram_write_strided(uint8_t row, uint8_t col, uint8_t stride, uint16_t count, const uint8_t *buf);
+
+// Unrolled SRAM kernels for fixed burst lengths (dram_read_row/dram_write_row
+// use the same kernels). Each DRAM_BURST_COLS columns take one RAS cycle: with
+// one chip the 32 bit variants span 32 columns and activate the row twice.
+uint8_t dram_read_fpm8(uint8_t row, uint8_t col);
+uint16_t dram_read_fpm16(uint8_t row, uint8_t col);
+uint32_t dram_read_fpm32(uint8_t row, uint8_t col);
+void dram_write_fpm8(uint8_t row, uint8_t col, uint8_t data);
+void dram_write_fpm16(uint8_t row, uint8_t col, uint16_t data);
+void dram_write_fpm32(uint8_t row, uint8_t col, uint32_t data);
+
 void dram_readpages(uint8_t startpage, uint8_t pages);
 void dram_readpages_fpm(uint8_t startrow,uint8_t rows);
+void dram_write_page(uint8_t row, uint32_t pattern);
 
 void dram_scan_array();
 
 void dram_refresh_row(uint8_t row);
 
 void dram_set_row(uint8_t row,int32_t reps);
+void dram_set_row_pulse(uint8_t row, int32_t reps, uint8_t width);
 
 void dram_copyrow(uint8_t row1, uint8_t row2);
+void dram_copyrow_fanout(uint8_t src, const uint8_t *dst, uint8_t count);
+void dram_activate_triple(uint8_t r0, uint8_t r1, uint8_t r2);
+void dram_hammer_rows(uint8_t a, uint8_t b, uint32_t pairs);
 
 #endif // DRAM_H
\ No newline at end of file
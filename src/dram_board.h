@@ -0,0 +1,44 @@
+#ifndef DRAM_BOARD_H
+#define DRAM_BOARD_H
+
+// Board description: the GPIO port and pin of every DRAM signal. dram.h and
+// dram.c derive the pin masks, the CFGLR values for dram_init() and the BSHR
+// words of the access kernels from these numbers at compile time, so another
+// wiring costs nothing at run time. Build with -DDRAM_BOARD='"myboard.h"' to
+// use a header with the same defines instead of the wiring in the README.
+//
+// Constraints the kernels rely on:
+// - A0-A7 are pins 0-7 of DRAM_ADDR_GPIO, in order (one OUTDR store per
+//   address)
+// - RAS, CAS, W and the data pins share DRAM_CTRL_GPIO (pins 0-7), so a
+//   control edge and the data can go out in the same BSHR store
+// - with several chips (DRAM_CHIPS 2 or 4), chip k's common I/O pin is
+//   DRAM_DQk_BIT; with one chip DIN and DOUT are separate pins
+
+#ifndef DRAM_CHIPS
+#define DRAM_CHIPS 1
+#endif
+
+#ifdef DRAM_BOARD
+#include DRAM_BOARD
+#else
+#define DRAM_ADDR_GPIO  C   // PC0-PC7: A0-A7
+#define DRAM_CTRL_GPIO  D
+
+#define DRAM_CAS_BIT    2   // PD2
+#define DRAM_RAS_BIT    3   // PD3
+#define DRAM_WR_BIT     4   // PD4
+
+#if DRAM_CHIPS == 1
+#define DRAM_DIN_BIT    0   // PD0
+#define DRAM_DOUT_BIT   5   // PD5
+#else
+// PD7 needs the NRST function disabled in the option bytes
+#define DRAM_DQ0_BIT    0   // PD0
+#define DRAM_DQ1_BIT    5   // PD5
+#define DRAM_DQ2_BIT    6   // PD6
+#define DRAM_DQ3_BIT    7   // PD7
+#endif
+#endif
+
+#endif // DRAM_BOARD_H
@@ -0,0 +1,232 @@
+#include "dram_compute.h"
+#include <string.h>
+
+typedef struct {
+    uint8_t zeros;      // control row of all 0s
+    uint8_t ones;       // control row of all 1s
+    uint8_t t[3];       // compute rows, overwritten by every operation
+    uint8_t ok;         // majority passed its self test
+} compute_unit_t;
+
+static compute_unit_t units[DRAM_COPY_CLASSES];    // indexed by copy class
+static dram_compute_stats_t compute_stats;
+
+#define COMPUTE_COPY 4      // internal: the first operand unchanged
+
+static const uint8_t op_operands[] = {3, 2, 2, 1, 1};
+
+static uint8_t compute_byte(uint8_t op, uint8_t a, uint8_t b, uint8_t c) {
+    switch (op) {
+    case DRAM_COMPUTE_MAJ: return (a & b) | (a & c) | (b & c);
+    case DRAM_COMPUTE_AND: return a & b;
+    case DRAM_COMPUTE_OR:  return a | b;
+    case DRAM_COMPUTE_NOT: return ~a;
+    default:               return a;
+    }
+}
+
+// Bytes i .. i + DRAM_BURST_BYTES - 1 of the result, from one burst of each
+// operand row, so no operation needs a row sized buffer
+static void compute_burst(uint8_t op, const uint8_t *rows, uint16_t i, uint8_t out[DRAM_BURST_BYTES]) {
+    uint8_t in[3][DRAM_BURST_BYTES] = {{0}};
+
+    for (uint8_t k = 0; k < op_operands[op]; k++) {
+        dram_read_burst(rows[k], DRAM_BIT_COL(8 * i), in[k], DRAM_BURST_BYTES);
+    }
+    for (uint8_t j = 0; j < DRAM_BURST_BYTES; j++) {
+        out[j] = compute_byte(op, in[0][j], in[1][j], in[2][j]);
+    }
+}
+
+// Compare 'row' with the CPU result and rewrite the bursts that differ.
+// Returns 1 if any did.
+static uint8_t compute_fix(uint8_t op, uint8_t row, const uint8_t *rows) {
+    uint8_t fixed = 0;
+
+    for (uint16_t i = 0; i < DRAM_ROW_BYTES; i += DRAM_BURST_BYTES) {
+        uint8_t ref[DRAM_BURST_BYTES], buf[DRAM_BURST_BYTES];
+        compute_burst(op, rows, i, ref);
+        dram_read_burst(row, DRAM_BIT_COL(8 * i), buf, DRAM_BURST_BYTES);
+        if (memcmp(ref, buf, DRAM_BURST_BYTES)) {
+            dram_write_burst(row, DRAM_BIT_COL(8 * i), ref, DRAM_BURST_BYTES);
+            fixed = 1;
+        }
+    }
+    return fixed;
+}
+
+// Byte i of the self test row k
+static uint8_t compute_test_byte(uint16_t i, uint8_t k, uint8_t cls) {
+    return (uint8_t)((i * 0x3B) ^ (k * 0x95) ^ (cls * 0x17) ^ (i << k));
+}
+
+// Reserve the top rows of every copy class that copy into each other in both
+// directions, write the control rows and check the majority on random data.
+// Returns the number of classes that can compute in the array.
+uint8_t dram_compute_init(void) {
+    uint8_t classes = 0;
+
+    for (uint8_t cls = 1; cls < DRAM_COPY_CLASSES; cls++) {
+        compute_unit_t *unit = &units[cls];
+        uint8_t rows[DRAM_COMPUTE_RESERVED];
+        uint8_t count = 0, entry = 0xFF;
+
+        unit->ok = 0;
+        for (int16_t row = 255; row >= 0 && count < DRAM_COMPUTE_RESERVED; row--) {
+            uint8_t usable = 1;
+            if (dram_copy_class(row) != cls) {
+                continue;
+            }
+            if (entry == 0xFF) {
+                entry = dram_copy_entry(row);
+            }
+            for (uint8_t i = 0; i < count; i++) {
+                if (!dram_copy_valid(row, rows[i]) || !dram_copy_valid(rows[i], row)) {
+                    usable = 0;
+                }
+            }
+            if (usable && dram_copy_entry(row) == entry) {
+                rows[count++] = row;
+            }
+        }
+        if (count < DRAM_COMPUTE_RESERVED) {
+            continue;
+        }
+        unit->zeros = rows[0];
+        unit->ones = rows[1];
+        unit->t[0] = rows[2];
+        unit->t[1] = rows[3];
+        unit->t[2] = rows[4];
+
+        dram_write_page(unit->zeros, 0);
+        dram_write_page(unit->ones, 0xFFFFFFFF);
+
+        // Self test: majority of three pseudo-random rows
+        for (uint8_t k = 0; k < 3; k++) {
+            for (uint16_t i = 0; i < DRAM_ROW_BYTES; i += DRAM_BURST_BYTES) {
+                uint8_t buf[DRAM_BURST_BYTES];
+                for (uint8_t j = 0; j < DRAM_BURST_BYTES; j++) {
+                    buf[j] = compute_test_byte(i + j, k, cls);
+                }
+                dram_write_burst(unit->t[k], DRAM_BIT_COL(8 * i), buf, DRAM_BURST_BYTES);
+            }
+        }
+        dram_activate_triple(unit->t[0], unit->t[1], unit->t[2]);
+        unit->ok = 1;
+        for (uint8_t k = 0; k < 3; k++) {
+            for (uint16_t i = 0; i < DRAM_ROW_BYTES; i += DRAM_BURST_BYTES) {
+                uint8_t buf[DRAM_BURST_BYTES];
+                dram_read_burst(unit->t[k], DRAM_BIT_COL(8 * i), buf, DRAM_BURST_BYTES);
+                for (uint8_t j = 0; j < DRAM_BURST_BYTES; j++) {
+                    uint16_t n = i + j;
+                    if (buf[j] != compute_byte(DRAM_COMPUTE_MAJ, compute_test_byte(n, 0, cls),
+                                               compute_test_byte(n, 1, cls), compute_test_byte(n, 2, cls))) {
+                        unit->ok = 0;
+                    }
+                }
+            }
+        }
+        classes += unit->ok;
+    }
+    return classes;
+}
+
+// 1 if dram_compute_init() took 'row' for control or compute use
+uint8_t dram_compute_reserved(uint8_t row) {
+    const compute_unit_t *unit = &units[dram_copy_class(row)];
+
+    return unit->ok && (row == unit->zeros || row == unit->ones ||
+                        row == unit->t[0] || row == unit->t[1] || row == unit->t[2]);
+}
+
+// 1 if the operation on these rows (a, b, c) would run in the array. An
+// operand in a reserved row could be one of the compute rows, which the copies
+// overwrite before it is read.
+uint8_t dram_compute_in_array(uint8_t op, uint8_t dst, const uint8_t *rows) {
+    const compute_unit_t *unit = &units[dram_copy_class(dst)];
+
+    if (dram_compute_reserved(dst)) {
+        return 0;
+    }
+    for (uint8_t i = 0; i < op_operands[op]; i++) {
+        if (dram_compute_reserved(rows[i])) {
+            return 0;
+        }
+    }
+    if (op == DRAM_COMPUTE_NOT) {
+        return dram_copy_inverts(rows[0], dst);
+    }
+    if (!unit->ok || !dram_copy_valid(unit->t[0], dst)) {
+        return 0;
+    }
+    for (uint8_t i = 0; i < op_operands[op]; i++) {
+        if (!dram_copy_valid(rows[i], unit->t[i])) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static uint8_t compute_row_op(uint8_t op, uint8_t dst, uint8_t a, uint8_t b, uint8_t c) {
+    const uint8_t rows[3] = {a, b, c};
+    const compute_unit_t *unit = &units[dram_copy_class(dst)];
+    uint8_t fixed;
+
+    if (dram_compute_reserved(dst)) {
+        return DRAM_COMPUTE_REFUSED;
+    }
+    if (!dram_compute_in_array(op, dst, rows)) {
+        // Burst by burst, all operands are read before dst is written
+        for (uint16_t i = 0; i < DRAM_ROW_BYTES; i += DRAM_BURST_BYTES) {
+            uint8_t out[DRAM_BURST_BYTES];
+            compute_burst(op, rows, i, out);
+            dram_write_burst(dst, DRAM_BIT_COL(8 * i), out, DRAM_BURST_BYTES);
+        }
+        compute_stats.cpu++;
+        return 0;
+    }
+
+    if (op == DRAM_COMPUTE_NOT) {
+        dram_copyrow(a, dst);               // never in place, see dram_copy_inverts()
+        fixed = compute_fix(op, dst, rows);
+    } else {
+        dram_copyrow(a, unit->t[0]);
+        dram_copyrow(b, unit->t[1]);
+        dram_copyrow(op == DRAM_COMPUTE_MAJ ? c : (op == DRAM_COMPUTE_AND ? unit->zeros : unit->ones), unit->t[2]);
+        dram_activate_triple(unit->t[0], unit->t[1], unit->t[2]);
+        // dst may be an operand: check the result while they are all intact,
+        // then the copy out against it
+        fixed = compute_fix(op, unit->t[0], rows);
+        dram_copyrow(unit->t[0], dst);
+        fixed |= compute_fix(COMPUTE_COPY, dst, &unit->t[0]);
+    }
+    compute_stats.in_array++;
+    compute_stats.verify_failures += fixed;
+    return 1;
+}
+
+uint8_t dram_row_and(uint8_t dst, uint8_t a, uint8_t b) {
+    return compute_row_op(DRAM_COMPUTE_AND, dst, a, b, 0);
+}
+
+uint8_t dram_row_or(uint8_t dst, uint8_t a, uint8_t b) {
+    return compute_row_op(DRAM_COMPUTE_OR, dst, a, b, 0);
+}
+
+uint8_t dram_row_maj(uint8_t dst, uint8_t a, uint8_t b, uint8_t c) {
+    return compute_row_op(DRAM_COMPUTE_MAJ, dst, a, b, c);
+}
+
+uint8_t dram_row_not(uint8_t dst, uint8_t a) {
+    return compute_row_op(DRAM_COMPUTE_NOT, dst, a, 0, 0);
+}
+
+void dram_get_compute_stats(dram_compute_stats_t *stats) {
+    *stats = compute_stats;
+}
+
+void dram_reset_compute_stats(void) {
+    compute_stats.in_array = 0;
+    compute_stats.cpu = 0;
+    compute_stats.verify_failures = 0;
+}
@@ -0,0 +1,60 @@
+#ifndef DRAM_COMPUTE_H
+#define DRAM_COMPUTE_H
+
+#include "dram.h"
+#include "dram_copy.h"
+
+// Bulk bitwise operations on whole rows
+//
+// Opening three rows at once (dram_activate_triple()) leaves their bitwise
+// majority in all of them. With a control row of all 0s as the third operand
+// that is AND, with all 1s it is OR. The operands are copied into three
+// compute rows first, so they survive, and the result is copied out: five RAS
+// cycles for 256 bits. NOT uses a row pair whose copy arrives inverted.
+//
+// dram_compute_init() reserves DRAM_COMPUTE_RESERVED rows in every copy class
+// (the highest rows of the class) and tests the majority on them. Operations
+// whose rows are not all in one such class, or that read a reserved row, run
+// on the CPU over FPM bursts; a reserved row as destination is refused.
+// Every in-array result is compared with the CPU result and replaced by it on
+// a mismatch. dram_fill() and dram_mem_init() keep out of the reserved rows.
+
+#define DRAM_COMPUTE_RESERVED 5     // all-0 row, all-1 row, three compute rows
+
+// Operations, for dram_compute_in_array()
+#define DRAM_COMPUTE_MAJ 0
+#define DRAM_COMPUTE_AND 1
+#define DRAM_COMPUTE_OR  2
+#define DRAM_COMPUTE_NOT 3
+
+#define DRAM_COMPUTE_REFUSED 2      // dst is a reserved row, nothing was written
+
+typedef struct {
+    uint32_t in_array;          // operations done with in-array row operations
+    uint32_t cpu;               // operations done on the CPU
+    uint32_t verify_failures;   // in-array results that differed from the CPU
+} dram_compute_stats_t;
+
+uint8_t dram_compute_init(void);
+#ifdef DRAM_WITH_COMPUTE
+uint8_t dram_compute_reserved(uint8_t row);
+#else
+// Built without the module nothing is reserved (dram_fill(), dram_mem_init())
+static inline uint8_t dram_compute_reserved(uint8_t row) {
+    (void)row;
+    return 0;
+}
+#endif
+uint8_t dram_compute_in_array(uint8_t op, uint8_t dst, const uint8_t *rows);
+
+// Return 1 if the operation ran in the array, 0 if on the CPU, or
+// DRAM_COMPUTE_REFUSED
+uint8_t dram_row_and(uint8_t dst, uint8_t a, uint8_t b);
+uint8_t dram_row_or(uint8_t dst, uint8_t a, uint8_t b);
+uint8_t dram_row_maj(uint8_t dst, uint8_t a, uint8_t b, uint8_t c);
+uint8_t dram_row_not(uint8_t dst, uint8_t a);
+
+void dram_get_compute_stats(dram_compute_stats_t *stats);
+void dram_reset_compute_stats(void);
+
+#endif // DRAM_COMPUTE_H
@@ -0,0 +1,264 @@
+#include "dram.h"
+#include "dram_console.h"
+#include "dram_refresh.h"
+#include "dram_copy.h"
+#include "dram_dump.h"
+
+#define MAX_ARGS 4
+
+#if DRAM_CONSOLE_RX > 32
+#error "rx_gap has one bit per byte of rx_buf"
+#endif
+
+static char line[DRAM_CONSOLE_LINE];
+static uint8_t line_len = 0;
+static uint8_t line_overflow = 0;
+static uint8_t command_number = 0;
+
+// Bytes received but not yet parsed. dram_console_input() only appends,
+// dram_console_poll() only removes. Bit i of rx_gap marks input dropped just
+// before rx_buf[i], so the line that the gap falls into is rejected.
+static volatile uint8_t rx_buf[DRAM_CONSOLE_RX];
+static volatile uint8_t rx_head = 0;
+static volatile uint8_t rx_tail = 0;
+static volatile uint32_t rx_gap = 0;
+static uint8_t console_running = 0;
+
+// Decimal or 0x hex. Returns 0 if 's' is not a number.
+static uint8_t parse_number(const char *s, uint32_t *value) {
+    uint8_t base = 10;
+
+    *value = 0;
+    if (s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) {
+        base = 16;
+        s += 2;
+    }
+    if (!*s) {
+        return 0;
+    }
+    for (; *s; s++) {
+        uint8_t digit;
+        if (*s >= '0' && *s <= '9') {
+            digit = *s - '0';
+        } else if (base == 16 && (*s | 0x20) >= 'a' && (*s | 0x20) <= 'f') {
+            digit = (*s | 0x20) - 'a' + 10;
+        } else {
+            return 0;
+        }
+        *value = *value * base + digit;
+    }
+    return 1;
+}
+
+static uint8_t streq(const char *a, const char *b) {
+    while (*a && *a == *b) {
+        a++;
+        b++;
+    }
+    return *a == *b;
+}
+
+static void console_reply(uint8_t status, const uint8_t *data, uint8_t len) {
+    uint8_t reply[5];
+
+    reply[0] = status;
+    for (uint8_t i = 0; i < len; i++) {
+        reply[1 + i] = data[i];
+    }
+    dram_dump_frame(DRAM_DUMP_REPLY, command_number++, reply, 1 + len);
+}
+
+// A run of bits data bits from col: a whole number of columns inside the row
+static uint8_t valid_bits(uint32_t col, uint32_t bits) {
+    return bits >= 1 && bits <= 32 && bits % DRAM_CHIPS == 0 && col + bits / DRAM_CHIPS <= DRAM_COLS;
+}
+
+// First 16 columns of every row, 64 rows per frame
+static void console_scan(void) {
+    uint8_t buf[128];
+
+    for (uint8_t chunk = 0; chunk < 4; chunk++) {
+        for (uint8_t i = 0; i < 64; i++) {
+            uint16_t data = dram_read_fpm16(chunk * 64 + i, 0);
+            buf[2 * i] = data & 0xFF;
+            buf[2 * i + 1] = data >> 8;
+        }
+        dram_dump_frame(DRAM_DUMP_DATA, chunk, buf, sizeof(buf));
+    }
+}
+
+static void console_execute(char *cmd) {
+    char *argv[MAX_ARGS + 1];
+    uint32_t arg[MAX_ARGS];
+    uint8_t argc = 0, n, result[4], result_len = 0;
+    uint8_t status = DRAM_CONSOLE_OK;
+
+    // Split at spaces
+    while (*cmd) {
+        while (*cmd == ' ' || *cmd == '\t') {
+            *cmd++ = 0;
+        }
+        if (!*cmd) {
+            break;
+        }
+        if (argc == MAX_ARGS + 1) {
+            console_reply(DRAM_CONSOLE_BAD_ARGS, 0, 0);
+            return;
+        }
+        argv[argc++] = cmd;
+        while (*cmd && *cmd != ' ' && *cmd != '\t') {
+            cmd++;
+        }
+    }
+    if (!argc) {
+        return;
+    }
+    n = argc - 1;
+    for (uint8_t i = 0; i < n; i++) {
+        if (!parse_number(argv[1 + i], &arg[i])) {
+            status = DRAM_CONSOLE_BAD_ARGS;
+        }
+    }
+
+    if (streq(argv[0], "read")) {
+        if (status || n != 3 || arg[0] > 255 || !valid_bits(arg[1], arg[2])) {
+            status = DRAM_CONSOLE_BAD_ARGS;
+        } else {
+            uint32_t value = dram_read_fpm(arg[0], arg[1], arg[2]);
+            for (uint8_t i = 0; i < 4; i++) {
+                result[i] = value >> (8 * i);
+            }
+            result_len = 4;
+        }
+    } else if (streq(argv[0], "write")) {
+        if (status || n != 4 || arg[0] > 255 || !valid_bits(arg[1], arg[3])) {
+            status = DRAM_CONSOLE_BAD_ARGS;
+        } else {
+            dram_write_fpm(arg[0], arg[1], arg[2], arg[3]);
+        }
+    } else if (streq(argv[0], "fill")) {
+        if (status || n < 1 || n > 2 || arg[0] > 255 || (n == 2 && arg[1] > 255)) {
+            status = DRAM_CONSOLE_BAD_ARGS;
+        } else if (n == 2) {
+            uint8_t rows[32] = {0};
+            rows[arg[1] >> 3] = 1 << (arg[1] & 7);
+            dram_fill_byte(rows, arg[0]);
+        } else {
+            dram_fill_byte(0, arg[0]);
+        }
+    } else if (streq(argv[0], "copy")) {
+        if (status || n != 2 || arg[0] > 255 || arg[1] > 255) {
+            status = DRAM_CONSOLE_BAD_ARGS;
+        } else {
+            dram_copyrow(arg[0], arg[1]);
+        }
+    } else if (streq(argv[0], "setrow")) {
+        if (status || n != 2 || arg[0] > 255) {
+            status = DRAM_CONSOLE_BAD_ARGS;
+        } else {
+            dram_set_row(arg[0], arg[1]);
+        }
+    } else if (streq(argv[0], "scan")) {
+        if (n) {
+            status = DRAM_CONSOLE_BAD_ARGS;
+        } else {
+            console_scan();
+        }
+    } else if (streq(argv[0], "refresh-off") || streq(argv[0], "refresh-on")) {
+        if (n) {
+            status = DRAM_CONSOLE_BAD_ARGS;
+        } else {
+            dram_refresh_enable(streq(argv[0], "refresh-on"));
+        }
+    } else if (streq(argv[0], "timing")) {
+        if (status || (n != 0 && n != 4)) {
+            status = DRAM_CONSOLE_BAD_ARGS;
+        } else if (n == 4) {
+            for (uint8_t i = 0; i < 4; i++) {
+                if (arg[i] < 1 || arg[i] > DRAM_TIMING_MAX) {
+                    status = DRAM_CONSOLE_BAD_ARGS;
+                }
+            }
+            if (!status) {
+                dram_timing.rcd = arg[0];
+                dram_timing.cas = arg[1];
+                dram_timing.cp = arg[2];
+                dram_timing.rp = arg[3];
+            }
+        }
+        result[0] = dram_timing.rcd;
+        result[1] = dram_timing.cas;
+        result[2] = dram_timing.cp;
+        result[3] = dram_timing.rp;
+        result_len = 4;
+    } else if (streq(argv[0], "dump")) {
+        if (status || n > 1 || (n == 1 && arg[0] > 255)) {
+            status = DRAM_CONSOLE_BAD_ARGS;
+        } else {
+            if (n) {
+                dram_dump_fill(0, 256, arg[0]);
+            } else {
+                dram_dump(0, 256, 0);
+            }
+        }
+    } else if (streq(argv[0], "delay")) {
+        if (status || n != 1 || arg[0] > DRAM_CONSOLE_MAX_DELAY) {
+            status = DRAM_CONSOLE_BAD_ARGS;
+        } else {
+            Delay_Ms(arg[0]);
+        }
+    } else {
+        status = DRAM_CONSOLE_UNKNOWN;
+    }
+
+    console_reply(status, result, result_len);
+}
+
+// Bytes from the debug link. The debug printf calls this from inside
+// putchar() while it waits for the host, so it must not run commands (which
+// print): the bytes are only queued for dram_console_poll().
+void dram_console_input(const uint8_t *data, int len) {
+    for (int i = 0; i < len; i++) {
+        uint8_t next = (rx_head + 1) % DRAM_CONSOLE_RX;
+        if (next == rx_tail) {
+            rx_gap |= (uint32_t)1 << rx_head;
+            continue;
+        }
+        rx_buf[rx_head] = data[i];
+        rx_head = next;
+    }
+}
+
+// Run the commands received so far; call from the main loop. Commands run as
+// soon as their ';' or end of line is here. Does nothing when called again
+// from inside a command.
+void dram_console_poll(void) {
+    if (console_running) {
+        return;
+    }
+    console_running = 1;
+    while (rx_tail != rx_head) {
+        char c = rx_buf[rx_tail];
+        if (rx_gap & ((uint32_t)1 << rx_tail)) {
+            // Input was dropped between the line so far and this byte
+            rx_gap &= ~((uint32_t)1 << rx_tail);
+            line_overflow = 1;
+        }
+        rx_tail = (rx_tail + 1) % DRAM_CONSOLE_RX;
+        if (c == '\n' || c == '\r' || c == ';') {
+            if (line_overflow) {
+                console_reply(DRAM_CONSOLE_TOO_LONG, 0, 0);
+            } else {
+                line[line_len] = 0;
+                console_execute(line);
+            }
+            line_len = 0;
+            line_overflow = 0;
+        } else if (line_len < DRAM_CONSOLE_LINE - 1) {
+            line[line_len++] = c;
+        } else {
+            line_overflow = 1;
+        }
+    }
+    console_running = 0;
+}
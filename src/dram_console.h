@@ -0,0 +1,43 @@
+#ifndef DRAM_CONSOLE_H
+#define DRAM_CONSOLE_H
+
+#include <stdint.h>
+
+// Command console over the debug link
+//
+// Commands are text, separated by ';' or newlines, numbers in decimal or with
+// a 0x prefix:
+//
+//   read ROW COL BITS          write ROW COL VALUE BITS
+//   fill BYTE [ROW]            copy SRC DST
+//   setrow ROW REPS            scan
+//   refresh-off / refresh-on   timing [RCD CAS CP RP]
+//   dump [EXPECTED_BYTE]       delay MS
+//
+// BITS is 1 to 32 data bits, a multiple of DRAM_CHIPS, and has to end within
+// the row; MS is at most DRAM_CONSOLE_MAX_DELAY. A command that lost input to
+// a full queue is answered with DRAM_CONSOLE_TOO_LONG and not run.
+//
+// Every command is answered with one binary DRAM_DUMP_REPLY frame (see
+// dram_dump.h) carrying the command number, a status byte and the result:
+// 4 bytes for read (value, low byte first), 4 bytes for timing (rcd, cas, cp,
+// rp). scan sends the first 16 columns of every row as DRAM_DUMP_DATA frames
+// before its reply, dump the frames of dram_dump(). tools/dram_client drives
+// the console from a PC; this header is shared with it.
+//
+// dram_console_input() runs in the debug link handler and only queues the
+// bytes; dram_console_poll() in the main loop parses and runs the commands.
+
+#define DRAM_CONSOLE_LINE 64
+#define DRAM_CONSOLE_RX   32    // bytes queued between two polls, at most 32
+#define DRAM_CONSOLE_MAX_DELAY 60000    // ms, Delay_Ms() counts in 32 bit cycles
+
+#define DRAM_CONSOLE_OK        0
+#define DRAM_CONSOLE_UNKNOWN   1    // no such command
+#define DRAM_CONSOLE_BAD_ARGS  2    // missing or out of range argument
+#define DRAM_CONSOLE_TOO_LONG  3    // command longer than DRAM_CONSOLE_LINE, or input dropped
+
+void dram_console_input(const uint8_t *data, int len);
+void dram_console_poll(void);
+
+#endif // DRAM_CONSOLE_H
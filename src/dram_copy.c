@@ -0,0 +1,341 @@
+#include "dram_copy.h"
+#include "dram_compute.h"
+#include "dram_flash.h"
+#include <string.h>
+
+// Word aligned, dram_copy_save() programs them into flash as they are
+uint8_t dram_copy_map[128] __attribute__((aligned(4)));
+dram_copy_hole_t dram_copy_holes[DRAM_COPY_MAX_HOLES] __attribute__((aligned(4)));
+uint8_t dram_copy_hole_count = 0;
+
+static uint8_t copy_scratch[32];    // rows dram_copy() may overwrite on the way
+
+#define COPY_NONE     0
+#define COPY_TRUE     1
+#define COPY_INVERTED 2
+
+#define LABEL_NONE     0x7F
+#define LABEL_POLARITY 0x80
+
+// Copy a pattern from src to dst and classify what arrived. The dst row starts
+// with a pattern that is neither the source data nor its inverse, so a copy
+// that did nothing cannot pass as an inverted one. The 16 column window moves
+// along the row with dst, and both polarities are tried for every cell.
+static uint8_t copy_test(uint8_t src, uint8_t dst) {
+    uint8_t col = (dst & 15) << 4;
+    uint8_t result = COPY_TRUE | COPY_INVERTED;
+
+    for (uint8_t p = 0; p < 2; p++) {
+        uint16_t data = p ? 0xCA35 : 0x35CA;
+        uint16_t value;
+        dram_write_fpm16(src, col, data);
+        dram_write_fpm16(dst, col, p ? 0xF00F : 0x0FF0);
+        dram_copyrow(src, dst);
+        value = dram_read_fpm16(dst, col);
+        if (value != data) {
+            result &= ~COPY_TRUE;
+        }
+        if (value != (uint16_t)~data) {
+            result &= ~COPY_INVERTED;
+        }
+    }
+    return result;
+}
+
+static void copy_set_entry(uint8_t row, uint8_t entry) {
+    uint8_t shift = (row & 1) << 2;
+    dram_copy_map[row >> 1] = (dram_copy_map[row >> 1] & ~(0x0F << shift)) | (entry << shift);
+}
+
+// Test dram_copyrow() for every (src, dst) pair and build the compressed map.
+// Rows that copy into each other end up in one class; a first pass merges
+// classes over every working pair, a second pass re-tests all pairs inside
+// each class and records the ones that do not behave as the class predicts.
+// Destroys the array contents. Returns the number of such pairs.
+uint16_t dram_copy_characterize(void) {
+    uint8_t label[256];
+    uint8_t next_label = 0;
+    uint16_t mismatches = 0;
+
+    for (uint16_t row = 0; row < 256; row++) {
+        label[row] = LABEL_NONE;
+    }
+
+    for (uint16_t src = 0; src < 256; src++) {
+        for (uint16_t dst = 0; dst < 256; dst++) {
+            uint8_t result, inverted;
+            if (src == dst || (result = copy_test(src, dst)) == COPY_NONE) {
+                continue;
+            }
+            inverted = (result == COPY_INVERTED) ? LABEL_POLARITY : 0;
+            if (label[src] == LABEL_NONE && label[dst] == LABEL_NONE) {
+                if (next_label == LABEL_NONE) {
+                    continue;
+                }
+                label[src] = next_label;
+                label[dst] = next_label | inverted;
+                next_label++;
+            } else if (label[src] == LABEL_NONE) {
+                label[src] = label[dst] ^ inverted;
+            } else if (label[dst] == LABEL_NONE) {
+                label[dst] = label[src] ^ inverted;
+            } else if ((label[src] & LABEL_NONE) != (label[dst] & LABEL_NONE)) {
+                // Merge the class of dst into the class of src
+                uint8_t old = label[dst] & LABEL_NONE;
+                uint8_t flip = (label[src] ^ label[dst] ^ inverted) & LABEL_POLARITY;
+                for (uint16_t row = 0; row < 256; row++) {
+                    if ((label[row] & LABEL_NONE) == old && label[row] != LABEL_NONE) {
+                        label[row] = ((label[row] & LABEL_POLARITY) ^ flip) | (label[src] & LABEL_NONE);
+                    }
+                }
+            }
+        }
+    }
+
+    // Number the classes in order of appearance, the map has room for 7
+    for (uint16_t row = 0; row < 256; row++) {
+        copy_set_entry(row, DRAM_COPY_CLASS_NONE);
+    }
+    for (uint16_t row = 0, cls = 1; row < 256 && cls < DRAM_COPY_CLASSES; row++) {
+        uint8_t l = label[row] & LABEL_NONE;
+        if (l == LABEL_NONE) {
+            continue;
+        }
+        for (uint16_t member = row; member < 256; member++) {
+            if ((label[member] & LABEL_NONE) == l) {
+                copy_set_entry(member, cls | ((label[member] & LABEL_POLARITY) ? DRAM_COPY_POLARITY : 0));
+                label[member] = LABEL_NONE;
+            }
+        }
+        cls++;
+    }
+
+    // Re-test every pair the map claims to work
+    dram_copy_hole_count = 0;
+    for (uint16_t src = 0; src < 256; src++) {
+        for (uint16_t dst = 0; dst < 256; dst++) {
+            uint8_t expected;
+            if (src == dst || dram_copy_class(src) == DRAM_COPY_CLASS_NONE || dram_copy_class(src) != dram_copy_class(dst)) {
+                continue;
+            }
+            expected = ((dram_copy_entry(src) ^ dram_copy_entry(dst)) & DRAM_COPY_POLARITY) ? COPY_INVERTED : COPY_TRUE;
+            if (copy_test(src, dst) == expected) {
+                continue;
+            }
+            mismatches++;
+            if (dram_copy_hole_count < DRAM_COPY_MAX_HOLES) {
+                dram_copy_holes[dram_copy_hole_count].src = src;
+                dram_copy_holes[dram_copy_hole_count].dst = dst;
+                dram_copy_hole_count++;
+            } else {
+                copy_set_entry(src, DRAM_COPY_CLASS_NONE);  // out of room: stop using this row
+            }
+        }
+    }
+    return mismatches;
+}
+
+static uint8_t copy_is_hole(uint8_t src, uint8_t dst) {
+    for (uint8_t i = 0; i < dram_copy_hole_count; i++) {
+        if (dram_copy_holes[i].src == src && dram_copy_holes[i].dst == dst) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Stored map: the map in the first two pages, the holes in the third and
+// the header, written last, in the fourth
+#define COPY_FLASH_HOLES  (DRAM_COPY_FLASH_ADDR + sizeof(dram_copy_map))
+#define COPY_FLASH_HEADER (COPY_FLASH_HOLES + sizeof(dram_copy_holes))
+
+typedef struct {
+    uint32_t magic;
+    uint32_t hole_count;
+    uint32_t check;         // magic ^ hole_count ^ copy_checksum() of the stored pages
+} copy_record_t;
+
+static uint32_t copy_checksum(const uint32_t *words, uint8_t count, uint32_t sum) {
+    while (count--) {
+        sum = ((sum << 5) | (sum >> 27)) ^ *words++;
+    }
+    return sum;
+}
+
+static uint32_t copy_check(uint32_t hole_count, const void *map, const void *holes) {
+    uint32_t sum = copy_checksum((const uint32_t *)map, sizeof(dram_copy_map) / 4, 0);
+    sum = copy_checksum((const uint32_t *)holes, sizeof(dram_copy_holes) / 4, sum);
+    return DRAM_COPY_MAGIC ^ hole_count ^ sum;
+}
+
+// Store the map in flash (dram_flash.h)
+void dram_copy_save(void) {
+    copy_record_t record;
+
+    record.magic = DRAM_COPY_MAGIC;
+    record.hole_count = dram_copy_hole_count;
+    record.check = copy_check(dram_copy_hole_count, dram_copy_map, dram_copy_holes);
+    dram_flash_write(DRAM_COPY_FLASH_ADDR, dram_copy_map, sizeof(dram_copy_map));
+    dram_flash_write(COPY_FLASH_HOLES, dram_copy_holes, sizeof(dram_copy_holes));
+    dram_flash_write(COPY_FLASH_HEADER, &record, sizeof(record));
+}
+
+// Returns 1 and replaces the map if one is stored
+uint8_t dram_copy_load(void) {
+    const copy_record_t *record = (const copy_record_t *)dram_flash_ptr(COPY_FLASH_HEADER);
+    const uint8_t *map = (const uint8_t *)dram_flash_ptr(DRAM_COPY_FLASH_ADDR);
+    const uint8_t *holes = (const uint8_t *)dram_flash_ptr(COPY_FLASH_HOLES);
+
+    if (record->magic != DRAM_COPY_MAGIC || record->hole_count > DRAM_COPY_MAX_HOLES ||
+        record->check != copy_check(record->hole_count, map, holes)) {
+        return 0;
+    }
+    memcpy(dram_copy_map, map, sizeof(dram_copy_map));
+    memcpy(dram_copy_holes, holes, sizeof(dram_copy_holes));
+    dram_copy_hole_count = record->hole_count;
+    return 1;
+}
+
+// Re-test the first two rows of every class against the map, to catch a
+// swapped chip. Destroys a 16 column window of those rows.
+uint8_t dram_copy_verify(void) {
+    for (uint8_t cls = 1; cls < DRAM_COPY_CLASSES; cls++) {
+        int16_t first = -1;
+        for (uint16_t row = 0; row < 256; row++) {
+            uint8_t expected;
+            if (dram_copy_class(row) != cls) {
+                continue;
+            }
+            if (first < 0) {
+                first = row;
+                continue;
+            }
+            if (copy_is_hole(first, row)) {
+                continue;
+            }
+            expected = dram_copy_inverts(first, row) ? COPY_INVERTED : COPY_TRUE;
+            if (copy_test(first, row) != expected) {
+                return 0;
+            }
+            break;
+        }
+    }
+    return 1;
+}
+
+// 1 if dram_copyrow(src, dst) leaves an exact copy of src in dst
+uint8_t dram_copy_valid(uint8_t src, uint8_t dst) {
+    if (src == dst || dram_copy_class(src) == DRAM_COPY_CLASS_NONE || dram_copy_entry(src) != dram_copy_entry(dst)) {
+        return 0;
+    }
+    return !copy_is_hole(src, dst);
+}
+
+// 1 if dram_copyrow(src, dst) leaves the inverse of src in dst
+uint8_t dram_copy_inverts(uint8_t src, uint8_t dst) {
+    if (src == dst || dram_copy_class(src) == DRAM_COPY_CLASS_NONE || dram_copy_class(src) != dram_copy_class(dst) ||
+        dram_copy_entry(src) == dram_copy_entry(dst)) {
+        return 0;
+    }
+    return !copy_is_hole(src, dst);
+}
+
+// Allow dram_copy() to use 'row' as an intermediate row
+void dram_copy_set_scratch(uint8_t row, uint8_t scratch) {
+    if (scratch) {
+        copy_scratch[row >> 3] |= 1 << (row & 7);
+    } else {
+        copy_scratch[row >> 3] &= ~(1 << (row & 7));
+    }
+}
+
+// Copy row src to row dst with as few RAS cycles as the map allows: directly,
+// through a scratch row, or over the pins. Returns DRAM_COPY_x.
+uint8_t dram_copy(uint8_t src, uint8_t dst) {
+    if (src == dst) {
+        return DRAM_COPY_SAME;
+    }
+    if (dram_copy_valid(src, dst)) {
+        dram_copyrow(src, dst);
+        return DRAM_COPY_DIRECT;
+    }
+    for (uint16_t row = 0; row < 256; row++) {
+        if ((copy_scratch[row >> 3] & (1 << (row & 7))) && row != src && row != dst &&
+            dram_copy_valid(src, row) && dram_copy_valid(row, dst)) {
+            dram_copyrow(src, row);
+            dram_copyrow(row, dst);
+            return DRAM_COPY_VIA;
+        }
+    }
+    for (uint16_t bit = 0; bit < DRAM_ROW_BITS; bit += 16) {
+        dram_write_fpm16(dst, DRAM_BIT_COL(bit), dram_read_fpm16(src, DRAM_BIT_COL(bit)));
+    }
+    return DRAM_COPY_FPM;
+}
+
+#define ROW_SELECTED(rows, row) ((!(rows) || ((rows)[(row) >> 3] & (1 << ((row) & 7)))) && !dram_compute_reserved(row))
+
+// Clone the seed row into 'count' rows and check a 16 column sample of each,
+// moving along the row like copy_test(). Rows that did not take the copy are
+// written over the pins. Returns their number.
+static uint16_t fill_group(uint8_t seed, const uint8_t *group, uint8_t count, const uint8_t pattern[DRAM_ROW_BYTES]) {
+    uint16_t rewritten = 0;
+
+    dram_copyrow_fanout(seed, group, count);
+    for (uint8_t i = 0; i < count; i++) {
+        uint8_t byte = (group[i] & 15) << 1;
+        if (dram_read_fpm16(group[i], DRAM_BIT_COL(byte << 3)) != (pattern[byte] | (pattern[byte + 1] << 8))) {
+            dram_write_row(group[i], pattern);
+            rewritten++;
+        }
+    }
+    return rewritten;
+}
+
+// Write 'pattern' into every selected row. One seed row per copy class and
+// polarity is written with an FPM burst and cloned into the other rows of its
+// group with one RAS cycle per row. Rows without a copy partner get an FPM
+// burst of their own. The control and compute rows of dram_compute.h are left
+// alone. Returns the number of rows the clone missed.
+uint16_t dram_fill(const uint8_t *rows, const uint8_t pattern[DRAM_ROW_BYTES]) {
+    uint8_t done[32] = {0};
+    uint8_t group[32];
+    uint16_t rewritten = 0;
+
+    for (uint16_t seed = 0; seed < 256; seed++) {
+        uint8_t count = 0;
+
+        if (!ROW_SELECTED(rows, seed) || (done[seed >> 3] & (1 << (seed & 7)))) {
+            continue;
+        }
+        dram_write_row(seed, pattern);
+        if (dram_copy_class(seed) == DRAM_COPY_CLASS_NONE) {
+            continue;
+        }
+
+        for (uint16_t row = seed + 1; row < 256; row++) {
+            if (!ROW_SELECTED(rows, row) || (done[row >> 3] & (1 << (row & 7))) || !dram_copy_valid(seed, row)) {
+                continue;
+            }
+            done[row >> 3] |= 1 << (row & 7);
+            group[count++] = row;
+            if (count == sizeof(group)) {
+                rewritten += fill_group(seed, group, count, pattern);
+                count = 0;
+            }
+        }
+        if (count) {
+            rewritten += fill_group(seed, group, count, pattern);
+        }
+    }
+    return rewritten;
+}
+
+uint16_t dram_fill_byte(const uint8_t *rows, uint8_t value) {
+    uint8_t pattern[DRAM_ROW_BYTES];
+
+    for (uint8_t i = 0; i < DRAM_ROW_BYTES; i++) {
+        pattern[i] = value;
+    }
+    return dram_fill(rows, pattern);
+}
@@ -0,0 +1,62 @@
+#ifndef DRAM_COPY_H
+#define DRAM_COPY_H
+
+#include "dram.h"
+
+// Row copy map and copy planner
+//
+// dram_copyrow() only works between rows that share sense amplifiers, and a
+// copy between the true and the complement bitline of a folded pair may arrive
+// inverted. A full 256x256 result bitmap would need 8 KB, so the map is kept
+// in compressed form: one nibble per row holding a copy class (rows of the same
+// class copy into each other) and the bitline polarity (a copy is inverted iff
+// the polarities differ). Pairs inside a class that failed the test anyway are
+// kept in a short list of holes.
+
+#define DRAM_COPY_CLASS_NONE 0     // row takes part in no in-array copy (also before characterization)
+#define DRAM_COPY_CLASSES    8     // classes 1..7
+#define DRAM_COPY_POLARITY   0x08
+#define DRAM_COPY_MAX_HOLES  32
+#define DRAM_COPY_MAGIC      0x4D433431  // "14CM"
+
+// How dram_copy() moved the data
+#define DRAM_COPY_SAME   0          // src == dst, nothing to do
+#define DRAM_COPY_DIRECT 1          // one dram_copyrow()
+#define DRAM_COPY_VIA    2          // two dram_copyrow() through a scratch row
+#define DRAM_COPY_FPM    3          // read and write over the pins
+
+typedef struct {
+    uint8_t src;
+    uint8_t dst;
+} dram_copy_hole_t;
+
+extern uint8_t dram_copy_map[128];  // one nibble per row, low nibble = even row
+extern dram_copy_hole_t dram_copy_holes[DRAM_COPY_MAX_HOLES];
+extern uint8_t dram_copy_hole_count;
+
+static inline uint8_t dram_copy_entry(uint8_t row) {
+    return (dram_copy_map[row >> 1] >> ((row & 1) << 2)) & 0x0F;
+}
+
+static inline uint8_t dram_copy_class(uint8_t row) {
+    return dram_copy_entry(row) & ~DRAM_COPY_POLARITY;
+}
+
+uint16_t dram_copy_characterize(void);
+
+// The map takes seconds to characterize, so it is kept in flash (dram_flash.h)
+// like the kernel timing: a boot loads it and re-tests one pair per class
+void dram_copy_save(void);
+uint8_t dram_copy_load(void);
+uint8_t dram_copy_verify(void);
+uint8_t dram_copy_valid(uint8_t src, uint8_t dst);
+uint8_t dram_copy_inverts(uint8_t src, uint8_t dst);
+void dram_copy_set_scratch(uint8_t row, uint8_t scratch);
+uint8_t dram_copy(uint8_t src, uint8_t dst);
+
+// Bulk fill: rows is a bitmap of 256 rows (bit (r&7) of rows[r>>3]), NULL for
+// all rows; the rows dram_compute_init() reserved are skipped
+uint16_t dram_fill(const uint8_t *rows, const uint8_t pattern[DRAM_ROW_BYTES]);
+uint16_t dram_fill_byte(const uint8_t *rows, uint8_t value);
+
+#endif // DRAM_COPY_H
@@ -0,0 +1,123 @@
+#include "dram.h"
+#include "dram_dump.h"
+#include <stdio.h>
+
+static void dump_putchar(uint8_t byte) {
+    putchar(byte);
+}
+
+static void (*dump_put)(uint8_t byte) = dump_putchar;
+static uint32_t dump_bytes;
+
+void dram_dump_set_output(void (*put)(uint8_t byte)) {
+    dump_put = put ? put : dump_putchar;
+}
+
+static void dump_byte(uint8_t byte, uint16_t *crc) {
+    dump_put(byte);
+    dump_bytes++;
+    if (crc) {
+        *crc = dram_dump_crc16(*crc, byte);
+    }
+}
+
+static void dump_frame_head(uint8_t type, uint8_t row, uint8_t len, uint16_t *crc) {
+    *crc = 0xFFFF;
+    dump_byte(DRAM_DUMP_SYNC0, 0);
+    dump_byte(DRAM_DUMP_SYNC1, 0);
+    dump_byte(type, crc);
+    dump_byte(row, crc);
+    dump_byte(len, crc);
+}
+
+static void dump_frame_tail(uint16_t crc) {
+    dump_byte(crc & 0xFF, 0);
+    dump_byte(crc >> 8, 0);
+}
+
+void dram_dump_frame(uint8_t type, uint8_t row, const uint8_t *payload, uint8_t len) {
+    uint16_t crc;
+
+    dump_frame_head(type, row, len, &crc);
+    for (uint8_t i = 0; i < len; i++) {
+        dump_byte(payload[i], &crc);
+    }
+    dump_frame_tail(crc);
+}
+
+// Run-length code a row as (count, value) pairs, sent straight out when crc
+// is given, so no second row buffer is needed. Gives up once the result would
+// be no shorter than the row. Returns the length or 0.
+static uint8_t dump_rle(const uint8_t in[DRAM_DUMP_ROW_BYTES], uint16_t *crc) {
+    uint8_t len = 0;
+
+    for (uint8_t i = 0; i < DRAM_DUMP_ROW_BYTES;) {
+        uint8_t run = 1;
+        while (i + run < DRAM_DUMP_ROW_BYTES && in[i + run] == in[i]) {
+            run++;
+        }
+        if (len + 2 >= DRAM_DUMP_ROW_BYTES) {
+            return 0;
+        }
+        if (crc) {
+            dump_byte(run, crc);
+            dump_byte(in[i], crc);
+        }
+        len += 2;
+        i += run;
+    }
+    return len;
+}
+
+// The expected row is expected[j & mask]: mask 0 repeats one byte
+static uint32_t dump_rows(uint8_t first_row, uint16_t rows, const uint8_t *expected, uint8_t mask) {
+    uint8_t buf[DRAM_DUMP_ROW_BYTES + 2];
+
+    dump_bytes = 0;
+    buf[0] = rows & 0xFF;
+    buf[1] = rows >> 8;
+    for (uint8_t i = 0; expected && i < DRAM_DUMP_ROW_BYTES; i++) {
+        buf[2 + i] = expected[i & mask];
+    }
+    dram_dump_frame(DRAM_DUMP_HEADER, first_row, buf, expected ? DRAM_DUMP_ROW_BYTES + 2 : 2);
+
+    for (uint16_t i = 0; i < rows; i++) {
+        uint8_t row = first_row + i;
+        uint8_t type = expected ? DRAM_DUMP_XOR : 0;
+        uint8_t len;
+
+        // 16 column bursts, the RAS cycles dram_read_row() uses as well
+        for (uint8_t j = 0; j < DRAM_DUMP_ROW_BYTES; j += DRAM_BURST_BYTES) {
+            dram_read_burst(row, DRAM_BIT_COL(j << 3), &buf[j], DRAM_BURST_BYTES);
+        }
+        for (uint8_t j = 0; expected && j < DRAM_DUMP_ROW_BYTES; j++) {
+            buf[j] ^= expected[j & mask];
+        }
+        len = dump_rle(buf, 0);
+        if (len) {
+            uint16_t crc;
+            dump_frame_head(type | DRAM_DUMP_RLE, row, len, &crc);
+            dump_rle(buf, &crc);
+            dump_frame_tail(crc);
+        } else {
+            dram_dump_frame(type | DRAM_DUMP_RAW, row, buf, DRAM_DUMP_ROW_BYTES);
+        }
+    }
+
+    buf[0] = rows & 0xFF;
+    buf[1] = rows >> 8;
+    dram_dump_frame(DRAM_DUMP_END, first_row, buf, 2);
+    return dump_bytes;
+}
+
+// Send rows first_row .. first_row + rows - 1 (wrapping at 256). With
+// 'expected' (one row of DRAM_DUMP_ROW_BYTES) every row is sent as its XOR
+// with it. Returns the number of bytes sent.
+uint32_t dram_dump(uint8_t first_row, uint16_t rows, const uint8_t *expected) {
+    return dump_rows(first_row, rows, expected, DRAM_DUMP_ROW_BYTES - 1);
+}
+
+// Same, XORed with a row of 'expected' bytes, without a row buffer to fill
+uint32_t dram_dump_fill(uint8_t first_row, uint16_t rows, uint8_t expected) {
+    return dump_rows(first_row, rows, &expected, 0);
+}
@@ -0,0 +1,53 @@
+#ifndef DRAM_DUMP_H
+#define DRAM_DUMP_H
+
+#include <stdint.h>
+
+// Binary array dump
+//
+// A dump is a header frame, one frame per row and an end frame:
+//
+//   'D' 'R' type row len payload[len] crc16
+//
+// with the CRC-16/CCITT (0x1021, init 0xFFFF) over type, row, len and the
+// payload, low byte first. Row payloads are the DRAM_DUMP_ROW_BYTES row bytes
+// (data bit k is bit k&7 of byte k>>3), either raw or run-length coded as
+// (count, value) pairs, and optionally XORed with the expected row sent in the
+// header, so a mostly-uniform or mostly-intact array costs a few bytes per
+// row. The sync bytes and the CRC let a decoder find the frames in a stream
+// mixed with printf text. This header is shared with the host decoder in tools/.
+
+#define DRAM_DUMP_SYNC0 'D'
+#define DRAM_DUMP_SYNC1 'R'
+
+#define DRAM_DUMP_HEADER  0x01  // row = first row, payload = row count (2 bytes) + expected row or nothing
+#define DRAM_DUMP_RAW     0x10  // payload = row bytes
+#define DRAM_DUMP_RLE     0x11  // payload = (count, value) pairs
+#define DRAM_DUMP_XOR     0x02  // flag: payload is the row XOR the expected row
+#define DRAM_DUMP_END     0x7F  // payload = rows sent (2 bytes)
+#define DRAM_DUMP_REPLY   0x20  // console reply: row = command number, payload = status + result
+#define DRAM_DUMP_DATA    0x21  // console bulk data: row = chunk number
+
+// Builds for several chips (see dram.h) have wider rows; the host tools take
+// the same -DDRAM_CHIPS
+#ifndef DRAM_CHIPS
+#define DRAM_CHIPS 1
+#endif
+#define DRAM_DUMP_ROW_BYTES (32 * DRAM_CHIPS)
+#define DRAM_DUMP_OVERHEAD  7   // sync, type, row, len, crc
+
+static inline uint16_t dram_dump_crc16(uint16_t crc, uint8_t byte) {
+    crc ^= (uint16_t)byte << 8;
+    for (uint8_t i = 0; i < 8; i++) {
+        crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+    }
+    return crc;
+}
+
+// Firmware side: frames go to the output function, putchar() by default
+void dram_dump_set_output(void (*put)(uint8_t byte));
+void dram_dump_frame(uint8_t type, uint8_t row, const uint8_t *payload, uint8_t len);
+uint32_t dram_dump(uint8_t first_row, uint16_t rows, const uint8_t *expected);
+uint32_t dram_dump_fill(uint8_t first_row, uint16_t rows, uint8_t expected);
+
+#endif // DRAM_DUMP_H
@@ -0,0 +1,179 @@
+#include "dram_ecc.h"
+#include "dram_refresh.h"
+#include <string.h>
+
+// Data bits covered by Hamming bit k: data bit i sits at codeword position
+// p(i), the i-th position that is not a power of two, and is covered by
+// Hamming bit k when bit k of p(i) is set
+static const uint64_t ecc_masks[7] = {
+    0xAB55555556AAAD5BULL, 0xCD9999999B33366DULL, 0xF1E1E1E1E3C3C78EULL, 0x01FE01FE03FC07F0ULL,
+    0x01FFFE0003FFF800ULL, 0x01FFFFFFFC000000ULL, 0xFE00000000000000ULL,
+};
+
+static uint8_t ecc_first_row;
+static uint16_t ecc_rows;
+static uint16_t ecc_cursor;     // scrub range index of the next row to scrub
+static uint16_t ecc_waits;      // other rows offered while waiting for it
+static dram_ecc_stats_t ecc_stats;
+
+static uint8_t ecc_parity(uint64_t x) {
+    return __builtin_parityll(x);
+}
+
+uint8_t dram_ecc_encode(uint64_t data) {
+    uint8_t check = 0;
+
+    for (uint8_t k = 0; k < 7; k++) {
+        check |= ecc_parity(data & ecc_masks[k]) << k;
+    }
+    return check | (uint8_t)((ecc_parity(data) ^ ecc_parity(check)) << 7);
+}
+
+uint8_t dram_ecc_decode(uint64_t *data, uint8_t check) {
+    uint8_t syndrome = (dram_ecc_encode(*data) ^ check) & 0x7F;
+    uint8_t parity = ecc_parity(*data) ^ ecc_parity(check);    // 1: odd number of flips
+
+    ecc_stats.words++;
+    if (!syndrome && !parity) {
+        return DRAM_ECC_OK;
+    }
+    if (!parity || syndrome > 71) {
+        ecc_stats.uncorrectable++;
+        return DRAM_ECC_UNCORRECTABLE;
+    }
+    // A syndrome that is a power of two (or 0: bit 7) points at a check bit.
+    // Otherwise data bit i is at position s, with floor(log2 s) + 1 check
+    // positions below it.
+    if (syndrome & (syndrome - 1)) {
+        *data ^= 1ULL << (syndrome - (31 - __builtin_clz(syndrome)) - 2);
+    }
+    ecc_stats.corrected++;
+    return DRAM_ECC_CORRECTED;
+}
+
+static uint64_t ecc_load(const uint8_t *bytes) {
+    uint64_t word = 0;
+
+    for (uint8_t i = 0; i < 8; i++) {
+        word |= (uint64_t)bytes[i] << (8 * i);
+    }
+    return word;
+}
+
+static void ecc_store(uint8_t *bytes, uint64_t word) {
+    for (uint8_t i = 0; i < 8; i++) {
+        bytes[i] = (uint8_t)(word >> (8 * i));
+    }
+}
+
+// The data and the check bytes are two bursts of the row, so a row is read
+// and written straight from the caller's data and a DRAM_ECC_WORDS buffer
+void dram_ecc_write_row(uint8_t row, const uint8_t data[DRAM_ECC_ROW_BYTES]) {
+    uint8_t check[DRAM_ECC_WORDS];
+
+    for (uint8_t w = 0; w < DRAM_ECC_WORDS; w++) {
+        check[w] = dram_ecc_encode(ecc_load(&data[8 * w]));
+    }
+    dram_refresh_poll();
+    dram_busy++;
+    dram_write_burst(row, 0, data, DRAM_ECC_ROW_BYTES);
+    dram_write_burst(row, DRAM_BIT_COL(DRAM_ECC_CHECK_BIT), check, DRAM_ECC_WORDS);
+    dram_busy--;
+}
+
+uint8_t dram_ecc_read_row(uint8_t row, uint8_t data[DRAM_ECC_ROW_BYTES]) {
+    uint8_t check[DRAM_ECC_WORDS];
+    uint8_t status = DRAM_ECC_OK;
+
+    dram_refresh_poll();
+    dram_busy++;
+    dram_read_burst(row, 0, data, DRAM_ECC_ROW_BYTES);
+    dram_read_burst(row, DRAM_BIT_COL(DRAM_ECC_CHECK_BIT), check, DRAM_ECC_WORDS);
+    dram_busy--;
+    for (uint8_t w = 0; w < DRAM_ECC_WORDS; w++) {
+        uint64_t word = ecc_load(&data[8 * w]);
+        uint8_t s = dram_ecc_decode(&word, check[w]);
+        if (s == DRAM_ECC_CORRECTED) {
+            ecc_store(&data[8 * w], word);
+        }
+        status |= s;
+    }
+    return (status & DRAM_ECC_UNCORRECTABLE) ? DRAM_ECC_UNCORRECTABLE : status;
+}
+
+// The word and its check byte take three primitives. The refresh engine is
+// held off in between, or the scrubber could decode the row with only part
+// of them written and "correct" the word back to stale data.
+void dram_ecc_write64(uint8_t row, uint8_t word, uint64_t value) {
+    dram_refresh_poll();
+    dram_busy++;
+    dram_write_fpm32(row, DRAM_BIT_COL(64 * word), (uint32_t)value);
+    dram_write_fpm32(row, DRAM_BIT_COL(64 * word + 32), (uint32_t)(value >> 32));
+    dram_write_fpm8(row, DRAM_BIT_COL(DRAM_ECC_CHECK_BIT + 8 * word), dram_ecc_encode(value));
+    dram_busy--;
+}
+
+uint8_t dram_ecc_read64(uint8_t row, uint8_t word, uint64_t *value) {
+    uint8_t check;
+
+    dram_refresh_poll();
+    dram_busy++;
+    *value = dram_read_fpm32(row, DRAM_BIT_COL(64 * word)) |
+             (uint64_t)dram_read_fpm32(row, DRAM_BIT_COL(64 * word + 32)) << 32;
+    check = dram_read_fpm8(row, DRAM_BIT_COL(DRAM_ECC_CHECK_BIT + 8 * word));
+    dram_busy--;
+    return dram_ecc_decode(value, check);
+}
+
+// Check a row of the scrub range and write it back if a word was corrected.
+// Returns 0 for the other rows. Rows that were refreshed together come due
+// together, and only one of them can be scrubbed per poll, so the rows are
+// taken strictly in turn. A row that normal accesses keep fresh never comes
+// due; it is passed over once every other row had two chances.
+uint8_t dram_ecc_scrub_row(uint8_t row) {
+    uint8_t check[DRAM_ECC_WORDS];
+    uint8_t rewritten = 0;
+    uint16_t index = (uint8_t)(row - ecc_first_row);
+
+    if (index >= ecc_rows) {
+        return 0;
+    }
+    if (index != ecc_cursor && ++ecc_waits < 2 * ecc_rows) {
+        return 0;
+    }
+    ecc_waits = 0;
+    ecc_cursor = (index + 1 < ecc_rows) ? index + 1 : 0;
+    // Word by word, so the refresh interrupt holds no row sized buffer
+    dram_read_burst(row, DRAM_BIT_COL(DRAM_ECC_CHECK_BIT), check, DRAM_ECC_WORDS);
+    for (uint8_t w = 0; w < DRAM_ECC_WORDS; w++) {
+        uint8_t bytes[8];
+        uint64_t word;
+        dram_read_burst(row, DRAM_BIT_COL(64 * w), bytes, 8);
+        word = ecc_load(bytes);
+        if (dram_ecc_decode(&word, check[w]) == DRAM_ECC_CORRECTED) {
+            ecc_store(bytes, word);
+            dram_write_burst(row, DRAM_BIT_COL(64 * w), bytes, 8);
+            dram_write_fpm8(row, DRAM_BIT_COL(DRAM_ECC_CHECK_BIT + 8 * w), dram_ecc_encode(word));
+            rewritten = 1;
+        }
+    }
+    ecc_stats.scrubbed++;
+    ecc_stats.rewritten += rewritten;
+    return 1;
+}
+
+void dram_ecc_set_scrub(uint8_t first_row, uint16_t rows) {
+    ecc_first_row = first_row;
+    ecc_rows = (first_row + rows > 256) ? 256 - first_row : rows;
+    ecc_cursor = 0;
+    ecc_waits = 0;
+    dram_refresh_set_scrub(ecc_rows ? dram_ecc_scrub_row : NULL);
+}
+
+void dram_get_ecc_stats(dram_ecc_stats_t *stats) {
+    *stats = ecc_stats;
+}
+
+void dram_reset_ecc_stats(void) {
+    memset(&ecc_stats, 0, sizeof(ecc_stats));
+}
@@ -0,0 +1,56 @@
+#ifndef DRAM_ECC_H
+#define DRAM_ECC_H
+
+#include "dram.h"
+
+// SECDED ECC
+//
+// A protected row holds DRAM_ECC_WORDS 64-bit words in its first
+// DRAM_ECC_ROW_BYTES bytes, followed by one check byte per word: seven
+// Hamming bits (positions 1, 2, 4 .. 64 of a (71,64) code) and the parity of
+// the whole 72-bit codeword in bit 7. A single flipped bit per word is
+// corrected, two are detected. The remaining bytes of the row are not used.
+//
+// Reads through dram_ecc_* correct and count errors but leave the array
+// alone; the scrubber rewrites rows with corrected errors. Once enabled it
+// takes over the refresh of one due row of its range per refresh poll, so it
+// costs a row read (plus a word write per corrected word) in place of a
+// RAS-only cycle and needs no activations of its own. It reads the row word by
+// word and keeps only the check bytes, DRAM_ECC_WORDS bytes, on the stack.
+
+#define DRAM_ECC_WORDS      (DRAM_ROW_BYTES / 9)        // 3 with one chip, 14 with four
+#define DRAM_ECC_ROW_BYTES  (DRAM_ECC_WORDS * 8)        // data bytes per row
+#define DRAM_ECC_CHECK_BIT  (DRAM_ECC_ROW_BYTES * 8)    // data bit of the first check byte
+
+#define DRAM_ECC_OK             0
+#define DRAM_ECC_CORRECTED      1
+#define DRAM_ECC_UNCORRECTABLE  2
+
+typedef struct {
+    uint32_t words;         // words decoded
+    uint32_t corrected;     // words with a single bit error
+    uint32_t uncorrectable; // words with a double error
+    uint32_t scrubbed;      // rows checked by the scrubber
+    uint32_t rewritten;     // rows the scrubber wrote back corrected
+} dram_ecc_stats_t;
+
+uint8_t dram_ecc_encode(uint64_t data);
+uint8_t dram_ecc_decode(uint64_t *data, uint8_t check);    // corrects *data, returns DRAM_ECC_x
+
+// Whole rows, a data burst and a check burst each way; the read returns the
+// worst word status
+void dram_ecc_write_row(uint8_t row, const uint8_t data[DRAM_ECC_ROW_BYTES]);
+uint8_t dram_ecc_read_row(uint8_t row, uint8_t data[DRAM_ECC_ROW_BYTES]);
+
+// Single words (the FPM word primitives)
+void dram_ecc_write64(uint8_t row, uint8_t word, uint64_t value);
+uint8_t dram_ecc_read64(uint8_t row, uint8_t word, uint64_t *value);
+
+// Scrub rows first_row .. first_row + rows - 1 during refresh, rows = 0 stops
+void dram_ecc_set_scrub(uint8_t first_row, uint16_t rows);
+uint8_t dram_ecc_scrub_row(uint8_t row);
+
+void dram_get_ecc_stats(dram_ecc_stats_t *stats);
+void dram_reset_ecc_stats(void);
+
+#endif // DRAM_ECC_H
@@ -0,0 +1,68 @@
+#include "ch32fun.h"
+#include "dram_flash.h"
+
+#define FLASH_RESERVED_BYTES (0x08004000 - DRAM_FLASH_RESERVED_ADDR)
+
+#ifdef DRAM_SIM
+static uint32_t sim_flash_pages[FLASH_RESERVED_BYTES / 4];
+static uint8_t sim_flash_erased = 0;
+
+const void *dram_flash_ptr(uint32_t addr) {
+    if (!sim_flash_erased) {
+        for (uint16_t i = 0; i < FLASH_RESERVED_BYTES / 4; i++) {
+            sim_flash_pages[i] = 0xFFFFFFFF;
+        }
+        sim_flash_erased = 1;
+    }
+    return (const uint8_t *)sim_flash_pages + (addr - DRAM_FLASH_RESERVED_ADDR);
+}
+
+void dram_flash_write(uint32_t addr, const void *data, uint16_t bytes) {
+    uint32_t *dst = (uint32_t *)dram_flash_ptr(addr);
+    const uint32_t *src = (const uint32_t *)data;
+    uint16_t words = (bytes + DRAM_FLASH_PAGE - 1) / DRAM_FLASH_PAGE * DRAM_FLASH_PAGE / 4;
+
+    for (uint16_t i = 0; i < words; i++) {
+        dst[i] = (i < bytes / 4) ? src[i] : 0xFFFFFFFF;
+    }
+}
+#else
+const void *dram_flash_ptr(uint32_t addr) {
+    return (const void *)addr;
+}
+
+void dram_flash_write(uint32_t addr, const void *data, uint16_t bytes) {
+    const uint32_t *src = (const uint32_t *)data;
+
+    // Unlock the flash and the fast (64 byte page) programming mode
+    FLASH->KEYR = FLASH_KEY1;
+    FLASH->KEYR = FLASH_KEY2;
+    FLASH->MODEKEYR = FLASH_KEY1;
+    FLASH->MODEKEYR = FLASH_KEY2;
+
+    for (uint16_t offset = 0; offset < bytes; offset += DRAM_FLASH_PAGE) {
+        volatile uint32_t *dst = (volatile uint32_t *)(addr + offset);
+
+        // Erase the page
+        FLASH->CTLR = CR_PAGE_ER;
+        FLASH->ADDR = addr + offset;
+        FLASH->CTLR = CR_STRT_Set | CR_PAGE_ER;
+        while (FLASH->STATR & FLASH_STATR_BSY);
+
+        // Load the data into the page buffer and program it
+        FLASH->CTLR = CR_PAGE_PG;
+        FLASH->CTLR = CR_BUF_RST | CR_PAGE_PG;
+        FLASH->ADDR = addr + offset;
+        while (FLASH->STATR & FLASH_STATR_BSY);
+        for (uint8_t i = 0; i < DRAM_FLASH_PAGE / 4 && offset + 4 * i < bytes; i++) {
+            dst[i] = *src++;
+            FLASH->CTLR = CR_PAGE_PG | CR_BUF_LOAD;
+            while (FLASH->STATR & FLASH_STATR_BSY);
+        }
+        FLASH->CTLR = CR_PAGE_PG | CR_STRT_Set;
+        while (FLASH->STATR & FLASH_STATR_BSY);
+    }
+
+    FLASH->CTLR = CR_LOCK_Set;
+}
+#endif
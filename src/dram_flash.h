@@ -0,0 +1,27 @@
+#ifndef DRAM_FLASH_H
+#define DRAM_FLASH_H
+
+#include <stdint.h>
+
+// Records in the last flash pages
+//
+// The CH32V003 erases and programs its flash in 64 byte pages. Calibration
+// results are kept at the end of the 16 KB so that later boots only have to
+// verify them: the row copy map (dram_copy.c) in four pages and the kernel
+// timing (dram_timing.c) in the last one. make (size_check) fails if the
+// firmware image reaches DRAM_FLASH_RESERVED_ADDR. The simulator has no flash;
+// there the pages are RAM and last for one run.
+
+#define DRAM_FLASH_PAGE          64
+#define DRAM_FLASH_RESERVED_ADDR 0x08003EC0
+#define DRAM_COPY_FLASH_ADDR     0x08003EC0     // 4 pages
+#define DRAM_TIMING_FLASH_ADDR   0x08003FC0     // last page
+
+// Address to read a record at 'addr' from
+const void *dram_flash_ptr(uint32_t addr);
+
+// Erase the pages from 'addr' (page aligned) on and program 'bytes' (a
+// multiple of 4) from 'data'. The rest of the last page reads as 0xFF.
+void dram_flash_write(uint32_t addr, const void *data, uint16_t bytes);
+
+#endif // DRAM_FLASH_H
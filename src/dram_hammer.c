@@ -0,0 +1,142 @@
+#include "dram_hammer.h"
+#include "dram_refresh.h"
+#include <string.h>
+
+static uint8_t hammer_is_aggressor(const dram_hammer_config_t *cfg, uint8_t row) {
+    return row == cfg->aggressor[0] || (cfg->aggressors > 1 && row == cfg->aggressor[1]);
+}
+
+// Bitmap of the victims for dram_refresh_hold(); the aggressors keep their refresh
+static void hammer_victims(const dram_hammer_config_t *cfg, uint8_t rows[32]) {
+    memset(rows, 0, 32);
+    for (uint16_t v = 0; v < cfg->victims; v++) {
+        uint8_t row = cfg->first_victim + v;
+        if (!hammer_is_aggressor(cfg, row)) {
+            rows[row >> 3] |= 1 << (row & 7);
+        }
+    }
+}
+
+// Cycles the victims may go without refresh: the deadline of the weakest
+// victim's retention bin, half the time the profiler saw it hold its data
+static uint32_t hammer_hold_limit(const dram_hammer_config_t *cfg) {
+    uint8_t bin = DRAM_RETENTION_BINS;
+
+    for (uint16_t v = 0; v < cfg->victims; v++) {
+        uint8_t row = cfg->first_victim + v;
+        if (!hammer_is_aggressor(cfg, row) && dram_retention_bin(row) < bin) {
+            bin = dram_retention_bin(row);
+        }
+    }
+    return (FUNCONF_SYSTEM_CORE_CLOCK / 1000) * (DRAM_RETENTION_TEST_MS(bin) / 2);
+}
+
+static void hammer_fill(const dram_hammer_config_t *cfg) {
+    for (uint16_t v = 0; v < cfg->victims; v++) {
+        uint8_t row = cfg->first_victim + v;
+        if (!hammer_is_aggressor(cfg, row)) {
+            dram_write_page(row, cfg->pattern * 0x01010101UL);
+        }
+    }
+    for (uint8_t i = 0; i < cfg->aggressors; i++) {
+        dram_write_page(cfg->aggressor[i], (uint8_t)~cfg->pattern * 0x01010101UL);
+    }
+}
+
+static uint16_t hammer_scan(const dram_hammer_config_t *cfg, dram_hammer_result_t *result) {
+    uint8_t buf[DRAM_BURST_BYTES];
+
+    result->flips = 0;
+    result->logged = 0;
+    for (uint16_t v = 0; v < cfg->victims; v++) {
+        uint8_t row = cfg->first_victim + v;
+        if (hammer_is_aggressor(cfg, row)) {
+            continue;
+        }
+        for (uint16_t i = 0; i < DRAM_ROW_BYTES; i++) {
+            uint8_t diff;
+            if (i % DRAM_BURST_BYTES == 0) {
+                dram_read_burst(row, DRAM_BIT_COL(8 * i), buf, DRAM_BURST_BYTES);
+            }
+            diff = buf[i % DRAM_BURST_BYTES] ^ cfg->pattern;
+            while (diff) {
+                uint8_t bit = __builtin_ctz(diff);
+                if (result->logged < DRAM_HAMMER_MAX_FLIPS) {
+                    result->flip[result->logged].row = row;
+                    result->flip[result->logged].bit = i * 8 + bit;
+                    result->logged++;
+                }
+                result->flips++;
+                diff &= diff - 1;
+            }
+        }
+    }
+    return result->flips;
+}
+
+uint16_t dram_hammer_trial(const dram_hammer_config_t *cfg, uint32_t activations, dram_hammer_result_t *result) {
+    uint8_t a = cfg->aggressor[0];
+    uint8_t b = (cfg->aggressors > 1) ? cfg->aggressor[1] : a;
+    uint32_t pairs = (cfg->aggressors > 1) ? activations : (activations + 1) / 2;
+    uint32_t limit = hammer_hold_limit(cfg), done = 0, start;
+    uint8_t held[32];
+
+    hammer_victims(cfg, held);
+    hammer_fill(cfg);
+    dram_refresh_hold(held);
+    start = SysTick->CNT;
+    while (done < pairs) {
+        uint32_t n = (pairs - done < DRAM_HAMMER_CHUNK) ? pairs - done : DRAM_HAMMER_CHUNK;
+        // Stop before the next chunk could take the victims past their deadline
+        if (done && (SysTick->CNT - start) / done * (done + n) > limit) {
+            break;
+        }
+        dram_hammer_rows(a, b, n);  // refresh of the other rows runs in between
+        done += n;
+    }
+    result->cycles = SysTick->CNT - start;
+    result->activations = (cfg->aggressors > 1) ? done : 2 * done;
+    hammer_scan(cfg, result);
+    dram_refresh_hold(NULL);
+    return result->flips;
+}
+
+uint16_t dram_hammer(const dram_hammer_config_t *cfg, dram_hammer_result_t *result) {
+    uint32_t activations = DRAM_HAMMER_MIN_ACTIVATIONS;
+
+    result->first_flip = 0;
+    for (;;) {
+        if (activations > cfg->max_activations) {
+            activations = cfg->max_activations;
+        }
+        if (dram_hammer_trial(cfg, activations, result)) {
+            result->first_flip = result->activations;
+            break;
+        }
+        // Done at the maximum, or when the retention limit cut the trial short
+        if (result->activations < activations || activations == cfg->max_activations) {
+            break;
+        }
+        activations *= 2;
+    }
+    return result->flips;
+}
+
+uint16_t dram_hammer_control(const dram_hammer_config_t *cfg, uint32_t cycles, dram_hammer_result_t *result) {
+    uint8_t held[32];
+    uint32_t start;
+
+    hammer_victims(cfg, held);
+    hammer_fill(cfg);
+    dram_refresh_hold(held);
+    start = SysTick->CNT;
+    while (SysTick->CNT - start < cycles) {
+        dram_refresh_poll();
+    }
+    result->cycles = SysTick->CNT - start;
+    result->activations = 0;
+    result->first_flip = 0;
+    hammer_scan(cfg, result);
+    dram_refresh_hold(NULL);
+    return result->flips;
+}
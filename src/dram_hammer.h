@@ -0,0 +1,55 @@
+#ifndef DRAM_HAMMER_H
+#define DRAM_HAMMER_H
+
+#include "dram.h"
+
+// Row disturbance (hammer) characterization
+//
+// A trial fills the victim rows with a pattern and the aggressor rows with its
+// complement, stops refreshing the victims (dram_refresh_hold(), aggressors in
+// the victim range stay refreshed), activates the aggressors at full rate with
+// dram_hammer_rows() and scans the victims for bits that changed. dram_hammer()
+// repeats the trial with the count doubling from DRAM_HAMMER_MIN_ACTIVATIONS
+// until bits flip or the maximum is reached.
+//
+// Victims also lose bits by leaking. A trial therefore ends early, with fewer
+// activations, before the victims pass the refresh deadline of the weakest
+// one's retention bin (dram_refresh.h; run dram_profile_retention() first, or
+// every row gets the 4 ms of bin 0), and dram_hammer() stops doubling there.
+// dram_hammer_control() holds the victims for the same time without any
+// activations: flips that only show up with hammering mark rows physically
+// adjacent to the aggressors.
+
+#define DRAM_HAMMER_MIN_ACTIVATIONS 1024
+#define DRAM_HAMMER_CHUNK      512  // pairs per dram_hammer_rows() call, ~0.5 ms at datasheet timing
+#define DRAM_HAMMER_MAX_FLIPS  16   // coordinates kept per trial
+
+typedef struct {
+    uint8_t aggressor[2];
+    uint8_t aggressors;         // 1: single-sided, 2: double-sided
+    uint8_t first_victim;
+    uint16_t victims;           // rows scanned; aggressors among them are skipped
+    uint8_t pattern;            // victim fill byte, the aggressors get its complement
+    uint32_t max_activations;   // per aggressor
+} dram_hammer_config_t;
+
+typedef struct {
+    uint8_t row;
+    uint16_t bit;               // data bit within the row
+} dram_hammer_flip_t;
+
+typedef struct {
+    uint32_t activations;       // per aggressor in the reported trial, as far as it ran
+    uint32_t first_flip;        // activations of the first trial with flips, 0: none
+    uint32_t cycles;            // time the victims went without refresh
+    uint16_t flips;             // bits changed in the trial
+    uint8_t logged;             // entries of flip[] used
+    dram_hammer_flip_t flip[DRAM_HAMMER_MAX_FLIPS];
+} dram_hammer_result_t;
+
+// All return the number of flipped bits and destroy the victim rows' contents
+uint16_t dram_hammer_trial(const dram_hammer_config_t *cfg, uint32_t activations, dram_hammer_result_t *result);
+uint16_t dram_hammer(const dram_hammer_config_t *cfg, dram_hammer_result_t *result);
+uint16_t dram_hammer_control(const dram_hammer_config_t *cfg, uint32_t cycles, dram_hammer_result_t *result);
+
+#endif // DRAM_HAMMER_H
@@ -0,0 +1,222 @@
+#include "dram_mem.h"
+#include "dram_compute.h"
+#include <string.h>
+
+static dram_mem_line_t *lines;
+static uint8_t line_count = 0;
+static uint32_t mem_tick;
+static uint8_t mem_first_row = 0;
+static uint16_t mem_rows = 0;
+static dram_mem_stats_t mem_stats;
+
+static void mem_writeback(dram_mem_line_t *line) {
+    if (line->valid && line->dirty) {
+        dram_write_row(line->row, line->data);
+        line->dirty = 0;
+        mem_stats.writebacks++;
+    }
+}
+
+// The cache line holding 'row', filled unless the caller overwrites all of it
+static dram_mem_line_t *mem_line(uint8_t row, uint8_t whole) {
+    dram_mem_line_t *victim = &lines[0];
+
+    for (uint8_t i = 0; i < line_count; i++) {
+        dram_mem_line_t *line = &lines[i];
+        if (line->valid && line->row == row) {
+            line->used = ++mem_tick;
+            mem_stats.hits++;
+            return line;
+        }
+        // An empty line, otherwise the least recently used one
+        if (victim->valid && (!line->valid || line->used < victim->used)) {
+            victim = line;
+        }
+    }
+
+    mem_writeback(victim);
+    if (whole) {
+        mem_stats.skipped++;
+    } else {
+        dram_read_row(row, victim->data);
+        mem_stats.misses++;
+    }
+    victim->valid = 1;
+    victim->dirty = 0;
+    victim->row = row;
+    victim->used = ++mem_tick;
+    return victim;
+}
+
+void dram_mem_init(uint8_t first_row, uint16_t rows, dram_mem_line_t *cache, uint8_t n_lines) {
+    dram_mem_flush();
+    lines = cache;
+    line_count = n_lines;
+    dram_mem_invalidate();
+    mem_first_row = first_row;
+    mem_rows = (first_row + rows > 256) ? 256 - first_row : rows;
+    // End before the first row the compute units use (dram_compute.h)
+    for (uint16_t i = 0; i < mem_rows; i++) {
+        if (dram_compute_reserved(first_row + i)) {
+            mem_rows = i;
+        }
+    }
+}
+
+uint32_t dram_mem_size(void) {
+    return (uint32_t)mem_rows * DRAM_ROW_BYTES;
+}
+
+// Bytes of [addr, addr + len) inside the memory
+static uint32_t mem_clamp(uint32_t addr, uint32_t len) {
+    uint32_t size = dram_mem_size();
+
+    if (addr >= size) {
+        return 0;
+    }
+    return len < size - addr ? len : size - addr;
+}
+
+// Copy into the memory. The 'fresh' bytes from addr (at least len) hold
+// nothing worth keeping, so rows that lie entirely inside them are not read
+// before they are written.
+static void mem_copy_to(uint32_t addr, const uint8_t *src, uint32_t len, uint32_t fresh) {
+    for (uint32_t done = 0; done < len;) {
+        uint8_t offset = addr % DRAM_ROW_BYTES;
+        uint32_t n = DRAM_ROW_BYTES - offset;
+        if (n > len - done) {
+            n = len - done;
+        }
+        uint8_t whole = offset == 0 && done + DRAM_ROW_BYTES <= fresh;
+        dram_mem_line_t *line = mem_line(mem_first_row + addr / DRAM_ROW_BYTES, whole);
+        memcpy(line->data + offset, src + done, n);
+        line->dirty = 1;
+        addr += n;
+        done += n;
+    }
+}
+
+uint32_t dram_memcpy_to(uint32_t addr, const void *buf, uint32_t len) {
+    len = mem_clamp(addr, len);
+    mem_copy_to(addr, (const uint8_t *)buf, len, len);
+    return len;
+}
+
+uint32_t dram_memcpy_from(uint32_t addr, void *buf, uint32_t len) {
+    uint8_t *dst = (uint8_t *)buf;
+
+    len = mem_clamp(addr, len);
+    for (uint32_t done = 0; done < len;) {
+        uint8_t offset = addr % DRAM_ROW_BYTES;
+        uint32_t n = DRAM_ROW_BYTES - offset;
+        if (n > len - done) {
+            n = len - done;
+        }
+        dram_mem_line_t *line = mem_line(mem_first_row + addr / DRAM_ROW_BYTES, 0);
+        memcpy(dst + done, line->data + offset, n);
+        addr += n;
+        done += n;
+    }
+    return len;
+}
+
+void dram_mem_flush(void) {
+    for (uint8_t i = 0; i < line_count; i++) {
+        mem_writeback(&lines[i]);
+    }
+}
+
+void dram_mem_invalidate(void) {
+    for (uint8_t i = 0; i < line_count; i++) {
+        lines[i].valid = 0;
+        lines[i].dirty = 0;
+    }
+}
+
+void dram_get_mem_stats(dram_mem_stats_t *stats) {
+    *stats = mem_stats;
+}
+
+void dram_reset_mem_stats(void) {
+    memset(&mem_stats, 0, sizeof(mem_stats));
+}
+
+// Ring buffers. The oldest byte is at offset (head - count) mod size; copies
+// that cross the end of the buffer are split in two.
+
+void dram_ring_init(dram_ring_t *ring, uint32_t base, uint32_t size, uint8_t overwrite) {
+    ring->base = base;
+    ring->size = size;
+    ring->head = 0;
+    ring->count = 0;
+    ring->overwrite = overwrite;
+}
+
+uint32_t dram_ring_write(dram_ring_t *ring, const void *buf, uint32_t len) {
+    const uint8_t *src = (const uint8_t *)buf;
+    uint32_t free, first;
+
+    if (ring->overwrite) {
+        if (len > ring->size) {
+            src += len - ring->size;    // only the newest bytes fit
+            len = ring->size;
+        }
+        // Make room up to the end of the last row written, so that row needs
+        // no fill: a log drops its oldest bytes a row at a time
+        uint32_t end = ring->head + len;
+        uint32_t need = end + (DRAM_ROW_BYTES - (ring->base + (end > ring->size ? end - ring->size : end)) % DRAM_ROW_BYTES) % DRAM_ROW_BYTES - ring->head;
+        if (need > ring->size) {
+            need = ring->size;
+        }
+        if (ring->count > ring->size - need) {
+            ring->count = ring->size - need;
+        }
+    } else if (len > ring->size - ring->count) {
+        len = ring->size - ring->count;
+    }
+    if (len == 0) {
+        return 0;
+    }
+
+    // The free space runs from head to the oldest byte, wrapping at the end
+    free = ring->size - ring->count;
+    first = ring->size - ring->head;
+    if (first > len) {
+        first = len;
+    }
+    mem_copy_to(ring->base + ring->head, src, first, free < ring->size - ring->head ? free : ring->size - ring->head);
+    if (len > first) {
+        mem_copy_to(ring->base, src + first, len - first, free - (ring->size - ring->head));
+    }
+
+    ring->head = (ring->head + len) % ring->size;
+    ring->count += len;
+    return len;
+}
+
+uint32_t dram_ring_peek(const dram_ring_t *ring, uint32_t offset, void *buf, uint32_t len) {
+    uint8_t *dst = (uint8_t *)buf;
+    uint32_t start, first;
+
+    if (offset >= ring->count) {
+        return 0;
+    }
+    if (len > ring->count - offset) {
+        len = ring->count - offset;
+    }
+
+    start = (ring->head + ring->size - ring->count + offset) % ring->size;
+    first = ring->size - start;
+    if (first > len) {
+        first = len;
+    }
+    dram_memcpy_from(ring->base + start, dst, first);
+    dram_memcpy_from(ring->base, dst + first, len - first);
+    return len;
+}
+
+uint32_t dram_ring_read(dram_ring_t *ring, void *buf, uint32_t len) {
+    len = dram_ring_peek(ring, 0, buf, len);
+    ring->count -= len;
+    return len;
+}
@@ -0,0 +1,70 @@
+#ifndef DRAM_MEM_H
+#define DRAM_MEM_H
+
+#include "dram.h"
+
+// Byte-addressable storage
+//
+// A range of rows is used as linear memory: byte address a is byte
+// a % DRAM_ROW_BYTES of row first_row + a / DRAM_ROW_BYTES. Accesses go
+// through a write-back cache of whole rows in SRAM with LRU replacement, held
+// in lines the caller passes to dram_mem_init(), so the storage costs no SRAM
+// while it is not in use; a miss costs one row write (dram_write_row()) to write back
+// the evicted row if it is dirty and one row read to fill the new one, unless
+// the access overwrites the whole row. Sequential access therefore costs about
+// one row transfer per row.
+//
+// Other primitives on the same rows bypass the cache: dram_mem_flush() before
+// and dram_mem_invalidate() after them.
+
+typedef struct {
+    uint8_t valid;
+    uint8_t dirty;
+    uint8_t row;
+    uint32_t used;      // access count of the last access, for LRU
+    uint8_t data[DRAM_ROW_BYTES];
+} dram_mem_line_t;
+
+typedef struct {
+    uint32_t hits;          // row accesses served from the cache
+    uint32_t misses;        // rows read in
+    uint32_t skipped;       // misses that overwrote the whole row and read nothing
+    uint32_t writebacks;    // dirty rows written back
+} dram_mem_stats_t;
+
+// Use rows first_row .. first_row + rows - 1, cached in 'lines' (n_lines >= 1
+// unless rows is 0). The range ends before the first row dram_compute_init()
+// reserved, so call it after that and check dram_mem_size(). Writes back the
+// old cache, so before the old lines go out of scope detach them with
+// dram_mem_init(0, 0, NULL, 0).
+void dram_mem_init(uint8_t first_row, uint16_t rows, dram_mem_line_t *lines, uint8_t n_lines);
+uint32_t dram_mem_size(void);
+
+// Return the number of bytes copied, less than len at the end of the memory
+uint32_t dram_memcpy_to(uint32_t addr, const void *buf, uint32_t len);
+uint32_t dram_memcpy_from(uint32_t addr, void *buf, uint32_t len);
+
+void dram_mem_flush(void);          // write back the dirty rows
+void dram_mem_invalidate(void);     // drop the cache without writing back
+
+void dram_get_mem_stats(dram_mem_stats_t *stats);
+void dram_reset_mem_stats(void);
+
+// Byte ring buffer in the storage. A plain ring rejects what does not fit. A
+// log makes room by dropping its oldest bytes up to the end of the row being
+// written, so it holds at least size - DRAM_ROW_BYTES of the newest bytes and
+// never reads a row back just to append to it.
+typedef struct {
+    uint32_t base;      // byte address of the buffer
+    uint32_t size;      // capacity in bytes
+    uint32_t head;      // offset of the next byte written
+    uint32_t count;     // bytes stored
+    uint8_t overwrite;  // 1: log
+} dram_ring_t;
+
+void dram_ring_init(dram_ring_t *ring, uint32_t base, uint32_t size, uint8_t overwrite);
+uint32_t dram_ring_write(dram_ring_t *ring, const void *buf, uint32_t len);  // bytes stored
+uint32_t dram_ring_read(dram_ring_t *ring, void *buf, uint32_t len);         // bytes removed, oldest first
+uint32_t dram_ring_peek(const dram_ring_t *ring, uint32_t offset, void *buf, uint32_t len);  // without removing
+
+#endif // DRAM_MEM_H
@@ -0,0 +1,165 @@
+#include "dram_queue.h"
+
+static dram_queue_entry_t queue[DRAM_QUEUE_SIZE];
+static uint8_t queue_count = 0;
+static dram_queue_stats_t queue_stats;
+
+static void queue_add(uint8_t op, uint8_t row, uint8_t col, uint8_t bits, uint32_t data, uint32_t *result) {
+    dram_queue_entry_t *e;
+
+    if (queue_count == DRAM_QUEUE_SIZE) {
+        dram_queue_flush();
+    }
+    e = &queue[queue_count++];
+    e->op = op;
+    e->row = row;
+    e->col = col;
+    e->bits = bits;
+    e->data = data;
+    e->result = result;
+}
+
+void dram_queue_read(uint8_t row, uint8_t col, uint8_t bits, uint32_t *result) {
+    queue_add(DRAM_QUEUE_READ, row, col, bits, 0, result);
+}
+
+void dram_queue_write(uint8_t row, uint8_t col, uint32_t data, uint8_t bits) {
+    queue_add(DRAM_QUEUE_WRITE, row, col, bits, data, 0);
+}
+
+void dram_queue_copy(uint8_t src, uint8_t dst) {
+    queue_add(DRAM_QUEUE_COPY, src, dst, 0, 0, 0);
+}
+
+static uint32_t queue_mask(uint8_t bits) {
+    return bits >= 32 ? 0xFFFFFFFF : ((uint32_t)1 << bits) - 1;
+}
+
+// Largest SRAM kernel for the start of a run of bits: 32, 16 or 8 data bits,
+// or 0 for a remainder that takes the page mode loop
+static uint8_t kernel_bits(uint8_t bits) {
+    return bits >= 32 ? 32 : bits >= 16 ? 16 : bits >= 8 ? 8 : 0;
+}
+
+// Read a merged run through the unrolled kernels, one RAS cycle per
+// DRAM_BURST_COLS columns
+static uint32_t queue_read_run(uint8_t row, uint8_t col, uint8_t bits) {
+    uint32_t data = 0;
+
+    for (uint8_t done = 0; done < bits;) {
+        uint8_t c = col + DRAM_BIT_COL(done), n = kernel_bits(bits - done);
+        uint32_t part;
+        switch (n) {
+        case 32: part = dram_read_fpm32(row, c); break;
+        case 16: part = dram_read_fpm16(row, c); break;
+        case 8: part = dram_read_fpm8(row, c); break;
+        default: n = bits - done; part = dram_read_fpm(row, c, n); break;
+        }
+        data |= part << done;
+        done += n;
+    }
+    return data;
+}
+
+static void queue_write_run(uint8_t row, uint8_t col, uint32_t data, uint8_t bits) {
+    for (uint8_t done = 0; done < bits;) {
+        uint8_t c = col + DRAM_BIT_COL(done), n = kernel_bits(bits - done);
+        uint32_t part = data >> done;
+        switch (n) {
+        case 32: dram_write_fpm32(row, c, part); break;
+        case 16: dram_write_fpm16(row, c, part); break;
+        case 8: dram_write_fpm8(row, c, part); break;
+        default: n = bits - done; dram_write_fpm(row, c, part, n); break;
+        }
+        done += n;
+    }
+}
+
+// Issue queue[start..end), which holds no copies, grouped by row
+static void queue_schedule(uint8_t start, uint8_t end) {
+    uint8_t order[DRAM_QUEUE_SIZE];
+    uint8_t n = 0;
+
+    // Stable insertion sort by row keeps program order within a row, so a
+    // read still sees every earlier write to its columns
+    for (uint8_t i = start; i < end; i++) {
+        uint8_t j = n++;
+        while (j > 0 && queue[order[j - 1]].row > queue[i].row) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = i;
+    }
+
+    for (uint8_t i = 0; i < n;) {
+        const dram_queue_entry_t *first = &queue[order[i]];
+        uint16_t next_col = first->col + DRAM_BIT_COL(first->bits);
+        uint32_t data = first->data & queue_mask(first->bits);
+        uint8_t bits = first->bits;
+        uint8_t last = i + 1;
+
+        // Extend the burst while the next operation in the row continues it
+        while (last < n) {
+            const dram_queue_entry_t *e = &queue[order[last]];
+            if (e->row != first->row || e->op != first->op || e->col != next_col || bits + e->bits > DRAM_QUEUE_MAX_BURST) {
+                break;
+            }
+            data |= (e->data & queue_mask(e->bits)) << bits;
+            bits += e->bits;
+            next_col += DRAM_BIT_COL(e->bits);
+            last++;
+        }
+
+        if (first->op == DRAM_QUEUE_WRITE) {
+            queue_write_run(first->row, first->col, data, bits);
+        } else {
+            data = queue_read_run(first->row, first->col, bits);
+            for (uint8_t j = i; j < last; j++) {
+                const dram_queue_entry_t *e = &queue[order[j]];
+                *e->result = (data >> ((e->col - first->col) * DRAM_CHIPS)) & queue_mask(e->bits);
+            }
+        }
+        queue_stats.bursts++;
+        queue_stats.merged += last - i - 1;
+        i = last;
+    }
+}
+
+void dram_queue_flush(void) {
+    dram_page_stats_t before, after;
+    uint8_t open_page = dram_set_open_page(1);
+    uint8_t start = 0;
+
+    dram_get_page_stats(&before);
+    while (start < queue_count) {
+        uint8_t end = start;
+        while (end < queue_count && queue[end].op != DRAM_QUEUE_COPY) {
+            end++;
+        }
+        queue_schedule(start, end);
+        if (end < queue_count) {
+            dram_copyrow(queue[end].row, queue[end].col);
+            queue_stats.bursts++;
+            end++;
+        }
+        start = end;
+    }
+    dram_close_page();
+    dram_get_page_stats(&after);
+    dram_set_open_page(open_page);
+
+    queue_stats.ops += queue_count;
+    queue_stats.activations += after.activations - before.activations;
+    queue_count = 0;
+}
+
+void dram_get_queue_stats(dram_queue_stats_t *stats) {
+    *stats = queue_stats;
+}
+
+void dram_reset_queue_stats(void) {
+    queue_stats.ops = 0;
+    queue_stats.bursts = 0;
+    queue_stats.merged = 0;
+    queue_stats.activations = 0;
+}
@@ -0,0 +1,48 @@
+#ifndef DRAM_QUEUE_H
+#define DRAM_QUEUE_H
+
+#include "dram.h"
+
+// Batched command queue
+//
+// Reads, writes and row copies are queued and issued by dram_queue_flush(),
+// which also runs when the queue is full. Between two copies the scheduler
+// groups the operations by row, keeping their order within a row, and merges
+// consecutive reads or writes of adjacent columns into one burst of up to 32
+// data bits. Whole bytes of a burst go through the unrolled SRAM kernels
+// (dram_read_fpm32() and friends, one RAS cycle per DRAM_BURST_COLS columns),
+// leftover bits through the page mode loop in open-page mode. Copies act as
+// barriers. Read results are stored through their pointer during the flush.
+
+#define DRAM_QUEUE_SIZE      16
+#define DRAM_QUEUE_MAX_BURST 32     // data bits per merged burst, the width of dram_read_fpm32()
+
+#define DRAM_QUEUE_READ  0
+#define DRAM_QUEUE_WRITE 1
+#define DRAM_QUEUE_COPY  2
+
+typedef struct {
+    uint8_t op;
+    uint8_t row;        // source row for copies
+    uint8_t col;        // destination row for copies
+    uint8_t bits;
+    uint32_t data;
+    uint32_t *result;
+} dram_queue_entry_t;
+
+typedef struct {
+    uint32_t ops;           // operations flushed
+    uint32_t bursts;        // FPM bursts and copies issued for them
+    uint32_t merged;        // operations folded into the burst of another one
+    uint32_t activations;   // RAS activations for reads and writes
+} dram_queue_stats_t;
+
+void dram_queue_read(uint8_t row, uint8_t col, uint8_t bits, uint32_t *result);
+void dram_queue_write(uint8_t row, uint8_t col, uint32_t data, uint8_t bits);
+void dram_queue_copy(uint8_t src, uint8_t dst);
+void dram_queue_flush(void);
+
+void dram_get_queue_stats(dram_queue_stats_t *stats);
+void dram_reset_queue_stats(void);
+
+#endif // DRAM_QUEUE_H
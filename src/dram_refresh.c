@@ -0,0 +1,167 @@
+#include "dram_refresh.h"
+#include "dram.h"
+
+uint8_t dram_row_stamp[256];
+volatile uint8_t dram_busy = 0;
+uint8_t dram_retention_bins[64];
+
+static uint8_t refresh_enabled = 0;
+static uint8_t refresh_multirate = 0;
+static uint8_t refresh_cursor = 0;
+static uint32_t last_poll;
+static dram_refresh_stats_t refresh_stats;
+static dram_scrub_fn refresh_scrub;
+static const uint8_t *hold_rows;
+
+// RAS-only refresh of every row, restarting all deadlines
+static void refresh_all(void) {
+    dram_busy++;
+    for (uint16_t row = 0; row < 256; row++) {
+        dram_refresh_row_raw(row);
+    }
+    last_poll = SysTick->CNT;
+    dram_busy--;
+}
+
+// Turn the refresh engine on or off. Enabling refreshes the whole array once,
+// since rows may have aged arbitrarily while the engine was off.
+void dram_refresh_enable(uint8_t enable) {
+    if (enable && !refresh_enabled) {
+        refresh_all();
+    }
+    refresh_enabled = enable;
+}
+
+// Examine the rows that are due for a check and refresh those close to their
+// deadline. Cheap when called more often than once per tick.
+void dram_refresh_poll(void) {
+    uint32_t now, elapsed;
+    uint16_t count;
+    uint8_t now_ticks, age;
+    uint8_t scrub = 1;
+
+    if (!refresh_enabled || dram_busy) {
+        return;
+    }
+    now = SysTick->CNT;
+    elapsed = now - last_poll;
+    if (elapsed < DRAM_REFRESH_TICK_CYCLES) {
+        return;
+    }
+    dram_busy++;
+
+    // Examine a share of the array per elapsed tick, all of it after a full
+    // sweep. Only whole ticks are consumed so that the sweep rate does not drift.
+    elapsed >>= DRAM_REFRESH_TICK_SHIFT;
+    last_poll += elapsed << DRAM_REFRESH_TICK_SHIFT;
+    count = (elapsed >= DRAM_REFRESH_SWEEP_TICKS) ? 256 : elapsed * DRAM_REFRESH_ROWS_PER_TICK;
+    now_ticks = now >> DRAM_REFRESH_TICK_SHIFT;
+
+    while (count--) {
+        uint8_t row = refresh_cursor++;
+        uint16_t deadline = DRAM_REFRESH_DEADLINE_TICKS;
+        if (hold_rows && (hold_rows[row >> 3] & (1 << (row & 7)))) {
+            continue;
+        }
+        if (refresh_multirate) {
+            deadline <<= dram_retention_bin(row);
+        }
+        age = now_ticks - dram_row_stamp[row];
+        if (age > deadline) {
+            refresh_stats.misses++;
+        }
+        if (age + DRAM_REFRESH_SLACK_TICKS >= deadline) {
+            // The scrubber may take one due row per poll; its read refreshes it
+            if (scrub && refresh_scrub && refresh_scrub(row)) {
+                refresh_stats.scrubs++;
+                scrub = 0;
+            } else {
+                dram_refresh_row_raw(row);
+            }
+            refresh_stats.refreshes++;
+        }
+    }
+
+    dram_busy--;
+}
+
+// Leave the rows of a 256 row bitmap (bit (r&7) of rows[r>>3]) alone, so that
+// they decay or get disturbed as the experiment intends. The bitmap is used in
+// place until dram_refresh_hold(NULL).
+void dram_refresh_hold(const uint8_t *rows) {
+    hold_rows = rows;
+}
+
+// Row scrubber called in place of a due refresh (dram_ecc.c), NULL for none
+void dram_refresh_set_scrub(dram_scrub_fn fn) {
+    refresh_scrub = fn;
+}
+
+// Refresh each row according to its retention bin instead of every 4 ms.
+// Only meaningful after dram_profile_retention() has filled in the bins.
+// Disabling refreshes the whole array once: rows of the higher bins may be
+// up to 32 ms old and would all be past the 4 ms deadline at once.
+void dram_refresh_set_multirate(uint8_t enable) {
+    if (!enable && refresh_multirate) {
+        refresh_all();
+    }
+    refresh_multirate = enable;
+}
+
+static void retention_fill(uint16_t pattern) {
+    for (uint16_t row = 0; row < 256; row++) {
+        for (uint16_t bit = 0; bit < DRAM_ROW_BITS; bit += 16) {
+            dram_write_fpm(row, DRAM_BIT_COL(bit), pattern, 16);
+        }
+    }
+}
+
+// Demote every row that lost any bit of 'pattern' to a bin below 'bin'
+static void retention_check(uint16_t pattern, uint8_t bin) {
+    for (uint16_t row = 0; row < 256; row++) {
+        for (uint16_t bit = 0; bit < DRAM_ROW_BITS; bit += 16) {
+            if (dram_read_fpm(row, DRAM_BIT_COL(bit), 16) != pattern) {
+                if (dram_retention_bin(row) >= bin) {
+                    uint8_t shift = (row & 3) << 1;
+                    dram_retention_bins[row >> 2] &= ~(3 << shift);
+                    dram_retention_bins[row >> 2] |= (bin - 1) << shift;
+                }
+                break;
+            }
+        }
+    }
+}
+
+// Measure the retention bin of every row. Writes all-0 and all-1 patterns,
+// pauses refresh for DRAM_RETENTION_TEST_MS(bin) and reads them back, for
+// increasing bins. Bursts are 16 columns to stay within tRAS max. Rows are
+// written and read in the same order, so every row sees at least the nominal
+// pause. Destroys the array contents and takes under a second.
+void dram_profile_retention(void) {
+    uint8_t was_enabled = refresh_enabled;
+
+    for (uint8_t i = 0; i < 64; i++) {
+        dram_retention_bins[i] = 0xFF;   // every row in the top bin
+    }
+
+    dram_refresh_enable(0);
+    for (uint8_t bin = 1; bin < DRAM_RETENTION_BINS; bin++) {
+        for (uint8_t p = 0; p < 2; p++) {
+            uint16_t pattern = p ? 0xFFFF : 0x0000;
+            retention_fill(pattern);
+            Delay_Ms(DRAM_RETENTION_TEST_MS(bin));
+            retention_check(pattern, bin);
+        }
+    }
+    dram_refresh_enable(was_enabled);
+}
+
+void dram_get_refresh_stats(dram_refresh_stats_t *stats) {
+    *stats = refresh_stats;
+}
+
+void dram_reset_refresh_stats(void) {
+    refresh_stats.refreshes = 0;
+    refresh_stats.misses = 0;
+    refresh_stats.scrubs = 0;
+}
@@ -0,0 +1,84 @@
+#ifndef DRAM_REFRESH_H
+#define DRAM_REFRESH_H
+
+#include "dram.h"
+
+// Deadline-driven refresh
+//
+// Every RAS cycle refreshes its row, so the driver records a timestamp for
+// each activation and the refresh engine only issues RAS-only refreshes for
+// rows that no normal access has touched recently. The engine runs from
+// dram_refresh_poll(), which every DRAM primitive calls before it starts and
+// which can also be called from a timer interrupt: it never runs while a
+// primitive owns the pins, so FPM bursts are not split.
+
+// Timestamps are SysTick >> DRAM_REFRESH_TICK_SHIFT (~171 us at 48 MHz). They
+// are kept in 8 bits to save SRAM, so ages wrap after 256 ticks (~44 ms): every
+// deadline plus the slack below must stay under that.
+#define DRAM_REFRESH_TICK_SHIFT  13
+#define DRAM_REFRESH_TICK_CYCLES (1UL << DRAM_REFRESH_TICK_SHIFT)
+#define DRAM_REFRESH_NOW()       ((uint8_t)(SysTick->CNT >> DRAM_REFRESH_TICK_SHIFT))
+
+// All 256 rows must be refreshed within 4 ms
+#define DRAM_REFRESH_DEADLINE_TICKS ((uint16_t)(FUNCONF_SYSTEM_CORE_CLOCK / 250 / DRAM_REFRESH_TICK_CYCLES))
+
+// The cursor covers the array once per sweep of two ticks (~0.34 ms), less
+// than the 0.5 ms between the TIM1 polls in main.c, so each of those polls
+// examines every row. A row is therefore examined again within one poll
+// period (DRAM_REFRESH_POLL_TICKS) plus one tick of stamp rounding, and it is
+// refreshed when it would otherwise pass its deadline before that. A row
+// untouched by normal accesses is refreshed every ~3.3 ms.
+#define DRAM_REFRESH_SWEEP_TICKS 2
+#define DRAM_REFRESH_ROWS_PER_TICK ((256 + DRAM_REFRESH_SWEEP_TICKS - 1) / DRAM_REFRESH_SWEEP_TICKS)
+#define DRAM_REFRESH_POLL_TICKS  3  // TIM1 period, 0.5 ms, in ticks rounded up
+#define DRAM_REFRESH_SLACK_TICKS (DRAM_REFRESH_POLL_TICKS + 1)
+
+// Retention bins
+//
+// Cells leak at very different rates (compare the images in images/), so the
+// profiler measures how long each row holds its data and the engine can refresh
+// strong rows less often. A row in bin k has a deadline of 4 ms << k. It is put
+// there after it held both all-0 and all-1 patterns for twice that long without
+// refresh, which leaves a factor 2 for temperature and pattern effects. Bin 0 is
+// the datasheet rate and the default for every row. The 8 bit timestamps limit
+// the bins to 32 ms deadlines, two bits per row.
+#define DRAM_RETENTION_BINS 4
+#define DRAM_RETENTION_TEST_MS(bin) (8UL << (bin))
+
+typedef struct {
+    uint32_t refreshes;     // RAS-only refresh cycles issued by the engine
+    uint32_t misses;        // rows found past their deadline
+    uint32_t scrubs;        // refreshes done by the scrubber instead
+} dram_refresh_stats_t;
+
+// A scrubber can take over the refresh of one due row per poll: it is called
+// with the engine holding the pins, may use the normal primitives, and returns
+// 0 for rows it does not handle, which then get a RAS-only refresh
+typedef uint8_t (*dram_scrub_fn)(uint8_t row);
+
+extern uint8_t dram_row_stamp[256];
+extern volatile uint8_t dram_busy;
+extern uint8_t dram_retention_bins[64];   // two bits per row, low bits = first row
+
+static inline uint8_t dram_retention_bin(uint8_t row) {
+    return (dram_retention_bins[row >> 2] >> ((row & 3) << 1)) & 3;
+}
+
+// Record that 'row' was activated (any RAS cycle restores the whole row)
+static inline void dram_refresh_mark(uint8_t row) {
+    dram_row_stamp[row] = DRAM_REFRESH_NOW();
+}
+
+// RAS-only refresh without taking part in the busy/poll protocol (dram.c)
+void dram_refresh_row_raw(uint8_t row);
+
+void dram_refresh_enable(uint8_t enable);
+void dram_refresh_poll(void);
+void dram_refresh_set_multirate(uint8_t enable);
+void dram_refresh_set_scrub(dram_scrub_fn fn);
+void dram_refresh_hold(const uint8_t *rows);
+void dram_profile_retention(void);
+void dram_get_refresh_stats(dram_refresh_stats_t *stats);
+void dram_reset_refresh_stats(void);
+
+#endif // DRAM_REFRESH_H
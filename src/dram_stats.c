@@ -0,0 +1,53 @@
+#include "dram.h"
+#include "dram_stats.h"
+#include "dram_refresh.h"
+#include <string.h>
+
+#if DRAM_STATS_ENABLED
+
+dram_stats_t dram_stats;
+uint32_t dram_stats_ras_since;
+
+static const char *const stats_names[DRAM_STATS_OPS] = {
+    "bit", "fpm", "read burst", "write burst", "refresh row", "dram_copyrow",
+    "dram_set_row", "strided", "rmw", "in-array", "dram_hammer_rows",
+};
+
+void dram_stats_record(uint8_t op, uint32_t cycles) {
+    dram_stats_op_t *s = &dram_stats.op[op];
+    uint8_t bucket = 0;
+
+    if (cycles >= 32) {
+        bucket = (28 - __builtin_clz(cycles)) / 2;  // (floor(log2(cycles)) - 3) / 2
+        if (bucket >= DRAM_STATS_BUCKETS) {
+            bucket = DRAM_STATS_BUCKETS - 1;
+        }
+    }
+    s->calls++;
+    s->cycles += cycles;
+    if (cycles > s->max) {
+        s->max = cycles;
+    }
+    if (s->hist[bucket] != 0xFFFF) {
+        s->hist[bucket]++;
+    }
+}
+
+// The refresh interrupt updates the counters too; copy with it held off
+void dram_get_stats(dram_stats_t *stats) {
+    dram_busy++;
+    *stats = dram_stats;
+    dram_busy--;
+}
+
+void dram_reset_stats(void) {
+    dram_busy++;
+    memset(&dram_stats, 0, sizeof(dram_stats));
+    dram_busy--;
+}
+
+const char *dram_stats_name(uint8_t op) {
+    return (op < DRAM_STATS_OPS) ? stats_names[op] : "?";
+}
+
+#endif // DRAM_STATS_ENABLED
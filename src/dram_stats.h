@@ -0,0 +1,83 @@
+#ifndef DRAM_STATS_H
+#define DRAM_STATS_H
+
+#include <stdint.h>
+
+// Driver statistics
+//
+// Built with -DDRAM_STATS (make DRAM_STATS=1, also in sim/), the primitives
+// of dram.c count RAS activations, CAS cycles, RAS-only refreshes and the
+// cycles with RAS low, and time every call with SysTick: per operation the
+// number of calls, total and maximum cycles and a histogram of the cost in
+// powers of four. Without it the macros below are empty and nothing is
+// compiled in, so the hooks can stay in production code. Enabled, it costs
+// two SysTick reads per call and ~300 bytes of SRAM, as much again on the
+// stack of whoever takes a snapshot.
+//
+// The cycles of an operation include everything inside the call, nested
+// operations too: dram_set_row() contains a refresh. RAS low time covers row
+// accesses, bursts and refreshes, not the glitch, copy and hammer sequences.
+
+#if defined(DRAM_STATS)
+#define DRAM_STATS_ENABLED 1
+#else
+#define DRAM_STATS_ENABLED 0
+#endif
+
+#define DRAM_STATS_BIT         0   // dram_read_bit(), dram_write_bit()
+#define DRAM_STATS_FPM         1   // dram_read_fpm(), dram_write_fpm()
+#define DRAM_STATS_READ_BURST  2   // SRAM kernels: dram_read_fpm8/16/32(), dram_read_row/burst()
+#define DRAM_STATS_WRITE_BURST 3   // dram_write_fpm8/16/32(), dram_write_row/burst()
+#define DRAM_STATS_REFRESH_ROW 4   // dram_refresh_row(), and every row of the refresh engine
+#define DRAM_STATS_COPYROW     5   // dram_copyrow()
+#define DRAM_STATS_SET_ROW     6   // dram_set_row(), dram_set_row_pulse()
+#define DRAM_STATS_STRIDED     7   // dram_read/write_strided(), dram_read/write_cols()
+#define DRAM_STATS_RMW         8   // dram_rmw_bit(), dram_rmw_fpm(), dram_rmw_xor/increment()
+#define DRAM_STATS_IN_ARRAY    9   // dram_copyrow_fanout(), dram_activate_triple()
+#define DRAM_STATS_HAMMER      10  // dram_hammer_rows()
+#define DRAM_STATS_OPS         11
+
+// Bucket 0 counts calls under 32 cycles, bucket k calls of 8 << 2k up to
+// 32 << 2k cycles, the last one everything from 8192 on. The counts stop at
+// 0xFFFF.
+#define DRAM_STATS_BUCKETS     6
+
+typedef struct {
+    uint32_t calls;
+    uint32_t cycles;        // total
+    uint32_t max;
+    uint16_t hist[DRAM_STATS_BUCKETS];
+} dram_stats_op_t;
+
+typedef struct {
+    uint32_t activations;   // RAS falling edges
+    uint32_t cas_cycles;    // columns accessed
+    uint32_t refreshes;     // RAS-only refresh cycles
+    uint32_t ras_low;       // cycles with RAS low
+    dram_stats_op_t op[DRAM_STATS_OPS];
+} dram_stats_t;
+
+#if DRAM_STATS_ENABLED
+extern dram_stats_t dram_stats;
+extern uint32_t dram_stats_ras_since;
+
+void dram_stats_record(uint8_t op, uint32_t cycles);
+void dram_get_stats(dram_stats_t *stats);
+void dram_reset_stats(void);
+const char *dram_stats_name(uint8_t op);
+
+// Time the rest of the enclosing block as operation 'op'
+#define DRAM_STATS_ENTER()      uint32_t _stats_start = SysTick->CNT
+#define DRAM_STATS_LEAVE(op)    dram_stats_record((op), SysTick->CNT - _stats_start)
+#define DRAM_STATS_ADD(field, n) (dram_stats.field += (n))
+#define DRAM_STATS_RAS_LOW()    (dram_stats_ras_since = SysTick->CNT)
+#define DRAM_STATS_RAS_HIGH()   (dram_stats.ras_low += SysTick->CNT - dram_stats_ras_since)
+#else
+#define DRAM_STATS_ENTER()      do { } while (0)
+#define DRAM_STATS_LEAVE(op)    do { } while (0)
+#define DRAM_STATS_ADD(field, n) do { } while (0)
+#define DRAM_STATS_RAS_LOW()    do { } while (0)
+#define DRAM_STATS_RAS_HIGH()   do { } while (0)
+#endif
+
+#endif // DRAM_STATS_H
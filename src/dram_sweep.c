@@ -0,0 +1,38 @@
+#include "dram_sweep.h"
+
+static uint16_t sweep_per_mille(uint32_t count, uint32_t total) {
+    return total ? (uint16_t)(count * 1000 / total) : DRAM_SWEEP_NONE;  // count <= 2^18
+}
+
+// One combination over all rows of the range
+static void sweep_cell(const dram_sweep_config_t *cfg, uint8_t pattern, uint8_t width, uint8_t reps,
+                       dram_sweep_cell_t *cell) {
+    uint8_t buf[DRAM_BURST_BYTES];
+    uint32_t set = 0, cleared = 0;
+    uint32_t ones = (uint32_t)__builtin_popcount(pattern) * DRAM_ROW_BYTES * cfg->rows;
+
+    for (uint16_t r = 0; r < cfg->rows; r++) {
+        uint8_t row = cfg->first_row + r;
+        dram_write_page(row, pattern * 0x01010101UL);
+        dram_set_row_pulse(row, reps, width);
+        for (uint16_t i = 0; i < DRAM_ROW_BYTES; i += DRAM_BURST_BYTES) {
+            dram_read_burst(row, DRAM_BIT_COL(8 * i), buf, DRAM_BURST_BYTES);
+            for (uint8_t j = 0; j < DRAM_BURST_BYTES; j++) {
+                set += __builtin_popcount(buf[j] & (uint8_t)~pattern);
+                cleared += __builtin_popcount(pattern & (uint8_t)~buf[j]);
+            }
+        }
+    }
+    cell->set = sweep_per_mille(set, (uint32_t)DRAM_ROW_BYTES * 8 * cfg->rows - ones);
+    cell->cleared = sweep_per_mille(cleared, ones);
+}
+
+void dram_sweep_set_row(const dram_sweep_config_t *cfg, dram_sweep_cell_t *cells) {
+    for (uint8_t p = 0; p < cfg->n_patterns; p++) {
+        for (uint8_t w = 0; w < cfg->n_widths; w++) {
+            for (uint8_t r = 0; r < cfg->n_reps; r++) {
+                sweep_cell(cfg, cfg->patterns[p], cfg->widths[w], cfg->reps[r], cells++);
+            }
+        }
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef DRAM_SWEEP_H
+#define DRAM_SWEEP_H
+
+#include "dram.h"
+
+// Parameter sweep of the RAS glitch row setting
+//
+// For every combination of fill pattern, glitch pulse width and repetition
+// count, each row of the range is filled with the pattern, glitched with
+// dram_set_row_pulse() and read back. A cell of the result holds the share of
+// the pattern's 0 bits that read back as 1 and of its 1 bits that read back
+// as 0, in per mille over all rows, so a full characterization is a small
+// matrix instead of row dumps. Cells are stored with the repetition count
+// varying fastest, then the width, then the pattern.
+
+#define DRAM_SWEEP_NONE 0xFFFF     // the pattern has no bits of that value
+
+typedef struct {
+    uint8_t first_row;
+    uint16_t rows;
+    const uint8_t *patterns;    // fill bytes
+    uint8_t n_patterns;
+    const uint8_t *widths;      // dram_set_row_pulse() widths
+    uint8_t n_widths;
+    const uint8_t *reps;        // glitches per row
+    uint8_t n_reps;
+} dram_sweep_config_t;
+
+typedef struct {
+    uint16_t set;               // per mille of the 0 bits now 1
+    uint16_t cleared;           // per mille of the 1 bits now 0
+} dram_sweep_cell_t;
+
+#define DRAM_SWEEP_CELLS(cfg) ((cfg)->n_patterns * (cfg)->n_widths * (cfg)->n_reps)
+
+// Fill 'cells' (DRAM_SWEEP_CELLS() entries); destroys the rows' contents
+void dram_sweep_set_row(const dram_sweep_config_t *cfg, dram_sweep_cell_t *cells);
+
+#endif // DRAM_SWEEP_H
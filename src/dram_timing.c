@@ -0,0 +1,119 @@
+#include "dram_timing.h"
+#include "dram_trace.h"
+
+static const uint8_t test_rows[DRAM_TIMING_TEST_ROWS] = {0x00, 0x25, 0x4A, 0x6F, 0x90, 0xB5, 0xDA, 0xFF};
+
+#define TIMING_RECORD ((const dram_timing_record_t *)dram_flash_ptr(DRAM_TIMING_FLASH_ADDR))
+
+static uint32_t timing_word(const dram_timing_t *timing) {
+    return timing->rcd | (timing->cas << 8) | ((uint32_t)timing->cp << 16) | ((uint32_t)timing->rp << 24);
+}
+
+// Pattern byte for test row i, pattern p (solid, checkerboard, pseudo-random)
+static uint8_t test_pattern(uint8_t p, uint8_t i, uint8_t byte) {
+    switch (p) {
+    case 0:  return 0x00;
+    case 1:  return 0xFF;
+    case 2:  return (i & 1) ? 0x55 : 0xAA;
+    default: return (uint8_t)((byte * 0x9D) ^ (i * 0x3B) ^ 0xC5);
+    }
+}
+
+// Write every test row back to back, then read them back to back, so that tRP
+// is exercised as well as the column timing. Uses 16 column bursts of the SRAM
+// kernels to stay within tRAS max. Returns 1 if all data matched.
+uint8_t dram_timing_test(void) {
+    for (uint8_t p = 0; p < 4; p++) {
+        for (uint8_t i = 0; i < DRAM_TIMING_TEST_ROWS; i++) {
+            for (uint8_t b = 0; b < DRAM_ROW_BYTES; b += 2) {
+                dram_write_fpm16(test_rows[i], DRAM_BIT_COL(b * 8), test_pattern(p, i, b) | (test_pattern(p, i, b + 1) << 8));
+            }
+        }
+        for (uint8_t i = 0; i < DRAM_TIMING_TEST_ROWS; i++) {
+            for (uint8_t b = 0; b < DRAM_ROW_BYTES; b += 2) {
+                if (dram_read_fpm16(test_rows[i], DRAM_BIT_COL(b * 8)) != (test_pattern(p, i, b) | (test_pattern(p, i, b + 1) << 8))) {
+                    return 0;
+                }
+            }
+        }
+    }
+    return 1;
+}
+
+// Sweep each delay on its own, the others at their datasheet values. Returns 0
+// (and restores the datasheet timing) if the chip fails even the slowest setting.
+uint8_t dram_timing_calibrate(dram_timing_t *result) {
+    const dram_timing_t datasheet = DRAM_TIMING_DATASHEET;
+    dram_timing_t chosen;
+    uint8_t *chosen_param = (uint8_t *)&chosen;
+    DRAM_TRACE_ENTER(DRAM_TRACE_TAG_TIMING);
+
+    for (uint8_t p = 0; p < sizeof(dram_timing_t); p++) {
+        uint8_t value, lowest = 0;
+
+        dram_timing = datasheet;
+        for (value = DRAM_TIMING_MAX; value > 0; value--) {
+            ((uint8_t *)&dram_timing)[p] = value;
+            if (!dram_timing_test()) {
+                break;
+            }
+            lowest = value;
+        }
+        if (!lowest) {
+            dram_timing = datasheet;
+            DRAM_TRACE_LEAVE();
+            return 0;
+        }
+        // One iteration of margin if the sweep found the failing point
+        chosen_param[p] = value ? lowest + 1 : lowest;
+    }
+
+    dram_timing = chosen;
+    if (!dram_timing_test()) {
+        dram_timing = datasheet;
+        DRAM_TRACE_LEAVE();
+        return 0;
+    }
+    *result = chosen;
+    DRAM_TRACE_LEAVE();
+    return 1;
+}
+
+// Returns 1 and fills in 'timing' if a calibration result is stored
+uint8_t dram_timing_load(dram_timing_t *timing) {
+    const dram_timing_record_t *record = TIMING_RECORD;
+
+    if (record->magic != DRAM_TIMING_MAGIC || record->check != (DRAM_TIMING_MAGIC ^ timing_word(&record->timing))) {
+        return 0;
+    }
+    *timing = record->timing;
+    return 1;
+}
+
+void dram_timing_save(const dram_timing_t *timing) {
+    dram_timing_record_t record;
+
+    record.magic = DRAM_TIMING_MAGIC;
+    record.timing = *timing;
+    record.check = DRAM_TIMING_MAGIC ^ timing_word(timing);
+
+    dram_flash_write(DRAM_TIMING_FLASH_ADDR, &record, sizeof(record));
+}
+
+// Select the kernel timing at boot: use the stored result if it still passes
+// the pattern test (the DRAM may have been swapped), otherwise calibrate and
+// store. Returns 1 if the stored result was used.
+uint8_t dram_timing_init(void) {
+    dram_timing_t timing;
+
+    if (dram_timing_load(&timing)) {
+        dram_timing = timing;
+        if (dram_timing_test()) {
+            return 1;
+        }
+    }
+    if (dram_timing_calibrate(&timing)) {
+        dram_timing_save(&timing);
+    }
+    return 0;
+}
@@ -0,0 +1,33 @@
+#ifndef DRAM_TIMING_H
+#define DRAM_TIMING_H
+
+#include "dram.h"
+#include "dram_flash.h"
+
+// Timing calibration for the SRAM kernels
+//
+// The datasheet delays are sized for the slowest 4164 grade; most chips work
+// with much less. The calibration sweeps each delay of dram_timing down from
+// DRAM_TIMING_MAX while a write/read pattern test on the test rows passes, keeps
+// one loop iteration of margin above the last failing value, and checks the
+// combination. The result is stored in the last flash page (dram_flash.h) so
+// that later boots only have to verify it.
+
+// Rows overwritten by the pattern test (spread over both banks)
+#define DRAM_TIMING_TEST_ROWS 8
+
+#define DRAM_TIMING_MAGIC      0x54443431  // "14DT"
+
+typedef struct {
+    uint32_t magic;
+    dram_timing_t timing;
+    uint32_t check;         // magic ^ timing, catches erased or stale pages
+} dram_timing_record_t;
+
+uint8_t dram_timing_test(void);
+uint8_t dram_timing_calibrate(dram_timing_t *result);
+uint8_t dram_timing_load(dram_timing_t *timing);
+void dram_timing_save(const dram_timing_t *timing);
+uint8_t dram_timing_init(void);
+
+#endif // DRAM_TIMING_H
@@ -0,0 +1,134 @@
+#include "dram.h"
+#include "dram_trace.h"
+#include "dram_dump.h"
+
+#if DRAM_TRACE_ENABLED
+
+volatile uint8_t dram_trace_tag = DRAM_TRACE_TAG_NONE;
+
+static dram_trace_event_t events[DRAM_TRACE_EVENTS];
+static uint16_t head;           // next slot
+static uint16_t count;
+static uint32_t dropped;
+static uint8_t recording;
+static uint8_t last_addr, last_ctrl;
+
+void dram_trace_record(uint32_t cycle, uint8_t addr, uint8_t ctrl) {
+    if (!recording || (addr == last_addr && ctrl == last_ctrl)) {
+        return;
+    }
+    last_addr = addr;
+    last_ctrl = ctrl;
+
+    dram_trace_event_t *e = &events[head];
+    e->cycle = cycle;
+    e->addr = addr;
+    e->ctrl = ctrl;
+    e->tag = dram_trace_tag;
+    head = (head + 1) % DRAM_TRACE_EVENTS;
+    if (count < DRAM_TRACE_EVENTS) {
+        count++;
+    } else {
+        dropped++;
+    }
+}
+
+#ifndef DRAM_SIM
+// Cycles one dram_trace_access() adds to the traced code, and their sum so far
+static uint32_t sample_cost;
+static uint32_t correction;
+static uint32_t last_access;
+
+// Called before every GPIO access in dram.c. The pins read now are the result
+// of the previous access, so they are dated to that access.
+void *dram_trace_access(void *port) {
+    if (recording) {
+        uint32_t now = SysTick->CNT - correction;
+        dram_trace_record(last_access, DRAM_ADDR_PORT->OUTDR, DRAM_CTRL_PORT->OUTDR);
+        last_access = now;
+        correction += sample_cost;
+    }
+    return port;
+}
+
+uint32_t dram_trace_cost(void) {
+    return sample_cost;
+}
+
+// Time a few samples that record nothing
+static void trace_calibrate(void) {
+    uint32_t start;
+
+    recording = 1;
+    last_addr = DRAM_ADDR_PORT->OUTDR;
+    last_ctrl = DRAM_CTRL_PORT->OUTDR;
+    correction = 0;
+    start = SysTick->CNT;
+    for (uint8_t i = 0; i < 8; i++) {
+        dram_trace_access(0);
+    }
+    sample_cost = (SysTick->CNT - start) / 8;
+    recording = 0;
+}
+#endif
+
+// Clear the buffer and start recording, beginning with the current pin state
+void dram_trace_start(void) {
+    uint8_t addr = DRAM_ADDR_PORT->OUTDR, ctrl = DRAM_CTRL_PORT->OUTDR;
+
+#ifndef DRAM_SIM
+    if (!sample_cost) {
+        trace_calibrate();
+    }
+    correction = 0;
+    last_access = SysTick->CNT;
+#endif
+    head = 0;
+    count = 0;
+    dropped = 0;
+    recording = 1;
+    last_addr = ~addr;          // force the first event
+    dram_trace_record(SysTick->CNT, addr, ctrl);
+}
+
+void dram_trace_stop(void) {
+#ifndef DRAM_SIM
+    dram_trace_access(0);   // the result of the last access
+#endif
+    recording = 0;
+}
+
+uint16_t dram_trace_count(void) {
+    return count;
+}
+
+uint32_t dram_trace_dropped(void) {
+    return dropped;
+}
+
+void dram_trace_get(uint16_t index, dram_trace_event_t *event) {
+    *event = events[(head + DRAM_TRACE_EVENTS - count + index) % DRAM_TRACE_EVENTS];
+}
+
+void dram_trace_send(void) {
+    uint8_t payload[DRAM_TRACE_EVENTS_PER_FRAME * DRAM_TRACE_EVENT_BYTES];
+    uint8_t len = 0, frame = 0;
+
+    for (uint16_t i = 0; i < count; i++) {
+        dram_trace_event_t e;
+        dram_trace_get(i, &e);
+        payload[len++] = e.cycle;
+        payload[len++] = e.cycle >> 8;
+        payload[len++] = e.cycle >> 16;
+        payload[len++] = e.cycle >> 24;
+        payload[len++] = e.addr;
+        payload[len++] = e.ctrl;
+        payload[len++] = e.tag;
+        if (len == sizeof(payload) || i == count - 1) {
+            dram_dump_frame(DRAM_TRACE_FRAME, frame++, payload, len);
+            len = 0;
+        }
+    }
+}
+
+#endif // DRAM_TRACE_ENABLED
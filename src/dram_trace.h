@@ -0,0 +1,87 @@
+#ifndef DRAM_TRACE_H
+#define DRAM_TRACE_H
+
+#include <stdint.h>
+
+// GPIO trace
+//
+// Between dram_trace_start() and dram_trace_stop() every change of the
+// address port and the control port (dram_board.h) is recorded with its
+// cycle time and the tag of the code that made it, into a ring buffer that
+// keeps the newest DRAM_TRACE_EVENTS events.
+//
+// - Simulator (sim/): the bus model records every write, with exact cycles.
+// - Firmware built with -DDRAM_TRACE: every GPIO access in dram.c samples the
+//   pins first. The state after a store shows up at the next access and is
+//   dated back to the store; the cost of the sampling is subtracted, so the
+//   intervals come out within a few cycles of the untraced code. The real
+//   intervals are longer, so the page mode loops take one column per RAS
+//   cycle, and the SRAM kernels (dram_read_row(), dram_read_fpm16() etc.) are
+//   not traced at all.
+// - Otherwise nothing is compiled in.
+//
+// dram_trace_send() sends the buffer as dram_dump frames (DRAM_TRACE_FRAME,
+// row = frame number, payload = events of DRAM_TRACE_EVENT_BYTES bytes:
+// cycle, low byte first, address port, control port, tag).
+// tools/dram_trace turns them into a VCD file and checks the DRAM timing
+// rules; the tags let it accept the intentional violations of dram_copyrow()
+// and friends. This header is shared with the host tools.
+
+#if defined(DRAM_TRACE) || defined(DRAM_SIM)
+#define DRAM_TRACE_ENABLED 1
+#else
+#define DRAM_TRACE_ENABLED 0
+#endif
+
+#ifdef DRAM_SIM
+#define DRAM_TRACE_EVENTS 1024
+#else
+#define DRAM_TRACE_EVENTS 64    // 8 bytes of SRAM each
+#endif
+
+#define DRAM_TRACE_FRAME            0x30
+#define DRAM_TRACE_EVENT_BYTES      7
+#define DRAM_TRACE_EVENTS_PER_FRAME 36
+
+// Tags: code that breaks the timing rules on purpose
+#define DRAM_TRACE_TAG_NONE     0
+#define DRAM_TRACE_TAG_COPYROW  1   // dram_copyrow(), dram_copyrow_fanout(): short tRP
+#define DRAM_TRACE_TAG_SET_ROW  2   // dram_set_row(): RAS pulses shorter than sensing
+#define DRAM_TRACE_TAG_TRIPLE   3   // dram_activate_triple(): short RAS pulses
+#define DRAM_TRACE_TAG_TIMING   4   // dram_timing_calibrate(): delays swept below spec
+
+typedef struct {
+    uint32_t cycle;
+    uint8_t addr;   // address port output
+    uint8_t ctrl;   // control port output
+    uint8_t tag;
+} dram_trace_event_t;
+
+#if DRAM_TRACE_ENABLED
+extern volatile uint8_t dram_trace_tag;
+
+// Tag the pins changed until the end of the enclosing block
+#define DRAM_TRACE_ENTER(tag) uint8_t _trace_prev_tag = dram_trace_tag; dram_trace_tag = (tag)
+#define DRAM_TRACE_LEAVE()    (dram_trace_tag = _trace_prev_tag)
+#else
+#define DRAM_TRACE_ENTER(tag) do { } while (0)
+#define DRAM_TRACE_LEAVE()    do { } while (0)
+#endif
+
+void dram_trace_start(void);
+void dram_trace_stop(void);
+uint16_t dram_trace_count(void);
+uint32_t dram_trace_dropped(void);
+void dram_trace_get(uint16_t index, dram_trace_event_t *event);   // 0 = oldest
+void dram_trace_send(void);
+
+// Called by the recorders on every write
+void dram_trace_record(uint32_t cycle, uint8_t addr, uint8_t ctrl);
+
+#if defined(DRAM_TRACE) && !defined(DRAM_SIM)
+// Firmware recorder: samples the pins and returns 'port'
+void *dram_trace_access(void *port);
+uint32_t dram_trace_cost(void);     // cycles of one recording access, 0 before dram_trace_start()
+#endif
+
+#endif // DRAM_TRACE_H
@@ -0,0 +1,184 @@
+#include "dram_vector.h"
+
+static uint8_t vector_in_array(uint8_t op, uint8_t dst, uint8_t a, uint8_t b, uint8_t c) {
+    const uint8_t rows[3] = {a, b, c};
+
+    return dram_compute_in_array(op, dst, rows);
+}
+
+static void vector_fill_row(uint8_t row, uint16_t value) {
+    for (uint16_t bit = 0; bit < DRAM_ROW_BITS; bit += 16) {
+        dram_write_fpm16(row, DRAM_BIT_COL(bit), value);
+    }
+}
+
+// Transpose 16 elements at a time into one burst per plane
+void dram_vector_store(const dram_vector_t *v, uint16_t first, const uint8_t *values, uint16_t count) {
+    for (uint8_t k = 0; k < v->bits; k++) {
+        for (uint16_t i = 0; i < count; i += 16) {
+            uint16_t plane = 0;
+            for (uint8_t j = 0; j < 16 && i + j < count; j++) {
+                plane |= (uint16_t)((values[i + j] >> k) & 1) << j;
+            }
+            dram_write_fpm16(v->rows[k], DRAM_BIT_COL(first + i), plane);
+        }
+    }
+}
+
+void dram_vector_load(const dram_vector_t *v, uint16_t first, uint8_t *values, uint16_t count) {
+    for (uint16_t i = 0; i < count; i++) {
+        values[i] = 0;
+    }
+    for (uint8_t k = 0; k < v->bits; k++) {
+        for (uint16_t i = 0; i < count; i += 16) {
+            uint16_t plane = dram_read_fpm16(v->rows[k], DRAM_BIT_COL(first + i));
+            for (uint8_t j = 0; j < 16 && i + j < count; j++) {
+                values[i + j] |= ((plane >> j) & 1) << k;
+            }
+        }
+    }
+}
+
+// sum = a + b modulo 2^bits, all three vectors of the same width. In the
+// array, with c the carry plane and scratch rows for c, the next carry, ~c
+// and a temporary:
+//   carry' = MAJ(a, b, c)
+//   sum    = MAJ(~carry', c, MAJ(a, b, ~c))
+uint8_t dram_vector_add(const dram_vector_t *sum, const dram_vector_t *a, const dram_vector_t *b,
+                        const uint8_t scratch[DRAM_VECTOR_SCRATCH]) {
+    uint8_t c = scratch[0], co = scratch[1], nc = scratch[2], t = scratch[3];
+    uint8_t in_array = 1;
+
+    for (uint8_t k = 0; k < sum->bits && in_array; k++) {
+        uint8_t ak = a->rows[k], bk = b->rows[k];
+        // The carry rows swap after every plane, so check both ways round
+        in_array = vector_in_array(DRAM_COMPUTE_NOT, nc, c, 0, 0) && vector_in_array(DRAM_COMPUTE_NOT, nc, co, 0, 0) &&
+                   vector_in_array(DRAM_COMPUTE_MAJ, t, ak, bk, nc) && vector_in_array(DRAM_COMPUTE_MAJ, co, ak, bk, c) &&
+                   vector_in_array(DRAM_COMPUTE_MAJ, c, ak, bk, co) && vector_in_array(DRAM_COMPUTE_MAJ, sum->rows[k], nc, c, t) &&
+                   vector_in_array(DRAM_COMPUTE_MAJ, sum->rows[k], nc, co, t);
+    }
+
+    if (in_array) {
+        vector_fill_row(c, 0x0000);
+        for (uint8_t k = 0; k < sum->bits; k++) {
+            uint8_t next = co;
+            dram_row_not(nc, c);
+            dram_row_maj(t, a->rows[k], b->rows[k], nc);
+            dram_row_maj(co, a->rows[k], b->rows[k], c);
+            dram_row_not(nc, co);
+            dram_row_maj(sum->rows[k], nc, c, t);
+            co = c;
+            c = next;
+        }
+        return 1;
+    }
+
+    for (uint16_t bit = 0; bit < DRAM_ROW_BITS; bit += 16) {
+        uint16_t carry = 0;
+        for (uint8_t k = 0; k < sum->bits; k++) {
+            uint16_t ak = dram_read_fpm16(a->rows[k], DRAM_BIT_COL(bit));
+            uint16_t bk = dram_read_fpm16(b->rows[k], DRAM_BIT_COL(bit));
+            dram_write_fpm16(sum->rows[k], DRAM_BIT_COL(bit), ak ^ bk ^ carry);
+            carry = (ak & bk) | (carry & (ak ^ bk));
+        }
+    }
+    return 0;
+}
+
+// Row dst gets a 1 for every element with a < b: the borrow out of a - b,
+//   borrow' = MAJ(~a, b, borrow)
+// with ~a going through the scratch row.
+uint8_t dram_vector_lt(uint8_t dst, const dram_vector_t *a, const dram_vector_t *b, uint8_t scratch) {
+    uint8_t in_array = 1;
+
+    for (uint8_t k = 0; k < a->bits && in_array; k++) {
+        in_array = vector_in_array(DRAM_COMPUTE_NOT, scratch, a->rows[k], 0, 0) &&
+                   vector_in_array(DRAM_COMPUTE_MAJ, dst, scratch, b->rows[k], dst);
+    }
+
+    if (in_array) {
+        vector_fill_row(dst, 0x0000);
+        for (uint8_t k = 0; k < a->bits; k++) {
+            dram_row_not(scratch, a->rows[k]);
+            dram_row_maj(dst, scratch, b->rows[k], dst);
+        }
+        return 1;
+    }
+
+    for (uint16_t bit = 0; bit < DRAM_ROW_BITS; bit += 16) {
+        uint16_t borrow = 0;
+        for (uint8_t k = 0; k < a->bits; k++) {
+            uint16_t nak = ~dram_read_fpm16(a->rows[k], DRAM_BIT_COL(bit));
+            uint16_t bk = dram_read_fpm16(b->rows[k], DRAM_BIT_COL(bit));
+            borrow = (nak & bk) | (nak & borrow) | (bk & borrow);
+        }
+        dram_write_fpm16(dst, DRAM_BIT_COL(bit), borrow);
+    }
+    return 0;
+}
+
+// Row dst gets a 1 for every element >= value. From the lowest bit up, the
+// flag is a_k AND flag where value has a 1 and a_k OR flag where it has a 0;
+// the bits below the lowest 1 of value leave it at all 1s. This needs no NOT,
+// so it runs in the array wherever AND and OR do.
+uint8_t dram_vector_ge_const(uint8_t dst, const dram_vector_t *a, uint8_t value) {
+    uint8_t first = 0, in_array = 1;
+
+    if (value == 0 || (value >> a->bits)) {
+        vector_fill_row(dst, value ? 0x0000 : 0xFFFF);
+        return 0;
+    }
+    while (!((value >> first) & 1)) {
+        first++;
+    }
+
+    in_array = dram_copy_valid(a->rows[first], dst);
+    for (uint8_t k = first + 1; k < a->bits && in_array; k++) {
+        in_array = vector_in_array(((value >> k) & 1) ? DRAM_COMPUTE_AND : DRAM_COMPUTE_OR, dst, a->rows[k], dst, 0);
+    }
+
+    if (in_array) {
+        dram_copyrow(a->rows[first], dst);
+        for (uint8_t k = first + 1; k < a->bits; k++) {
+            if ((value >> k) & 1) {
+                dram_row_and(dst, a->rows[k], dst);
+            } else {
+                dram_row_or(dst, a->rows[k], dst);
+            }
+        }
+        return 1;
+    }
+
+    for (uint16_t bit = 0; bit < DRAM_ROW_BITS; bit += 16) {
+        uint16_t flag = 0xFFFF;
+        for (uint8_t k = first; k < a->bits; k++) {
+            uint16_t ak = dram_read_fpm16(a->rows[k], DRAM_BIT_COL(bit));
+            flag = ((value >> k) & 1) ? (ak & flag) : (ak | flag);
+        }
+        dram_write_fpm16(dst, DRAM_BIT_COL(bit), flag);
+    }
+    return 0;
+}
+
+uint16_t dram_row_popcount(uint8_t row) {
+    uint16_t count = 0;
+
+    for (uint16_t bit = 0; bit < DRAM_ROW_BITS; bit += 16) {
+        uint16_t plane = dram_read_fpm16(row, DRAM_BIT_COL(bit));
+        while (plane) {
+            plane &= plane - 1;
+            count++;
+        }
+    }
+    return count;
+}
+
+// Sum of all elements: the popcount of plane k weighs 2^k
+uint32_t dram_vector_sum(const dram_vector_t *a) {
+    uint32_t sum = 0;
+
+    for (uint8_t k = 0; k < a->bits; k++) {
+        sum += (uint32_t)dram_row_popcount(a->rows[k]) << k;
+    }
+    return sum;
+}
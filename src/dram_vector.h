@@ -0,0 +1,39 @@
+#ifndef DRAM_VECTOR_H
+#define DRAM_VECTOR_H
+
+#include "dram.h"
+#include "dram_compute.h"
+
+// Bit-serial arithmetic on vectors of up to 256 elements
+//
+// A vector is stored transposed: row k holds bit k of every element, element i
+// in column i. An operation on a bit-plane then touches all 256 elements at
+// once, so the kernels below walk the bits of the operands and use one row
+// operation per step. They run in the array when every step can
+// (dram_compute_in_array()), otherwise they stream all planes through the CPU
+// in 16 column FPM bursts, keeping the carries in registers.
+
+#define DRAM_VECTOR_MAX_BITS 8
+#define DRAM_VECTOR_SCRATCH  4      // scratch rows used by dram_vector_add()
+
+typedef struct {
+    uint8_t bits;
+    uint8_t rows[DRAM_VECTOR_MAX_BITS];     // rows[k] holds bit k of every element
+} dram_vector_t;
+
+// Elements first .. first + count - 1, with 'first' a multiple of 16, so that
+// callers can transpose through a small buffer. The rest of the last group
+// of 16 elements is stored as 0.
+void dram_vector_store(const dram_vector_t *v, uint16_t first, const uint8_t *values, uint16_t count);
+void dram_vector_load(const dram_vector_t *v, uint16_t first, uint8_t *values, uint16_t count);
+
+// Return 1 if the kernel ran in the array, 0 if on the CPU
+uint8_t dram_vector_add(const dram_vector_t *sum, const dram_vector_t *a, const dram_vector_t *b,
+                        const uint8_t scratch[DRAM_VECTOR_SCRATCH]);
+uint8_t dram_vector_lt(uint8_t dst, const dram_vector_t *a, const dram_vector_t *b, uint8_t scratch);
+uint8_t dram_vector_ge_const(uint8_t dst, const dram_vector_t *a, uint8_t value);
+
+uint16_t dram_row_popcount(uint8_t row);
+uint32_t dram_vector_sum(const dram_vector_t *a);
+
+#endif // DRAM_VECTOR_H
@@ -1,18 +1,42 @@
 #include "ch32fun.h"
 #include "dram.h"
+#include "dram_refresh.h"
+#include "dram_timing.h"
+#include "dram_copy.h"
+#include "dram_compute.h"
+#include "dram_vector.h"
+#include "dram_queue.h"
+#include "dram_mem.h"
+#include "dram_ecc.h"
+#include "dram_hammer.h"
+#include "dram_sweep.h"
+#include "dram_stats.h"
+#include "dram_dump.h"
+#include "dram_console.h"
+#include "dram_trace.h"
 #include <stdio.h>
 
-// Timer for DRAM refresh
-volatile uint32_t refresh_counter = 0;
+// Checks of the test sections that failed; the simulator exits non-zero when
+// there are any (make -C sim check)
+uint16_t test_failures;
+
+// Count a failed check and say which one
+static void test_check(uint8_t ok, const char *what) {
+    if (!ok) {
+        test_failures++;
+        printf("FAILED: %s\n", what);
+    }
+}
 
 // Timer interrupt handler for DRAM refresh
 void TIM1_UP_IRQHandler(void) __attribute__((interrupt));
 void TIM1_UP_IRQHandler(void) {
     // Clear the interrupt flag
     TIM1->INTFR = 0;
-    
-    // Increment counter
-    refresh_counter++;
+
+    // Refresh rows close to their deadline, unless a DRAM access is in progress
+    // (the access will run the refresh engine itself when it starts next time)
+    dram_refresh_poll();
 }
 
 // Setup timer for periodic DRAM refresh
@@ -20,15 +44,14 @@ void setup_refresh_timer(void) {
     // Enable TIM1 clock
     RCC->APB2PCENR |= RCC_APB2Periph_TIM1;
     
-    // Configure Timer 1 for periodic interrupts at ~1ms intervals
-    // System clock is 48 MHz, prescaler divides by 48000 to get 1kHz
-    // Auto-reload value of 1 gives 1ms period
-    TIM1->PSC = 48000 - 1;      // 48 MHz / 48000 = 1 KHz
-    TIM1->ATRLR = 1;           // Auto reload value
+    // Configure Timer 1 for periodic interrupts at 0.5ms intervals (one refresh sweep)
+    // System clock is 48 MHz, prescaler divides by 4800 to get 10kHz
+    // Auto-reload value of 4 gives 0.5ms period
+    TIM1->PSC = 4800 - 1;       // 48 MHz / 4800 = 10 KHz
+    TIM1->ATRLR = 5 - 1;        // Auto reload value
     
     // Enable update interrupt
-   // TIM1->DMAINTENR |= TIM_INTENA_CC1IE;
-    TIM1->DMAINTENR |= TIM_CC1IE;
+    TIM1->DMAINTENR |= TIM_UIE;
     
     // Enable TIM1 update interrupt in NVIC
     NVIC_EnableIRQ(TIM1_UP_IRQn);
@@ -39,21 +62,866 @@ void setup_refresh_timer(void) {
     printf("Refresh timer configured\n");
 }
 
-// DRAM refresh handling in main loop
-void handle_dram_refresh(void) {
-    static uint8_t current_row = 0;
-    
-    // Perform row refresh every 1ms
-    if (refresh_counter > 0) {
-        refresh_counter = 0;
-        
-        // Refresh a batch of rows (4 rows every ms = all 256 rows in ~64ms, well within 4ms per row requirement)
-        for (uint8_t i = 0; i < 4; i++) {
-            dram_refresh_row(current_row++);
+// SysTick compare interrupt: the open-page policy arms the compare for shortly
+// before an open row reaches tRAS max
+void SysTick_Handler(void) __attribute__((interrupt));
+void SysTick_Handler(void) {
+    SysTick->SR = 0;
+    dram_page_timeout();
+}
+
+void setup_page_timer(void) {
+    SysTick->SR = 0;
+    SysTick->CTLR |= SYSTICK_CTLR_STIE;
+    NVIC_EnableIRQ(SysTicK_IRQn);
+}
+
+// Average cycles per operation, printed with two decimals
+static void print_cycles_per(const char *name, uint32_t cycles, uint32_t count, const char *unit) {
+    uint32_t scaled = cycles * 100 / count;
+    printf("%-28s %6lu cycles, %3lu.%02lu cycles/%s\n", name, cycles, scaled / 100, scaled % 100, unit);
+}
+
+// Compare the flash-resident FPM loops with the unrolled SRAM kernels
+void benchmark_fpm_kernels(void) {
+    uint8_t buf[DRAM_ROW_BYTES];
+    uint32_t start, cycles;
+    uint32_t old_val, new_val;
+
+    start = SysTick->CNT;
+    old_val = dram_read_fpm(0x10, 0, 32);
+    cycles = SysTick->CNT - start;
+    print_cycles_per("dram_read_fpm(32)", cycles, 32, "bit");
+
+    start = SysTick->CNT;
+    new_val = dram_read_fpm32(0x10, 0);
+    cycles = SysTick->CNT - start;
+    print_cycles_per("dram_read_fpm32", cycles, 32, "bit");
+
+    start = SysTick->CNT;
+    dram_write_fpm(0x10, 0, 0x55aacafe, 32);
+    cycles = SysTick->CNT - start;
+    print_cycles_per("dram_write_fpm(32)", cycles, 32, "bit");
+
+    start = SysTick->CNT;
+    dram_write_fpm32(0x10, 0, 0x55aacafe);
+    cycles = SysTick->CNT - start;
+    print_cycles_per("dram_write_fpm32", cycles, 32, "bit");
+
+    start = SysTick->CNT;
+    dram_read_cols(0x10, 0, DRAM_ROW_BITS, buf);
+    cycles = SysTick->CNT - start;
+    print_cycles_per("dram_read_cols(row)", cycles, DRAM_ROW_BITS, "bit");
+
+    start = SysTick->CNT;
+    dram_read_row(0x10, buf);
+    cycles = SysTick->CNT - start;
+    print_cycles_per("dram_read_row", cycles, DRAM_ROW_BITS, "bit");
+
+    if (old_val != new_val || dram_read_fpm(0x10, 0, 32) != 0x55aacafe) {
+        printf("Kernel mismatch: %08lX %08lX\n", old_val, new_val);
+        test_check(0, "FPM kernels");
+    }
+}
+
+// Row bursts with the datasheet kernel timing and with the calibrated one
+void benchmark_timing(void) {
+    const dram_timing_t datasheet = DRAM_TIMING_DATASHEET;
+    dram_timing_t calibrated = dram_timing;
+    uint8_t buf[DRAM_ROW_BYTES];
+    uint32_t start, cycles;
+
+    for (uint8_t i = 0; i < 2; i++) {
+        dram_timing = i ? calibrated : datasheet;
+
+        start = SysTick->CNT;
+        dram_read_row(0x10, buf);
+        cycles = SysTick->CNT - start;
+        print_cycles_per(i ? "dram_read_row, calibrated" : "dram_read_row, datasheet", cycles, DRAM_ROW_BITS, "bit");
+
+        start = SysTick->CNT;
+        dram_write_row(0x10, buf);
+        cycles = SysTick->CNT - start;
+        print_cycles_per(i ? "dram_write_row, calibrated" : "dram_write_row, datasheet", cycles, DRAM_ROW_BITS, "bit");
+    }
+    dram_timing = calibrated;
+}
+
+// Bit-toggle read-modify-write over part of a row, with and without the open-page policy
+void benchmark_open_page(void) {
+    dram_page_stats_t stats;
+    uint32_t start, cycles;
+
+    for (uint8_t open_page = 0; open_page < 2; open_page++) {
+        dram_set_open_page(open_page);
+        dram_reset_page_stats();
+
+        start = SysTick->CNT;
+        for (uint8_t col = 0; col < 64; col++) {
+            uint8_t word = dram_read_bit(0x20, col);
+            dram_write_bit(0x20, col, word ^ DRAM_WORD_MASK);
+        }
+        dram_close_page();
+        cycles = SysTick->CNT - start;
+
+        dram_get_page_stats(&stats);
+        print_cycles_per(open_page ? "RMW, open page" : "RMW, closed page", cycles, 128, "access");
+        printf("  row hits %lu, misses %lu, expired %lu\n", stats.hits, stats.misses, stats.expired);
+    }
+
+    // A row left open by idle code is closed by the SysTick timeout
+    dram_read_bit(0x20, 0);
+    dram_reset_page_stats();
+    Delay_Us(20);
+    dram_read_bit(0x20, 0);
+    dram_get_page_stats(&stats);
+    printf("Idle 20 us with a row open: %s\n", stats.misses ? "closed by the timeout" : "still open, past tRAS max");
+    dram_set_open_page(0);
+
+    // Same toggle as one read-modify-write cycle per column
+    start = SysTick->CNT;
+    dram_rmw_xor(0x20, 0, 32, 0xFFFFFFFF);
+    dram_rmw_xor(0x20, DRAM_BIT_COL(32), 32, 0xFFFFFFFF);
+    cycles = SysTick->CNT - start;
+    print_cycles_per("RMW cycles (dram_rmw_xor)", cycles, 64, "bit");
+
+    // Counter kept in the array
+    dram_write_fpm(0x21, 0, 0x0000FFFE, 16);
+    for (uint8_t i = 0; i < 3; i++) {
+        dram_rmw_increment(0x21, 0, 16);
+    }
+    printf("In-array counter 0xFFFE + 3 = 0x%04lX\n", dram_read_fpm(0x21, 0, 16));
+}
+
+// Refresh work over 500 ms with one rate for all rows, then per retention bin
+void test_retention_refresh(void) {
+    dram_refresh_stats_t stats;
+    uint16_t histogram[DRAM_RETENTION_BINS] = {0};
+    uint16_t errors = 0;
+
+    dram_reset_refresh_stats();
+    Delay_Ms(500);
+    dram_get_refresh_stats(&stats);
+    printf("Uniform refresh:    %5lu refreshes in 500 ms\n", stats.refreshes);
+
+    printf("Profiling row retention...\n");
+    dram_profile_retention();
+    for (uint16_t row = 0; row < 256; row++) {
+        histogram[dram_retention_bin(row)]++;
+    }
+    for (uint8_t bin = 0; bin < DRAM_RETENTION_BINS; bin++) {
+        printf("  bin %d (refresh every %4lu ms): %3d rows\n", bin, DRAM_RETENTION_TEST_MS(bin) / 2, histogram[bin]);
+    }
+
+    for (uint16_t row = 0; row < 256; row++) {
+        dram_write_fpm(row, 0, 0xcafe ^ row, 16);
+    }
+    dram_refresh_set_multirate(1);
+    dram_reset_refresh_stats();
+    Delay_Ms(500);
+    dram_get_refresh_stats(&stats);
+    for (uint16_t row = 0; row < 256; row++) {
+        if (dram_read_fpm(row, 0, 16) != (0xcafeU ^ row)) {
+            errors++;
+        }
+    }
+    printf("Multi-rate refresh: %5lu refreshes in 500 ms, %d rows corrupted\n", stats.refreshes, errors);
+    test_check(!errors, "multi-rate refresh");
+}
+
+#ifdef DRAM_WITH_COPY
+// Characterize dram_copyrow() over all row pairs and try the copy planner
+void test_copy_map(void) {
+    static const char *const method[] = {"same", "direct", "via scratch", "FPM"};
+    uint8_t srcrows[4] = {0x00, 0x00, 0x40, 0x85};
+    uint8_t dstrows[4] = {0x01, 0x80, 0x7F, 0x13};
+    uint16_t members[DRAM_COPY_CLASSES] = {0};
+    uint16_t mismatches;
+    uint32_t start, cycles;
+    uint8_t ok;
+
+    // Characterize once and store the map; later boots only check it
+    start = SysTick->CNT;
+    if (dram_copy_load() && dram_copy_verify()) {
+        cycles = SysTick->CNT - start;
+        printf("Using stored copy map, checked in %lu ms\n", cycles / (FUNCONF_SYSTEM_CORE_CLOCK / 1000));
+    } else {
+        mismatches = dram_copy_characterize();
+        dram_copy_save();
+        cycles = SysTick->CNT - start;
+        printf("Characterized 65280 pairs in %lu ms, %d pairs off the class model\n", cycles / (FUNCONF_SYSTEM_CORE_CLOCK / 1000), mismatches);
+    }
+    ok = dram_copy_load() && dram_copy_verify();
+    printf("Re-init uses stored copy map: %s\n", ok ? "yes" : "no");
+    test_check(ok, "stored copy map");
+
+    for (uint16_t row = 0; row < 256; row++) {
+        members[dram_copy_class(row)]++;
+    }
+    for (uint8_t cls = 1; cls < DRAM_COPY_CLASSES; cls++) {
+        if (members[cls]) {
+            printf("  class %d: %3d rows\n", cls, members[cls]);
         }
     }
+    printf("  no copy: %3d rows, %d holes\n", members[DRAM_COPY_CLASS_NONE], dram_copy_hole_count);
+
+    dram_copy_set_scratch(0xFE, 1);
+    for (uint8_t i = 0; i < 4; i++) {
+        uint8_t used;
+        dram_write_fpm(srcrows[i], 0, 0x55aacafe, 32);
+        dram_write_fpm(dstrows[i], 0, 0x00ff00ff, 32);
+        start = SysTick->CNT;
+        used = dram_copy(srcrows[i], dstrows[i]);
+        cycles = SysTick->CNT - start;
+        ok = dram_read_fpm(dstrows[i], 0, 32) == 0x55aacafe;
+        printf("dram_copy(0x%02X, 0x%02X): %-11s %5lu cycles, %s\n", srcrows[i], dstrows[i], method[used], cycles,
+               ok ? "ok" : "FAILED");
+        test_failures += !ok;
+    }
 }
 
+// Pattern the whole array: FPM chunks, one write cycle per bit, copy fan-out
+void benchmark_fill(void) {
+    uint8_t pattern[DRAM_ROW_BYTES], buf[DRAM_ROW_BYTES];
+    uint32_t start, cycles;
+    uint16_t rewritten, errors = 0;
+
+    for (uint8_t i = 0; i < DRAM_ROW_BYTES; i++) {
+        pattern[i] = 0xA5 ^ (i * 0x11);
+    }
+
+    start = SysTick->CNT;
+    for (uint16_t row = 0; row < 256; row++) {
+        for (uint16_t bit = 0; bit < DRAM_ROW_BITS; bit += 32) {
+            dram_write_fpm(row, DRAM_BIT_COL(bit), 0x55aacafe, 32);
+        }
+    }
+    cycles = SysTick->CNT - start;
+    printf("dram_write_fpm(32) loop: %6lu us\n", cycles / (FUNCONF_SYSTEM_CORE_CLOCK / 1000000));
+
+    start = SysTick->CNT;
+    for (uint16_t row = 0; row < 256; row++) {
+        dram_write_page(row, 0x55aacafe);
+    }
+    cycles = SysTick->CNT - start;
+    printf("dram_write_page loop:    %6lu us\n", cycles / (FUNCONF_SYSTEM_CORE_CLOCK / 1000000));
+
+    start = SysTick->CNT;
+    rewritten = dram_fill(NULL, pattern);
+    cycles = SysTick->CNT - start;
+    printf("dram_fill:               %6lu us, %d rows rewritten\n", cycles / (FUNCONF_SYSTEM_CORE_CLOCK / 1000000), rewritten);
+
+    for (uint16_t row = 0; row < 256; row++) {
+        dram_read_row(row, buf);
+        for (uint8_t i = 0; i < DRAM_ROW_BYTES; i++) {
+            if (buf[i] != pattern[i]) {
+                errors++;
+                break;
+            }
+        }
+    }
+    printf("Rows not matching the pattern: %d\n", errors);
+    test_check(!errors, "dram_fill");
+}
+#endif
+
+#ifdef DRAM_WITH_COMPUTE
+// Run the row operations in the array and on the CPU and check them against
+// a software reference
+void test_compute(void) {
+    static const char *const names[] = {"AND", "OR", "MAJ", "NOT"};
+    uint8_t rows[2][4] = {{0x10, 0x11, 0x12, 0x13}, {0x10, 0x91, 0x12, 0x13}};
+    uint8_t in[3][DRAM_ROW_BYTES], ref[DRAM_ROW_BYTES], buf[DRAM_ROW_BYTES];
+    dram_compute_stats_t stats;
+    uint32_t start, cycles;
+    uint8_t reserved = 255;
+
+    printf("Compute units: %d\n", dram_compute_init());
+
+    for (uint8_t r = 0; r < 2; r++) {
+        const uint8_t *row = rows[r];
+        for (uint8_t op = 0; op < 4; op++) {
+            uint8_t in_array, errors = 0;
+            for (uint8_t k = 0; k < 3; k++) {
+                for (uint8_t i = 0; i < DRAM_ROW_BYTES; i++) {
+                    in[k][i] = (uint8_t)((i * 0x4D) ^ (k * 0x6B) ^ (op << 5) ^ (r + i) * (k + 1));
+                }
+                dram_write_row(row[k], in[k]);
+            }
+            for (uint8_t i = 0; i < DRAM_ROW_BYTES; i++) {
+                switch (op) {
+                case 0: ref[i] = in[0][i] & in[1][i]; break;
+                case 1: ref[i] = in[0][i] | in[1][i]; break;
+                case 2: ref[i] = (in[0][i] & in[1][i]) | (in[0][i] & in[2][i]) | (in[1][i] & in[2][i]); break;
+                default: ref[i] = ~in[0][i]; break;
+                }
+            }
+
+            start = SysTick->CNT;
+            switch (op) {
+            case 0: in_array = dram_row_and(row[3], row[0], row[1]); break;
+            case 1: in_array = dram_row_or(row[3], row[0], row[1]); break;
+            case 2: in_array = dram_row_maj(row[3], row[0], row[1], row[2]); break;
+            default: in_array = dram_row_not(row[3], row[0]); break;
+            }
+            cycles = SysTick->CNT - start;
+
+            dram_read_row(row[3], buf);
+            for (uint8_t i = 0; i < DRAM_ROW_BYTES; i++) {
+                if (buf[i] != ref[i]) {
+                    errors++;
+                }
+            }
+            printf("  %-3s rows 0x%02X,0x%02X -> 0x%02X: %-8s %5lu cycles, %s\n", names[op], row[0], row[1], row[3],
+                   in_array ? "in-array" : "CPU", cycles, errors ? "FAILED" : "ok");
+            test_failures += errors != 0;
+        }
+    }
+
+    // A reserved row may be an operand, on the CPU, but never the destination
+    while (reserved > 0 && !dram_compute_reserved(reserved)) {
+        reserved--;
+    }
+    if (dram_compute_reserved(reserved)) {
+        uint8_t refused = dram_row_and(reserved, rows[0][0], rows[0][1]);
+        uint8_t in_array = dram_row_or(rows[0][3], reserved, rows[0][0]);
+        printf("Reserved row 0x%02X: %s as destination, read on the %s\n", reserved,
+               refused == DRAM_COMPUTE_REFUSED ? "refused" : "written", in_array ? "array" : "CPU");
+        test_check(refused == DRAM_COMPUTE_REFUSED && !in_array, "reserved compute rows");
+    }
+
+    dram_get_compute_stats(&stats);
+    printf("In-array: %lu, CPU: %lu, verify failures: %lu\n", stats.in_array, stats.cpu, stats.verify_failures);
+}
+#endif
+
+#ifdef DRAM_WITH_VECTOR
+static void print_rate(const char *name, uint32_t cycles, uint32_t count, uint8_t in_array) {
+    printf("  %-22s %7lu cycles, %7lu elements/s%s\n", name, cycles, count * (FUNCONF_SYSTEM_CORE_CLOCK / 100) / cycles * 100,
+           in_array ? " (in-array)" : "");
+}
+
+// Add and compare 256 8-bit elements in bit-plane layout and in plain byte
+// layout (BYTE_ROWS rows of DRAM_ROW_BYTES elements), checking both against the CPU
+void benchmark_vector(void) {
+    const dram_vector_t a = {8, {0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27}};
+    const dram_vector_t b = {8, {0x28, 0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E, 0x2F}};
+    const dram_vector_t s = {8, {0x30, 0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37}};
+    const uint8_t scratch[DRAM_VECTOR_SCRATCH] = {0x38, 0x39, 0x3A, 0x3B};
+    const uint8_t flags = 0x3C, threshold = 100;
+    uint8_t bufa[DRAM_ROW_BYTES], bufb[DRAM_ROW_BYTES];
+    uint32_t start, cycles;
+    uint16_t errors, count, expected;
+    uint8_t in_array;
+
+#define BYTE_ROWS (256 / DRAM_ROW_BYTES)
+#define VALUE_A(i) ((uint8_t)((i) * 73 + 11))
+#define VALUE_B(i) ((uint8_t)((i) * 29 ^ 0x5A))
+
+    // Transpose through bufa, one row of bytes at a time; elements from 256 on are 0
+    cycles = 0;
+    for (uint16_t first = 0; first < DRAM_ROW_BITS; first += DRAM_ROW_BYTES) {
+        for (uint8_t i = 0; i < DRAM_ROW_BYTES; i++) {
+            bufa[i] = (first + i < 256) ? VALUE_A(first + i) : 0;
+        }
+        start = SysTick->CNT;
+        dram_vector_store(&a, first, bufa, DRAM_ROW_BYTES);
+        cycles += SysTick->CNT - start;
+        for (uint8_t i = 0; i < DRAM_ROW_BYTES; i++) {
+            bufa[i] = (first + i < 256) ? VALUE_B(first + i) : 0;
+        }
+        dram_vector_store(&b, first, bufa, DRAM_ROW_BYTES);
+    }
+    print_rate("transpose + store", cycles, 256, 0);
+    for (uint8_t r = 0; r < BYTE_ROWS; r++) {
+        for (uint8_t i = 0; i < DRAM_ROW_BYTES; i++) {
+            bufa[i] = VALUE_A(r * DRAM_ROW_BYTES + i);
+            bufb[i] = VALUE_B(r * DRAM_ROW_BYTES + i);
+        }
+        dram_write_row(0x40 + r, bufa);
+        dram_write_row(0x48 + r, bufb);
+    }
+
+    printf("a + b:\n");
+    start = SysTick->CNT;
+    for (uint8_t r = 0; r < BYTE_ROWS; r++) {
+        dram_read_row(0x40 + r, bufa);
+        dram_read_row(0x48 + r, bufb);
+        for (uint8_t i = 0; i < DRAM_ROW_BYTES; i++) {
+            bufa[i] += bufb[i];
+        }
+        dram_write_row(0x50 + r, bufa);
+    }
+    cycles = SysTick->CNT - start;
+    print_rate("byte rows", cycles, 256, 0);
+
+    start = SysTick->CNT;
+    in_array = dram_vector_add(&s, &a, &b, scratch);
+    cycles = SysTick->CNT - start;
+    print_rate("bit-planes", cycles, 256, in_array);
+
+    errors = 0;
+    for (uint16_t first = 0; first < 256; first += DRAM_ROW_BYTES) {
+        dram_vector_load(&s, first, bufa, DRAM_ROW_BYTES);
+        for (uint8_t i = 0; i < DRAM_ROW_BYTES; i++) {
+            if (bufa[i] != (uint8_t)(VALUE_A(first + i) + VALUE_B(first + i))) {
+                errors++;
+            }
+        }
+    }
+    printf("  %d elements wrong, sum of all: %lu\n", errors, dram_vector_sum(&s));
+    test_check(!errors, "dram_vector_add");
+
+    printf("count(a >= %d):\n", threshold);
+    start = SysTick->CNT;
+    count = 0;
+    for (uint8_t r = 0; r < BYTE_ROWS; r++) {
+        dram_read_row(0x40 + r, bufa);
+        for (uint8_t i = 0; i < DRAM_ROW_BYTES; i++) {
+            bufa[i] = bufa[i] >= threshold;
+            count += bufa[i];
+        }
+        dram_write_row(0x50 + r, bufa);
+    }
+    cycles = SysTick->CNT - start;
+    print_rate("byte rows", cycles, 256, 0);
+
+    start = SysTick->CNT;
+    in_array = dram_vector_ge_const(flags, &a, threshold);
+    expected = dram_row_popcount(flags);
+    cycles = SysTick->CNT - start;
+    print_rate("bit-planes", cycles, 256, in_array);
+    printf("  %d elements, byte rows %d\n", expected, count);
+    test_check(expected == count, "dram_vector_ge_const");
+
+    printf("count(a < b):\n");
+    start = SysTick->CNT;
+    count = 0;
+    for (uint8_t r = 0; r < BYTE_ROWS; r++) {
+        dram_read_row(0x40 + r, bufa);
+        dram_read_row(0x48 + r, bufb);
+        for (uint8_t i = 0; i < DRAM_ROW_BYTES; i++) {
+            bufa[i] = bufa[i] < bufb[i];
+            count += bufa[i];
+        }
+        dram_write_row(0x50 + r, bufa);
+    }
+    cycles = SysTick->CNT - start;
+    print_rate("byte rows", cycles, 256, 0);
+
+    start = SysTick->CNT;
+    in_array = dram_vector_lt(flags, &a, &b, scratch[0]);
+    expected = dram_row_popcount(flags);
+    cycles = SysTick->CNT - start;
+    print_rate("bit-planes", cycles, 256, in_array);
+    printf("  %d elements, byte rows %d\n", expected, count);
+    test_check(expected == count, "dram_vector_lt");
+
+#undef BYTE_ROWS
+#undef VALUE_A
+#undef VALUE_B
+}
+#endif
+
+#ifdef DRAM_WITH_QUEUE
+// Scattered byte writes and reads to four rows, issued one by one and
+// through the command queue
+void benchmark_queue(void) {
+    uint8_t direct[32];
+    uint32_t queued_results[32];
+    dram_page_stats_t page;
+    dram_queue_stats_t stats;
+    uint32_t start, cycles;
+    uint16_t errors = 0;
+
+    for (uint8_t queued = 0; queued < 2; queued++) {
+        dram_reset_page_stats();
+        dram_reset_queue_stats();
+        start = SysTick->CNT;
+        for (uint8_t i = 0; i < 32; i++) {
+            uint8_t row = 0x60 + (i & 3), col = DRAM_BIT_COL((i >> 2) * 8);
+            if (queued) {
+                dram_queue_write(row, col, i * 0x1D + 0x33, 8);
+            } else {
+                dram_write_fpm(row, col, i * 0x1D + 0x33, 8);
+            }
+        }
+        for (uint8_t i = 0; i < 32; i++) {
+            uint8_t row = 0x60 + (i & 3), col = DRAM_BIT_COL((i >> 2) * 8);
+            if (queued) {
+                dram_queue_read(row, col, 8, &queued_results[i]);
+            } else {
+                direct[i] = dram_read_fpm(row, col, 8);
+            }
+        }
+        if (queued) {
+            dram_queue_flush();
+        }
+        cycles = SysTick->CNT - start;
+        dram_get_page_stats(&page);
+
+        if (queued) {
+            dram_get_queue_stats(&stats);
+            print_cycles_per("Queued", cycles, 64, "op");
+            printf("  %lu ops, %lu bursts, %lu merged, %lu activations\n", stats.ops, stats.bursts, stats.merged,
+                   page.activations);
+        } else {
+            print_cycles_per("Direct", cycles, 64, "op");
+            printf("  64 ops, %lu activations\n", page.activations);
+        }
+    }
+
+    for (uint8_t i = 0; i < 32; i++) {
+        if (direct[i] != queued_results[i] || direct[i] != (uint8_t)(i * 0x1D + 0x33)) {
+            errors++;
+        }
+    }
+    printf("Read results wrong: %d\n", errors);
+    test_check(!errors, "command queue");
+}
+#endif
+
+#ifdef DRAM_WITH_MEM
+static void print_mem_stats(void) {
+    dram_mem_stats_t stats;
+
+    dram_get_mem_stats(&stats);
+    printf("  %lu row hits, %lu fills, %lu fills skipped, %lu write-backs\n", stats.hits, stats.misses, stats.skipped,
+           stats.writebacks);
+}
+
+// Log records through the row cache, read back the newest ones after a flush,
+// then hammer a small hot structure
+void test_mem(void) {
+    dram_mem_line_t cache[2];
+    dram_ring_t log;
+    uint8_t record[16], check[16];
+    uint32_t hot[8];
+    uint32_t start, cycles;
+    uint16_t errors = 0;
+
+    dram_mem_init(0xC0, 64, cache, 2);
+    printf("Storage: %lu bytes from row 0xC0 up to the compute rows, 2 rows cached\n", dram_mem_size());
+
+    dram_ring_init(&log, 0, 1024, 1);
+    dram_reset_mem_stats();
+    start = SysTick->CNT;
+    for (uint16_t i = 0; i < 256; i++) {
+        for (uint8_t j = 0; j < sizeof(record); j++) {
+            record[j] = (uint8_t)(i * 7 + j);
+        }
+        dram_ring_write(&log, record, sizeof(record));
+    }
+    dram_mem_flush();
+    cycles = SysTick->CNT - start;
+    print_cycles_per("Log, 4 KB into 1 KB", cycles, 256 * sizeof(record), "byte");
+    print_mem_stats();
+
+    // The log keeps the newest records; compare them from the array
+    dram_mem_invalidate();
+    for (uint16_t i = 256 - log.count / sizeof(record); i < 256; i++) {
+        dram_ring_read(&log, check, sizeof(check));
+        for (uint8_t j = 0; j < sizeof(check); j++) {
+            if (check[j] != (uint8_t)(i * 7 + j)) {
+                errors++;
+            }
+        }
+    }
+    printf("Log read back: %u bytes wrong, %lu left\n", errors, log.count);
+    test_check(!errors, "ring buffer");
+
+    for (uint8_t i = 0; i < 8; i++) {
+        hot[i] = 0;
+    }
+    dram_memcpy_to(0x700, hot, sizeof(hot));
+    dram_reset_mem_stats();
+    for (uint16_t i = 0; i < 256; i++) {
+        dram_memcpy_from(0x700, hot, sizeof(hot));
+        hot[i & 7] += i;
+        dram_memcpy_to(0x700, hot, sizeof(hot));
+    }
+    printf("Hot 32 byte struct, 512 copies:\n");
+    print_mem_stats();
+
+    dram_mem_flush();
+    dram_mem_invalidate();
+    dram_memcpy_from(0x700, hot, sizeof(hot));
+    errors = 0;
+    for (uint8_t i = 0; i < 8; i++) {
+        uint32_t expected = 0;
+        for (uint16_t k = i; k < 256; k += 8) {
+            expected += k;
+        }
+        errors += hot[i] != expected;
+    }
+    printf("Hot struct after flush: %u words wrong\n", errors);
+    test_check(!errors, "row cache");
+
+    dram_mem_init(0, 0, NULL, 0);   // the cache lines are on this stack
+}
+#endif
+
+#ifdef DRAM_WITH_ECC
+// Flip bits behind the ECC layer's back: one in a word of every row, two in
+// the last word of the last row. The read path corrects and counts them; the
+// scrubber then rewrites the rows during refresh.
+void test_ecc(void) {
+    uint8_t data[DRAM_ECC_ROW_BYTES], check[DRAM_ECC_ROW_BYTES];
+    uint8_t status[3] = {0, 0, 0};
+    dram_ecc_stats_t stats;
+    dram_refresh_stats_t refresh;
+    uint64_t word;
+    uint16_t errors = 0;
+
+    for (uint8_t row = 0xB0; row < 0xB8; row++) {
+        for (uint8_t i = 0; i < DRAM_ECC_ROW_BYTES; i++) {
+            data[i] = (uint8_t)(row * 13 + i * 7);
+        }
+        dram_ecc_write_row(row, data);
+        dram_write_bit(row, row & 0x3F, dram_read_bit(row, row & 0x3F) ^ 1);
+    }
+    dram_write_bit(0xB7, DRAM_BIT_COL(DRAM_ECC_ROW_BYTES * 8 - 1), dram_read_bit(0xB7, DRAM_BIT_COL(DRAM_ECC_ROW_BYTES * 8 - 1)) ^ 1);
+    dram_write_bit(0xB7, DRAM_BIT_COL(DRAM_ECC_ROW_BYTES * 8 - 9), dram_read_bit(0xB7, DRAM_BIT_COL(DRAM_ECC_ROW_BYTES * 8 - 9)) ^ 1);
+
+    dram_reset_ecc_stats();
+    for (uint8_t row = 0xB0; row < 0xB8; row++) {
+        uint8_t s = dram_ecc_read_row(row, check);
+        status[s]++;
+        for (uint8_t i = 0; i < DRAM_ECC_ROW_BYTES - (row == 0xB7 ? 8 : 0); i++) {
+            errors += check[i] != (uint8_t)(row * 13 + i * 7);
+        }
+    }
+    dram_get_ecc_stats(&stats);
+    printf("Row reads: %u clean, %u corrected, %u uncorrectable rows, %u bytes wrong\n", status[0], status[1], status[2],
+           errors);
+    printf("  %lu words, %lu corrected, %lu uncorrectable\n", stats.words, stats.corrected, stats.uncorrectable);
+    test_check(!errors && status[1] == 7 && status[2] == 1, "ECC row reads");
+    status[0] = dram_ecc_read64(0xB3, 0, &word);
+    for (uint8_t i = 0; i < 8; i++) {
+        errors += (uint8_t)(word >> (8 * i)) != (uint8_t)(0xB3 * 13 + i * 7);
+    }
+    printf("dram_ecc_read64(0xB3, 0): status %u, %s\n", status[0], errors ? "wrong" : "ok");
+    test_check(!errors && status[0] != DRAM_ECC_UNCORRECTABLE, "dram_ecc_read64");
+
+    dram_reset_ecc_stats();
+    dram_reset_refresh_stats();
+    dram_refresh_set_multirate(0);  // every row due every 4 ms
+    dram_ecc_set_scrub(0xB0, 8);
+    Delay_Ms(100);
+    dram_ecc_set_scrub(0, 0);
+    dram_refresh_set_multirate(1);
+    dram_get_ecc_stats(&stats);
+    dram_get_refresh_stats(&refresh);
+    printf("Scrubber, 100 ms: %lu of %lu refreshes scrubbed, %lu rows rewritten\n", refresh.scrubs, refresh.refreshes,
+           stats.rewritten);
+
+    dram_reset_ecc_stats();
+    for (uint8_t row = 0xB0; row < 0xB8; row++) {
+        dram_ecc_read_row(row, check);
+    }
+    dram_get_ecc_stats(&stats);
+    printf("After scrubbing: %lu corrected, %lu uncorrectable\n", stats.corrected, stats.uncorrectable);
+    test_check(!stats.corrected && stats.uncorrectable == 1, "ECC scrubber");
+}
+#endif
+
+#ifdef DRAM_WITH_SWEEP
+// Glitch every row with each fill pattern, pulse width and repetition count
+// and print the share of bits that flipped as one matrix per pattern
+void test_set_row_sweep(void) {
+    static const uint8_t patterns[] = {0x00, 0xFF, 0x55};
+    static const uint8_t widths[] = {0, 1, 4};
+    static const uint8_t reps[] = {0, 1, 2, 4, 8, 16};
+    const dram_sweep_config_t cfg = {0x00, 256, patterns, 3, widths, 3, reps, 6};
+    dram_sweep_cell_t cells[3 * 3 * 6];
+    const dram_sweep_cell_t *cell = cells;
+    uint32_t start, cycles;
+
+    start = SysTick->CNT;
+    dram_sweep_set_row(&cfg, cells);
+    cycles = SysTick->CNT - start;
+
+    printf("Bits set/cleared per mille, 256 rows, %lu ms\n", cycles / (FUNCONF_SYSTEM_CORE_CLOCK / 1000));
+    for (uint8_t p = 0; p < cfg.n_patterns; p++) {
+        printf("Pattern 0x%02X  reps", patterns[p]);
+        for (uint8_t r = 0; r < cfg.n_reps; r++) {
+            printf(" %9u", reps[r]);
+        }
+        printf("\n");
+        for (uint8_t w = 0; w < cfg.n_widths; w++) {
+            printf("  width %-3u     ", widths[w]);
+            for (uint8_t r = 0; r < cfg.n_reps; r++, cell++) {
+                char set[5] = "-", cleared[5] = "-";
+                if (cell->set != DRAM_SWEEP_NONE) {
+                    snprintf(set, sizeof(set), "%u", cell->set);
+                }
+                if (cell->cleared != DRAM_SWEEP_NONE) {
+                    snprintf(cleared, sizeof(cleared), "%u", cell->cleared);
+                }
+                printf(" %4s/%-4s", set, cleared);
+            }
+            printf("\n");
+        }
+    }
+}
+#endif
+
+#ifdef DRAM_WITH_HAMMER
+static void print_hammer(const char *name, const dram_hammer_result_t *r) {
+    printf("%s: ", name);
+    if (r->first_flip) {
+        printf("first flips after %lu activations, %u bits", r->first_flip, r->flips);
+    } else if (r->activations) {
+        printf("no flips up to %lu activations", r->activations);
+    } else {
+        printf("%u bits", r->flips);
+    }
+    printf(" (%lu us without refresh)\n", r->cycles / (FUNCONF_SYSTEM_CORE_CLOCK / 1000000));
+    for (uint8_t i = 0; i < r->logged; i++) {
+        printf("%srow 0x%02X bit %u", (i % 4) ? ", " : "  ", r->flip[i].row, r->flip[i].bit);
+        if (i % 4 == 3 || i + 1 == r->logged) {
+            printf("\n");
+        }
+    }
+}
+
+// Hammer one row and a pair of rows with the victims around them left
+// unrefreshed, then hold the same victims for as long without activations.
+// Flips in the hammer runs that the control run does not show come from
+// disturbance rather than retention.
+void test_hammer(void) {
+    dram_hammer_config_t cfg = {{0x40, 0x40}, 1, 0x38, 16, 0x55, 65536};
+    dram_hammer_result_t result;
+    uint32_t cycles;
+
+    dram_hammer(&cfg, &result);
+    print_hammer("Single-sided 0x40", &result);
+    print_cycles_per("Activation", result.cycles, result.activations, "activation");
+
+    cfg.aggressor[0] = 0x3F;
+    cfg.aggressor[1] = 0x41;
+    cfg.aggressors = 2;
+    dram_hammer(&cfg, &result);
+    print_hammer("Double-sided 0x3F/0x41", &result);
+    cycles = result.cycles;
+
+    dram_hammer_control(&cfg, cycles, &result);
+    print_hammer("Control, no activations", &result);
+}
+#endif
+
+// Calls, cycles and cost histogram of every instrumented primitive since
+// boot, then reset. Needs a build with DRAM_STATS=1.
+void print_stats(void) {
+#if DRAM_STATS_ENABLED
+    dram_stats_t stats;
+
+    dram_get_stats(&stats);
+    dram_reset_stats();
+    printf("%lu activations, %lu CAS cycles, %lu refreshes, RAS low %lu ms\n", stats.activations,
+           stats.cas_cycles, stats.refreshes, stats.ras_low / (FUNCONF_SYSTEM_CORE_CLOCK / 1000));
+    printf("%-16s %8s %10s %6s %6s  calls by cycles: <32 <128 <512 <2K <8K >=8K\n", "", "calls", "cycles", "avg",
+           "max");
+    for (uint8_t op = 0; op < DRAM_STATS_OPS; op++) {
+        const dram_stats_op_t *s = &stats.op[op];
+        printf("%-16s %8lu %10lu %6lu %6lu ", dram_stats_name(op), s->calls, s->cycles,
+               s->calls ? s->cycles / s->calls : 0, s->max);
+        for (uint8_t b = 0; b < DRAM_STATS_BUCKETS; b++) {
+            printf(" %u", s->hist[b]);
+        }
+        printf("\n");
+    }
+#else
+    printf("Built without DRAM_STATS\n");
+#endif
+}
+
+#ifdef DRAM_WITH_DUMP
+static uint32_t dump_counted;
+
+static void dump_count(uint8_t byte) {
+    (void)byte;
+    dump_counted++;
+}
+
+// Size of a full-array dump in the different encodings. Build with
+// -DDRAM_DUMP_CAPTURE to send the frames themselves to the debug output
+// (see tools/).
+void test_dump(void) {
+    uint8_t pattern[DRAM_ROW_BYTES];
+    uint32_t start, cycles, bytes;
+
+#ifdef DRAM_DUMP_CAPTURE
+    dram_dump_set_output(NULL);
+    dram_dump(0, 256, NULL);
+    printf("\r\n");
+#endif
+
+    for (uint8_t i = 0; i < DRAM_ROW_BYTES; i++) {
+        pattern[i] = (i & 1) ? 0x0F : 0xF0;
+    }
+    for (uint16_t row = 0; row < 256; row++) {
+        dram_write_row(row, pattern);
+    }
+    for (uint8_t i = 0; i < 8; i++) {
+        dram_write_bit(i * 31, i * 17, dram_read_bit(i * 31, i * 17) ^ DRAM_WORD_MASK);
+    }
+
+    printf("Text (dram_readpages_fpm):  ~%5u bytes\n", 256 * DRAM_ROW_BYTES * 3);
+    printf("Raw frames:                  %5u bytes\n", 256 * (DRAM_ROW_BYTES + DRAM_DUMP_OVERHEAD));
+    dram_dump_set_output(dump_count);
+    for (uint8_t xor_expected = 0; xor_expected < 2; xor_expected++) {
+        dump_counted = 0;
+        start = SysTick->CNT;
+        bytes = dram_dump(0, 256, xor_expected ? pattern : NULL);
+        cycles = SysTick->CNT - start;
+        printf("%-28s %5lu bytes (counted %lu), %lu us without the link\n", xor_expected ? "RLE, XOR with expected:" : "RLE:",
+               bytes, dump_counted, cycles / (FUNCONF_SYSTEM_CORE_CLOCK / 1000000));
+    }
+    dram_dump_set_output(NULL);
+}
+#endif
+
+#if DRAM_TRACE_ENABLED
+// Record the pins during the common primitives and the intentionally out of
+// spec ones. With -DDRAM_DUMP_CAPTURE the trace is sent as frames for
+// tools/dram_trace, which exports VCD and checks the timing rules.
+void test_trace(void) {
+    uint8_t open_page = dram_set_open_page(0);
+    dram_trace_event_t first, last;
+
+    dram_trace_start();
+    dram_write_bit(0xF0, 3, 1);
+    dram_read_bit(0xF0, 3);
+    dram_write_fpm(0xF0, 8, 0xA5, 8);
+    dram_read_fpm(0xF0, 8, 8);
+    dram_write_fpm16(0xF1, 0, 0x1234);
+    dram_read_fpm16(0xF1, 0);
+    dram_copyrow(0xF1, 0xF2);
+    dram_set_row(0xF3, 2);
+    dram_refresh_row(0xF3);
+    dram_trace_stop();
+    dram_set_open_page(open_page);
+
+    dram_trace_get(0, &first);
+    dram_trace_get(dram_trace_count() - 1, &last);
+    printf("%u pin changes in %lu cycles, %lu dropped\n", dram_trace_count(), last.cycle - first.cycle,
+           dram_trace_dropped());
+#ifdef DRAM_DUMP_CAPTURE
+    dram_trace_send();
+    printf("\r\n");
+#endif
+}
+#endif
+
+#ifdef DRAM_WITH_CONSOLE
+// Bytes typed into the debug link terminal. Also called from inside printf(),
+// so the console only queues them; the main loop runs the commands.
+void handle_debug_input(int numbytes, uint8_t *data) {
+    dram_console_input(data, numbytes);
+}
+#endif
+
 // Initialize system
 void system_init(void) {
     // Initialize system clock
@@ -77,6 +945,22 @@ int main(void) {
     // Initialize DRAM
     dram_init();
 
+    // Keep every row within its 4 ms refresh deadline from here on
+    dram_refresh_enable(1);
+    setup_refresh_timer();
+    setup_page_timer();
+
+    // Select the fastest kernel timing this chip passes
+    if (dram_timing_init()) {
+        printf("Using stored kernel timing");
+    } else {
+        printf("Calibrated kernel timing");
+    }
+    printf(": rcd %d, cas %d, cp %d, rp %d loops\r\n", dram_timing.rcd, dram_timing.cas, dram_timing.cp, dram_timing.rp);
+    uint8_t stored = dram_timing_init();
+    printf("Re-init uses stored timing: %s\r\n", stored ? "yes" : "no");
+    test_check(stored, "stored kernel timing");
+
     // Plot the first 16 bits of every page
     printf("Plotting first 16 bits of every page\r\n");
     dram_scan_array();
@@ -103,6 +987,12 @@ int main(void) {
         dram_readpages_fpm(0x40, 1);
     }
 
+#ifdef DRAM_WITH_SWEEP
+    printf("\n\n");
+    printf("------------------------------- Row setting sweep -----------------------------\n");
+    test_set_row_sweep();
+#endif
+
 
     printf("\n\n");
     printf("------------------------------- Test row copying ------------------------------\n");
@@ -122,10 +1012,94 @@ int main(void) {
         dram_readpages_fpm(dstrows[i], 1);
     }
     
-    printf("DRAM test completed\r\n");
+    printf("\n\n");
+    printf("------------------------------- Benchmark FPM kernels -------------------------\n");
+    benchmark_fpm_kernels();
+    benchmark_timing();
+    benchmark_open_page();
+
+    printf("\n\n");
+    printf("------------------------------- Retention-aware refresh -----------------------\n");
+    test_retention_refresh();
+
+#ifdef DRAM_WITH_COPY
+    printf("\n\n");
+    printf("------------------------------- Row copy map ----------------------------------\n");
+    test_copy_map();
+#endif
+
+#ifdef DRAM_WITH_COPY
+    printf("\n\n");
+    printf("------------------------------- Bulk fill -------------------------------------\n");
+    benchmark_fill();
+#endif
+
+#ifdef DRAM_WITH_COMPUTE
+    printf("\n\n");
+    printf("------------------------------- Bulk bitwise compute --------------------------\n");
+    test_compute();
+#endif
+
+#ifdef DRAM_WITH_VECTOR
+    printf("\n\n");
+    printf("------------------------------- Bit-serial vectors ----------------------------\n");
+    benchmark_vector();
+#endif
+
+#ifdef DRAM_WITH_QUEUE
+    printf("\n\n");
+    printf("------------------------------- Command queue ---------------------------------\n");
+    benchmark_queue();
+#endif
+
+#ifdef DRAM_WITH_MEM
+    printf("\n\n");
+    printf("------------------------------- Byte storage ----------------------------------\n");
+    test_mem();
+#endif
+
+#ifdef DRAM_WITH_ECC
+    printf("\n\n");
+    printf("------------------------------- ECC -------------------------------------------\n");
+    test_ecc();
+#endif
+
+#ifdef DRAM_WITH_HAMMER
+    printf("\n\n");
+    printf("------------------------------- Row hammer ------------------------------------\n");
+    test_hammer();
+#endif
+
+    printf("\n\n");
+    printf("------------------------------- Driver statistics -----------------------------\n");
+    print_stats();
+
+#ifdef DRAM_WITH_DUMP
+    printf("\n\n");
+    printf("------------------------------- Binary dump -----------------------------------\n");
+    test_dump();
+#endif
+
+#if DRAM_TRACE_ENABLED
+    printf("\n\n");
+    printf("------------------------------- GPIO trace ------------------------------------\n");
+    test_trace();
+#endif
+
+    dram_refresh_stats_t refresh_stats;
+    dram_get_refresh_stats(&refresh_stats);
+    printf("Refresh engine: %lu refreshes, %lu deadline misses\r\n", refresh_stats.refreshes, refresh_stats.misses);
+    test_check(!refresh_stats.misses, "refresh deadlines");
+
+    printf("DRAM test completed, %u checks failed\r\n", test_failures);
     
+    // Take commands from the debug link (src/dram_console.h)
     while(1) {
-        Delay_Ms(100);
+        poll_input();
+#ifdef DRAM_WITH_CONSOLE
+        dram_console_poll();
+#endif
+        Delay_Ms(1);
     }
     
     return 0;
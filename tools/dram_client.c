@@ -0,0 +1,443 @@
+// Host side of the command console (src/dram_console.c)
+//
+//   dram_client [-c transport] [-l] [-o capture.bin] [-v] [-f script] [command ...]
+//
+// Commands come from the arguments, a script file (-f) or stdin, one line at
+// a time; a line may hold several commands separated by ';' and is sent in
+// one go. "{a..b}" in a line repeats the line for every value from a to b, so
+//
+//   dram_client 'write 0 0 0x55aacafe 32; setrow 0 {0..8}; read 0 0 32'
+//
+// sweeps the glitch repetitions in nine round trips. Replies are printed as
+// text, scan results as a grid like dram_scan_array().
+//
+// The transport is a shell command whose stdin/stdout reach the device
+// (default "minichlink -T"). -l uses a built-in loopback device instead, a
+// plain memory that answers every command, for testing without hardware;
+//
+//   dram_client -c 'SIM_CONSOLE=1 ../sim/dram_sim' ...
+//
+// talks to the simulator. -o keeps every received byte, so the frames of a
+// "dump" command can be decoded with dram_dump_decode. -v shows device text.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "../src/dram_dump.h"
+#include "../src/dram_console.h"
+
+#define LINE_MAX_LEN 1024
+
+static int dev_in = -1, dev_out = -1;      // to and from the device
+static FILE *capture;
+static int verbose;
+
+// ---------------------------------------------------------------------------
+// Frames
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    uint8_t type;
+    uint8_t row;
+    uint8_t len;
+    uint8_t payload[255];
+} frame_t;
+
+static uint8_t rx[4096];
+static size_t rx_len;
+
+static int rx_fill(void) {
+    ssize_t n = read(dev_out, rx + rx_len, sizeof(rx) - rx_len);
+
+    if (n <= 0) {
+        return -1;
+    }
+    if (capture) {
+        fwrite(rx + rx_len, 1, n, capture);
+    }
+    rx_len += n;
+    return 0;
+}
+
+static void rx_drop(size_t n) {
+    memmove(rx, rx + n, rx_len - n);
+    rx_len -= n;
+}
+
+// Next frame with a good CRC; bytes in between are device text
+static int read_frame(frame_t *f) {
+    for (;;) {
+        size_t at = 0;
+        while (at < rx_len) {
+            uint16_t crc = 0xFFFF;
+            size_t len;
+            if (rx[at] != DRAM_DUMP_SYNC0 || (at + 1 < rx_len && rx[at + 1] != DRAM_DUMP_SYNC1)) {
+                if (verbose) {
+                    fputc(rx[at], stderr);
+                }
+                at++;
+                continue;
+            }
+            if (at + 5 > rx_len || at + DRAM_DUMP_OVERHEAD + rx[at + 4] > rx_len) {
+                break; // incomplete, wait for more
+            }
+            len = rx[at + 4];
+            for (size_t i = at + 2; i < at + 5 + len; i++) {
+                crc = dram_dump_crc16(crc, rx[i]);
+            }
+            if (rx[at + 5 + len] != (crc & 0xFF) || rx[at + 6 + len] != (crc >> 8)) {
+                at++;
+                continue;
+            }
+            f->type = rx[at + 2];
+            f->row = rx[at + 3];
+            f->len = len;
+            memcpy(f->payload, rx + at + 5, len);
+            rx_drop(at + DRAM_DUMP_OVERHEAD + len);
+            return 0;
+        }
+        rx_drop(at);
+        if (rx_len == sizeof(rx)) {
+            rx_drop(1);
+        }
+        if (rx_fill() < 0) {
+            return -1;
+        }
+    }
+}
+
+static void write_frame(int fd, uint8_t type, uint8_t row, const uint8_t *payload, uint8_t len) {
+    uint8_t buf[DRAM_DUMP_OVERHEAD + 255];
+    uint16_t crc = 0xFFFF;
+
+    buf[0] = DRAM_DUMP_SYNC0;
+    buf[1] = DRAM_DUMP_SYNC1;
+    buf[2] = type;
+    buf[3] = row;
+    buf[4] = len;
+    memcpy(buf + 5, payload, len);
+    for (int i = 2; i < 5 + len; i++) {
+        crc = dram_dump_crc16(crc, buf[i]);
+    }
+    buf[5 + len] = crc & 0xFF;
+    buf[6 + len] = crc >> 8;
+    if (write(fd, buf, DRAM_DUMP_OVERHEAD + len) < 0) {
+        exit(1);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Loopback device: the console commands on a plain 256x256 bit memory
+// ---------------------------------------------------------------------------
+
+static uint8_t loop_mem[256][32];
+
+static int loop_bit(int row, int col) {
+    return (loop_mem[row & 255][(col & 255) >> 3] >> (col & 7)) & 1;
+}
+
+static void loop_set(int row, int col, int bit) {
+    uint8_t *b = &loop_mem[row & 255][(col & 255) >> 3];
+    *b = (*b & ~(1 << (col & 7))) | (bit << (col & 7));
+}
+
+static uint8_t loop_execute(int fd, char *cmd, uint8_t *result, uint8_t *result_len) {
+    static uint8_t timing[4] = {1, 2, 1, 2};
+    char *argv[8];
+    long arg[7];
+    int argc = 0, n;
+
+    for (char *tok = strtok(cmd, " \t"); tok && argc < 8; tok = strtok(NULL, " \t")) {
+        argv[argc++] = tok;
+    }
+    if (!argc) {
+        return 0xFF;
+    }
+    n = argc - 1;
+    for (int i = 0; i < n; i++) {
+        char *end;
+        arg[i] = strtol(argv[1 + i], &end, 0);
+        if (*end) {
+            return DRAM_CONSOLE_BAD_ARGS;
+        }
+    }
+
+    if (!strcmp(argv[0], "read") && n == 3) {
+        uint32_t value = 0;
+        for (int i = 0; i < arg[2]; i++) {
+            value |= (uint32_t)loop_bit(arg[0], arg[1] + i) << i;
+        }
+        memcpy(result, &value, 4);
+        *result_len = 4;
+    } else if (!strcmp(argv[0], "write") && n == 4) {
+        for (int i = 0; i < arg[3]; i++) {
+            loop_set(arg[0], arg[1] + i, (arg[2] >> i) & 1);
+        }
+    } else if (!strcmp(argv[0], "fill") && (n == 1 || n == 2)) {
+        for (int row = 0; row < 256; row++) {
+            if (n == 1 || row == arg[1]) {
+                memset(loop_mem[row], arg[0], 32);
+            }
+        }
+    } else if (!strcmp(argv[0], "copy") && n == 2) {
+        memcpy(loop_mem[arg[1] & 255], loop_mem[arg[0] & 255], 32);
+    } else if (!strcmp(argv[0], "setrow") && n == 2) {
+        // no glitch model: the row keeps its data
+    } else if (!strcmp(argv[0], "scan") && n == 0) {
+        for (int chunk = 0; chunk < 4; chunk++) {
+            uint8_t buf[128];
+            for (int i = 0; i < 64; i++) {
+                buf[2 * i] = loop_mem[chunk * 64 + i][0];
+                buf[2 * i + 1] = loop_mem[chunk * 64 + i][1];
+            }
+            write_frame(fd, DRAM_DUMP_DATA, chunk, buf, sizeof(buf));
+        }
+    } else if ((!strcmp(argv[0], "refresh-off") || !strcmp(argv[0], "refresh-on")) && n == 0) {
+    } else if (!strcmp(argv[0], "timing") && (n == 0 || n == 4)) {
+        for (int i = 0; i < n; i++) {
+            timing[i] = arg[i];
+        }
+        memcpy(result, timing, 4);
+        *result_len = 4;
+    } else if (!strcmp(argv[0], "dump") && n <= 1) {
+        uint8_t header[2 + 32] = {0, 1};
+        memset(header + 2, n ? arg[0] : 0, 32);
+        write_frame(fd, DRAM_DUMP_HEADER, 0, header, n ? sizeof(header) : 2);
+        for (int row = 0; row < 256; row++) {
+            uint8_t buf[32];
+            for (int i = 0; i < 32; i++) {
+                buf[i] = loop_mem[row][i] ^ (n ? arg[0] : 0);
+            }
+            write_frame(fd, DRAM_DUMP_RAW | (n ? DRAM_DUMP_XOR : 0), row, buf, 32);
+        }
+        write_frame(fd, DRAM_DUMP_END, 0, header, 2);
+    } else if (!strcmp(argv[0], "delay") && n == 1) {
+    } else if (!strcmp(argv[0], "read") || !strcmp(argv[0], "write") || !strcmp(argv[0], "fill") ||
+               !strcmp(argv[0], "copy") || !strcmp(argv[0], "setrow") || !strcmp(argv[0], "scan") ||
+               !strcmp(argv[0], "timing") || !strcmp(argv[0], "dump") || !strcmp(argv[0], "delay")) {
+        return DRAM_CONSOLE_BAD_ARGS;
+    } else {
+        return DRAM_CONSOLE_UNKNOWN;
+    }
+    return DRAM_CONSOLE_OK;
+}
+
+static void loop_device(int in, int out) {
+    char line[LINE_MAX_LEN];
+    size_t len = 0;
+    uint8_t number = 0;
+    char c;
+
+    while (read(in, &c, 1) == 1) {
+        if (c != '\n' && c != '\r' && c != ';') {
+            if (len < sizeof(line) - 1) {
+                line[len++] = c;
+            }
+            continue;
+        }
+        line[len] = 0;
+        len = 0;
+        uint8_t reply[5] = {0}, result_len = 0;
+        reply[0] = loop_execute(out, line, reply + 1, &result_len);
+        if (reply[0] != 0xFF) {
+            write_frame(out, DRAM_DUMP_REPLY, number++, reply, 1 + result_len);
+        }
+    }
+    exit(0);
+}
+
+// ---------------------------------------------------------------------------
+// Client
+// ---------------------------------------------------------------------------
+
+static pid_t start_device(const char *transport) {
+    int to_dev[2], from_dev[2];
+    pid_t pid;
+
+    if (pipe(to_dev) < 0 || pipe(from_dev) < 0 || (pid = fork()) < 0) {
+        perror("dram_client");
+        exit(1);
+    }
+    if (pid == 0) {
+        close(to_dev[1]);
+        close(from_dev[0]);
+        if (!transport) {
+            loop_device(to_dev[0], from_dev[1]);
+        }
+        dup2(to_dev[0], 0);
+        dup2(from_dev[1], 1);
+        execl("/bin/sh", "sh", "-c", transport, (char *)NULL);
+        _exit(127);
+    }
+    close(to_dev[0]);
+    close(from_dev[1]);
+    dev_in = to_dev[1];
+    dev_out = from_dev[0];
+    return pid;
+}
+
+static const char *status_text(uint8_t status) {
+    switch (status) {
+    case DRAM_CONSOLE_OK:       return "ok";
+    case DRAM_CONSOLE_UNKNOWN:  return "unknown command";
+    case DRAM_CONSOLE_BAD_ARGS: return "bad arguments";
+    case DRAM_CONSOLE_TOO_LONG: return "too long";
+    default:                    return "?";
+    }
+}
+
+// Send one line and print the reply of every command in it
+static int run_line(const char *line) {
+    char copy[LINE_MAX_LEN], *cmds[64];
+    int count = 0, errors = 0, dump_rows = 0;
+    uint8_t scan[512];
+
+    snprintf(copy, sizeof(copy), "%s", line);
+    for (char *c = strtok(copy, ";\n"); c && count < 64; c = strtok(NULL, ";\n")) {
+        while (*c == ' ' || *c == '\t') {
+            c++;
+        }
+        if (*c) {
+            cmds[count++] = c;
+        }
+    }
+    if (!count) {
+        return 0;
+    }
+    if (write(dev_in, line, strlen(line)) < 0 || write(dev_in, "\n", 1) < 0) {
+        return -1;
+    }
+
+    for (int i = 0; i < count;) {
+        frame_t f;
+        if (read_frame(&f) < 0) {
+            fprintf(stderr, "device closed the link\n");
+            return -1;
+        }
+        if (f.type == DRAM_DUMP_DATA && f.row < 4 && f.len == 128) {
+            memcpy(scan + f.row * 128, f.payload, 128);
+            continue;
+        }
+        if (f.type == DRAM_DUMP_HEADER) {
+            dump_rows = 0;
+        } else if ((f.type & ~DRAM_DUMP_XOR) == DRAM_DUMP_RAW || (f.type & ~DRAM_DUMP_XOR) == DRAM_DUMP_RLE) {
+            dump_rows++;
+        }
+        if (f.type != DRAM_DUMP_REPLY || !f.len) {
+            continue;
+        }
+
+        printf("%-32s %s", cmds[i], status_text(f.payload[0]));
+        if (f.payload[0] != DRAM_CONSOLE_OK) {
+            errors++;
+        } else if (!strncmp(cmds[i], "read", 4) && f.len == 5) {
+            printf(" 0x%08X", f.payload[1] | f.payload[2] << 8 | f.payload[3] << 16 | (uint32_t)f.payload[4] << 24);
+        } else if (!strncmp(cmds[i], "timing", 6) && f.len == 5) {
+            printf(" rcd %d, cas %d, cp %d, rp %d", f.payload[1], f.payload[2], f.payload[3], f.payload[4]);
+        } else if (!strncmp(cmds[i], "dump", 4)) {
+            printf(", %d rows%s", dump_rows, capture ? "" : " (use -o to keep them)");
+        } else if (!strncmp(cmds[i], "scan", 4)) {
+            printf("\n    ");
+            for (int col = 0; col < 16; col++) {
+                printf("  %X  ", col);
+            }
+            for (int row = 0; row < 256; row++) {
+                if (!(row & 15)) {
+                    printf("\n%X0: ", row >> 4);
+                }
+                printf("%02X%02X ", scan[2 * row + 1], scan[2 * row]);
+            }
+        }
+        printf("\n");
+        i++;
+    }
+    fflush(stdout);
+    return errors;
+}
+
+// Expand the first "{a..b}" and run every resulting line
+static int run_expanded(const char *line) {
+    const char *open = strchr(line, '{'), *close;
+    long from, to;
+    int errors = 0;
+
+    if (!open || !(close = strchr(open, '}')) || sscanf(open, "{%ld..%ld}", &from, &to) != 2) {
+        return run_line(line);
+    }
+    for (long v = from; from <= to ? v <= to : v >= to; v += from <= to ? 1 : -1) {
+        char expanded[LINE_MAX_LEN];
+        snprintf(expanded, sizeof(expanded), "%.*s%ld%s", (int)(open - line), line, v, close + 1);
+        int r = run_expanded(expanded);
+        if (r < 0) {
+            return r;
+        }
+        errors += r;
+    }
+    return errors;
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: dram_client [-c transport] [-l] [-o capture.bin] [-v] [-f script] [command ...]\n");
+    exit(2);
+}
+
+int main(int argc, char **argv) {
+    const char *transport = "minichlink -T", *script = NULL;
+    char line[LINE_MAX_LEN];
+    int opt, errors = 0, r = 0, status;
+    FILE *in = NULL;
+    pid_t pid;
+
+    while ((opt = getopt(argc, argv, "c:lo:vf:")) != -1) {
+        switch (opt) {
+        case 'c': transport = optarg; break;
+        case 'l': transport = NULL; break;
+        case 'o':
+            capture = fopen(optarg, "wb");
+            if (!capture) {
+                perror(optarg);
+                return 1;
+            }
+            break;
+        case 'v': verbose = 1; break;
+        case 'f': script = optarg; break;
+        default: usage();
+        }
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    pid = start_device(transport);
+
+    if (optind < argc) {
+        for (int i = optind; i < argc && r >= 0; i++) {
+            errors += r = run_expanded(argv[i]);
+        }
+    } else {
+        in = script ? fopen(script, "r") : stdin;
+        if (!in) {
+            perror(script);
+            return 1;
+        }
+        while (r >= 0 && fgets(line, sizeof(line), in)) {
+            line[strcspn(line, "\r\n")] = 0;
+            if (line[0] != '#') {
+                errors += r = run_expanded(line);
+            }
+        }
+    }
+
+    close(dev_in);
+    if (transport) {
+        kill(pid, SIGTERM);
+    }
+    waitpid(pid, &status, 0);
+    if (capture) {
+        fclose(capture);
+    }
+    return r < 0 ? 1 : errors ? 3 : 0;
+}
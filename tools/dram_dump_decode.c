@@ -0,0 +1,284 @@
+// Decode binary array dumps (src/dram_dump.c) from a recorded debug output
+// stream and write the array as a PNG or PBM image, one pixel per cell, row 0
+// at the top and column 0 on the left.
+//
+//   dram_dump_decode [-n index] [-x] capture.bin out.png|out.pbm
+//
+// -n picks a dump when the capture holds several (default: the last complete
+// one), -x draws the XOR with the expected row instead of the data. Rows that
+// are missing or failed their CRC are drawn grey in PNG output.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/dram_dump.h"
+
+#define ROWS 256
+#define COLS (DRAM_DUMP_ROW_BYTES * 8)  // data bits per row, wider with -DDRAM_CHIPS
+
+typedef struct {
+    uint8_t data[ROWS][DRAM_DUMP_ROW_BYTES];
+    uint8_t xored[ROWS][DRAM_DUMP_ROW_BYTES];
+    uint8_t valid[ROWS];
+    uint8_t expected[DRAM_DUMP_ROW_BYTES];
+    int has_expected;
+    int rows;
+} dump_t;
+
+static int decode_row(const uint8_t *payload, int len, int rle, uint8_t out[DRAM_DUMP_ROW_BYTES]) {
+    int pos = 0;
+
+    if (!rle) {
+        if (len != DRAM_DUMP_ROW_BYTES) {
+            return -1;
+        }
+        memcpy(out, payload, DRAM_DUMP_ROW_BYTES);
+        return 0;
+    }
+    for (int i = 0; i + 1 < len; i += 2) {
+        if (pos + payload[i] > DRAM_DUMP_ROW_BYTES) {
+            return -1;
+        }
+        memset(out + pos, payload[i + 1], payload[i]);
+        pos += payload[i];
+    }
+    return (pos == DRAM_DUMP_ROW_BYTES && !(len & 1)) ? 0 : -1;
+}
+
+// 1 if a complete frame with a good CRC starts at buf[at]
+static int frame_ok(const uint8_t *buf, size_t size, size_t at) {
+    uint16_t crc = 0xFFFF;
+    size_t len;
+
+    if (at + 5 > size) {
+        return 0;
+    }
+    len = buf[at + 4];
+    if (at + DRAM_DUMP_OVERHEAD + len > size) {
+        return 0;
+    }
+    for (size_t i = at + 2; i < at + 5 + len; i++) {
+        crc = dram_dump_crc16(crc, buf[i]);
+    }
+    return buf[at + 5 + len] == (crc & 0xFF) && buf[at + 6 + len] == (crc >> 8);
+}
+
+static void write_u32be(FILE *f, uint32_t v) {
+    fputc(v >> 24, f);
+    fputc(v >> 16, f);
+    fputc(v >> 8, f);
+    fputc(v, f);
+}
+
+static uint32_t crc32_update(uint32_t crc, const uint8_t *p, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        crc ^= p[i];
+        for (int k = 0; k < 8; k++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return crc;
+}
+
+static void png_chunk(FILE *f, const char *type, const uint8_t *data, uint32_t len) {
+    uint32_t crc = crc32_update(0xFFFFFFFF, (const uint8_t *)type, 4);
+
+    crc = crc32_update(crc, data, len);
+    write_u32be(f, len);
+    fwrite(type, 1, 4, f);
+    fwrite(data, 1, len, f);
+    write_u32be(f, ~crc);
+}
+
+// 8-bit greyscale PNG, zlib stream made of stored (uncompressed) blocks
+static int write_png(const char *path, const uint8_t *pixels, int width, int height) {
+    size_t raw_len = (size_t)(width + 1) * height;
+    size_t blocks = (raw_len + 65534) / 65535;
+    size_t z_len = 2 + raw_len + 5 * blocks + 4;
+    uint8_t *raw = malloc(raw_len), *z = malloc(z_len);
+    uint8_t ihdr[13] = {0, 0, width >> 8, width & 0xFF, 0, 0, height >> 8, height & 0xFF, 8, 0, 0, 0, 0};
+    uint32_t a = 1, b = 0;
+    size_t zp = 0;
+    FILE *f = fopen(path, "wb");
+
+    if (!f || !raw || !z) {
+        free(raw);
+        free(z);
+        if (f) {
+            fclose(f);
+        }
+        return -1;
+    }
+    for (int y = 0; y < height; y++) {
+        raw[y * (width + 1)] = 0; // filter: none
+        memcpy(raw + y * (width + 1) + 1, pixels + y * width, width);
+    }
+    z[zp++] = 0x78;
+    z[zp++] = 0x01;
+    for (size_t off = 0; off < raw_len; off += 65535) {
+        size_t n = raw_len - off < 65535 ? raw_len - off : 65535;
+        z[zp++] = off + n == raw_len;
+        z[zp++] = n & 0xFF;
+        z[zp++] = n >> 8;
+        z[zp++] = ~n & 0xFF;
+        z[zp++] = (~n >> 8) & 0xFF;
+        memcpy(z + zp, raw + off, n);
+        zp += n;
+    }
+    for (size_t i = 0; i < raw_len; i++) {
+        a = (a + raw[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    z[zp++] = b >> 8;
+    z[zp++] = b;
+    z[zp++] = a >> 8;
+    z[zp++] = a;
+
+    fwrite("\x89PNG\r\n\x1a\n", 1, 8, f);
+    png_chunk(f, "IHDR", ihdr, sizeof(ihdr));
+    png_chunk(f, "IDAT", z, zp);
+    png_chunk(f, "IEND", NULL, 0);
+    free(raw);
+    free(z);
+    return fclose(f);
+}
+
+static int write_pbm(const char *path, const uint8_t *pixels, int width, int height) {
+    FILE *f = fopen(path, "wb");
+
+    if (!f) {
+        return -1;
+    }
+    fprintf(f, "P4\n%d %d\n", width, height);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x += 8) {
+            uint8_t byte = 0;
+            for (int k = 0; k < 8; k++) {
+                byte |= (pixels[y * width + x + k] == 0) << (7 - k); // PBM: 1 = black
+            }
+            fputc(byte, f);
+        }
+    }
+    return fclose(f);
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: dram_dump_decode [-n index] [-x] capture.bin out.png|out.pbm\n");
+    exit(2);
+}
+
+int main(int argc, char **argv) {
+    static dump_t current, chosen;
+    static uint8_t pixels[ROWS * COLS];
+    const char *in_path = NULL, *out_path = NULL;
+    int wanted = -1, show_xor = 0, in_dump = 0, dumps = 0, found = 0;
+    long frames = 0, bad_frames = 0, text_bytes = 0;
+    uint8_t *buf;
+    size_t size;
+    FILE *f;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+            wanted = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-x")) {
+            show_xor = 1;
+        } else if (!in_path) {
+            in_path = argv[i];
+        } else if (!out_path) {
+            out_path = argv[i];
+        } else {
+            usage();
+        }
+    }
+    if (!in_path || !out_path) {
+        usage();
+    }
+
+    f = fopen(in_path, "rb");
+    if (!f) {
+        perror(in_path);
+        return 1;
+    }
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    buf = malloc(size ? size : 1);
+    if (fread(buf, 1, size, f) != size) {
+        perror(in_path);
+        return 1;
+    }
+    fclose(f);
+
+    for (size_t at = 0; at < size;) {
+        uint8_t type, row, len;
+        const uint8_t *payload;
+
+        if (buf[at] != DRAM_DUMP_SYNC0 || at + 1 >= size || buf[at + 1] != DRAM_DUMP_SYNC1 || !frame_ok(buf, size, at)) {
+            // Printf text, or a frame with a bad CRC
+            if (in_dump && buf[at] == DRAM_DUMP_SYNC0 && at + 1 < size && buf[at + 1] == DRAM_DUMP_SYNC1) {
+                bad_frames++;
+            }
+            text_bytes++;
+            at++;
+            continue;
+        }
+        type = buf[at + 2];
+        row = buf[at + 3];
+        len = buf[at + 4];
+        payload = buf + at + 5;
+        at += DRAM_DUMP_OVERHEAD + len;
+        frames++;
+
+        if (type == DRAM_DUMP_HEADER && len >= 2) {
+            memset(&current, 0, sizeof(current));
+            current.rows = payload[0] | (payload[1] << 8);
+            current.has_expected = len >= 2 + DRAM_DUMP_ROW_BYTES;
+            if (current.has_expected) {
+                memcpy(current.expected, payload + 2, DRAM_DUMP_ROW_BYTES);
+            }
+            in_dump = 1;
+        } else if (type == DRAM_DUMP_END && in_dump) {
+            if (wanted < 0 || wanted == dumps) {
+                chosen = current;
+                found = 1;
+            }
+            dumps++;
+            in_dump = 0;
+        } else if (in_dump && (type & ~DRAM_DUMP_XOR) >= DRAM_DUMP_RAW && (type & ~DRAM_DUMP_XOR) <= DRAM_DUMP_RLE) {
+            uint8_t decoded[DRAM_DUMP_ROW_BYTES];
+            if (decode_row(payload, len, (type & ~DRAM_DUMP_XOR) == DRAM_DUMP_RLE, decoded) < 0) {
+                bad_frames++;
+                continue;
+            }
+            for (int i = 0; i < DRAM_DUMP_ROW_BYTES; i++) {
+                uint8_t expected = (type & DRAM_DUMP_XOR) ? current.expected[i] : 0;
+                current.data[row][i] = decoded[i] ^ expected;
+                current.xored[row][i] = current.has_expected ? current.data[row][i] ^ current.expected[i] : current.data[row][i];
+            }
+            current.valid[row] = 1;
+        }
+    }
+    free(buf);
+
+    fprintf(stderr, "%ld frames, %ld bad, %d complete dumps, %ld bytes of text\n", frames, bad_frames, dumps, text_bytes);
+    if (!found) {
+        fprintf(stderr, "no complete dump%s found\n", wanted >= 0 ? " with that index" : "");
+        return 1;
+    }
+
+    for (int row = 0; row < ROWS; row++) {
+        for (int col = 0; col < COLS; col++) {
+            const uint8_t *bytes = show_xor ? chosen.xored[row] : chosen.data[row];
+            pixels[row * COLS + col] = !chosen.valid[row] ? 0x80 : ((bytes[col >> 3] >> (col & 7)) & 1) ? 0xFF : 0x00;
+        }
+    }
+
+    size_t n = strlen(out_path);
+    if ((n > 4 && !strcmp(out_path + n - 4, ".pbm") ? write_pbm(out_path, pixels, COLS, ROWS)
+                                                     : write_png(out_path, pixels, COLS, ROWS)) != 0) {
+        perror(out_path);
+        return 1;
+    }
+    return 0;
+}
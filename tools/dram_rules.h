@@ -0,0 +1,77 @@
+#ifndef DRAM_RULES_H
+#define DRAM_RULES_H
+
+// Pins and timing rules shared by dram_timing_model and dram_trace
+//
+// The pin masks and ports come from the firmware's board description, so the
+// tools decode the wiring it was built for (build them with the same
+// -DDRAM_BOARD / -DDRAM_CHIPS). With several chips DIN is chip 0's I/O pin.
+
+#include <stdio.h>
+#include <string.h>
+#include "../src/dram_board.h"
+
+#define PIN_CAS (1 << DRAM_CAS_BIT)
+#define PIN_RAS (1 << DRAM_RAS_BIT)
+#define PIN_WR  (1 << DRAM_WR_BIT)
+#if DRAM_CHIPS == 1
+#define PIN_DIN (1 << DRAM_DIN_BIT)
+#else
+#define PIN_DIN (1 << DRAM_DQ0_BIT)
+#endif
+
+#define GPIO_BASE_A 0x40010800
+#define GPIO_BASE_C 0x40011000
+#define GPIO_BASE_D 0x40011400
+#define GPIO_END    (GPIO_BASE_D + 0x400)
+#define GPIO_BASE_(port) GPIO_BASE_##port
+#define GPIO_BASE(port)  GPIO_BASE_(port)
+#define GPIO_NAME_(port) #port
+#define GPIO_NAME(port)  GPIO_NAME_(port)
+
+#define ADDR_GPIO_BASE GPIO_BASE(DRAM_ADDR_GPIO)
+#define CTRL_GPIO_BASE GPIO_BASE(DRAM_CTRL_GPIO)
+
+// Default limits in cycles at 48 MHz, the datasheet values of a 150 ns part
+// (about 25 ns, 75 ns, 100 ns, 10 us and 50 ns); both tools take -t to
+// override them. The firmware's DELAY_*_CYCLES() in dram.c are at or above
+// the minimums, so a shorter interval means the code around them changed.
+#define DRAM_RULE_RCD     2     // RAS low to the first CAS low, minimum
+#define DRAM_RULE_CAS     4     // CAS low to CAS high, minimum
+#define DRAM_RULE_RP      5     // RAS high to RAS low, minimum
+#define DRAM_RULE_RAS_MAX 480   // RAS low to RAS high, maximum
+#define DRAM_RULE_WR      3     // last write to RAS high, minimum
+
+// Code that breaks the rules on purpose, as the trace tags of src/dram_trace.h.
+// dram_trace reads the tag of every event; dram_timing_model has no tags and
+// matches the modelled function and the one making the store by name prefix.
+// By default an interval that starts or ends in any of them is allowed.
+static const char *const dram_rule_tags[] = {"none", "copyrow", "set_row", "triple", "timing"};
+static const char *const dram_rule_tag_funcs[] = {"", "dram_copyrow", "dram_set_row", "dram_activate_triple",
+                                                  "dram_timing_"};
+#define DRAM_RULE_TAGS (sizeof(dram_rule_tags) / sizeof(dram_rule_tags[0]))
+#define DRAM_RULE_ALLOW_DEFAULT {0, 1, 1, 1, 1}
+
+// Parse the -a list ("copyrow,timing", or "none") into allow[DRAM_RULE_TAGS]
+static int dram_rule_parse_allow(const char *list, int *allow) {
+    char copy[128];
+
+    memset(allow, 0, DRAM_RULE_TAGS * sizeof(*allow));
+    if (!strcmp(list, "none")) {
+        return 0;
+    }
+    snprintf(copy, sizeof(copy), "%s", list);
+    for (char *name = strtok(copy, ","); name; name = strtok(0, ",")) {
+        size_t t;
+        for (t = 1; t < DRAM_RULE_TAGS && strcmp(name, dram_rule_tags[t]); t++) {
+        }
+        if (t == DRAM_RULE_TAGS) {
+            fprintf(stderr, "unknown tag %s\n", name);
+            return -1;
+        }
+        allow[t] = 1;
+    }
+    return 0;
+}
+
+#endif // DRAM_RULES_H
@@ -0,0 +1,831 @@
+// Static timing model of the DRAM kernels (src/dram.c)
+//
+//   dram_timing_model [-t rcd,cas,rp] [-a tags] [-v] main.dis [function [arg ...]]
+//
+// Reads the disassembly of the firmware ("objdump -d -s main.elf", the -s
+// part supplies the initial contents of .data), runs a function on a small
+// RV32EC interpreter and prints the predicted cycle time of every GPIO store
+// it makes. Without a function, dram_read_fpm(0x55, 0, 8),
+// dram_write_fpm(0x55, 0, 0xA5, 8) and dram_copyrow(1, 2) are run.
+//
+// The cycle costs are the rules measured in instruction_timing/:
+//   - every instruction takes 1 cycle, loads and stores take 2 (the bus is
+//     shared between SRAM and GPIO, nothing is hidden)
+//   - a taken branch or jump flushes the pipeline: 2 more cycles
+//   - code in flash is fetched in 32 bit words that take 2 cycles each, and
+//     after a taken branch the fetch restarts on the 2 cycle grid of the
+//     previous one, which adds another 1 or 2 cycles
+// Reads of SysTick->CNT return the modelled cycle count, GPIO input reads 0.
+// Intervals between the strobe edges are checked against the minimum tRCD,
+// tCAS and tRP in cycles (-t, default the rules of dram_rules.h, shared with
+// dram_trace). An interval that starts or ends in code allowed to break them
+// (-a, the tags of dram_trace: the modelled function or the one making the
+// store matches the tag's function) is counted as allowed. The exit status is
+// 1 if any other interval breaks a rule. -v traces every instruction.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "dram_rules.h"
+
+#define FLASH_BASE  0x00000000
+#define FLASH_SIZE  (16 * 1024)
+#define SRAM_BASE   0x20000000
+#define SRAM_SIZE   (2 * 1024)
+#define SYSTICK_CNT 0xE000F008
+
+#define RETURN_ADDR 0xFFFFFFF0  // ra of the modelled call, stops the run
+#define MAX_STEPS   1000000
+
+// ---------------------------------------------------------------------------
+// Disassembly
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    uint32_t addr;
+    uint8_t size;
+    char mnemonic[12];
+    char ops[4][24];
+    uint32_t target;        // branch/jump target, if printed
+    uint8_t nops;
+} instr_t;
+
+typedef struct {
+    uint32_t addr;
+    char name[64];
+} symbol_t;
+
+static instr_t *code;
+static size_t code_len, code_cap;
+static symbol_t *symbols;
+static size_t symbols_len, symbols_cap;
+
+static uint8_t flash[FLASH_SIZE];
+static uint8_t sram[SRAM_SIZE];
+
+static void add_symbol(uint32_t addr, const char *name) {
+    if (symbols_len == symbols_cap) {
+        symbols_cap = symbols_cap ? 2 * symbols_cap : 256;
+        symbols = realloc(symbols, symbols_cap * sizeof(*symbols));
+    }
+    symbols[symbols_len].addr = addr;
+    snprintf(symbols[symbols_len].name, sizeof(symbols[0].name), "%s", name);
+    symbols_len++;
+}
+
+static uint8_t *mem_ptr(uint32_t addr) {
+    if (addr - FLASH_BASE < FLASH_SIZE) {
+        return &flash[addr - FLASH_BASE];
+    }
+    if (addr - SRAM_BASE < SRAM_SIZE) {
+        return &sram[addr - SRAM_BASE];
+    }
+    return 0;
+}
+
+// "   a3c:	4501                	li	a0,0" (GNU) or
+// "     a3c: 01 45        	li	a0, 0x0" (LLVM)
+static int parse_instr(const char *line, instr_t *in) {
+    const char *p = line;
+    char *end;
+    int digits = 0;
+
+    while (*p == ' ') {
+        p++;
+    }
+    in->addr = strtoul(p, &end, 16);
+    if (end == p || *end != ':') {
+        return 0;
+    }
+    p = end + 1;
+    while (*p == ' ' || *p == '\t') {
+        p++;
+    }
+    // Encoding: hex digits in groups, up to the next tab
+    while (*p && *p != '\t') {
+        if (isxdigit((unsigned char)*p)) {
+            digits++;
+        } else if (*p != ' ') {
+            return 0;
+        }
+        p++;
+    }
+    if ((digits != 4 && digits != 8) || *p != '\t') {
+        return 0;
+    }
+    in->size = digits / 2;
+    p++;
+
+    // Mnemonic and comma separated operands
+    memset(in->mnemonic, 0, sizeof(in->mnemonic));
+    for (int i = 0; *p && !isspace((unsigned char)*p); p++) {
+        if (i < (int)sizeof(in->mnemonic) - 1) {
+            in->mnemonic[i++] = *p;
+        }
+    }
+    in->nops = 0;
+    in->target = 0;
+    while (*p && in->nops < 4) {
+        int i = 0;
+        while (*p == ' ' || *p == '\t' || *p == ',') {
+            p++;
+        }
+        if (!*p || *p == '<' || *p == '#' || *p == '\n' || *p == '\r') {
+            break;
+        }
+        while (*p && *p != ',' && !isspace((unsigned char)*p)) {
+            if (i < (int)sizeof(in->ops[0]) - 1) {
+                in->ops[in->nops][i++] = *p;
+            }
+            p++;
+        }
+        in->ops[in->nops][i] = 0;
+        in->nops++;
+    }
+    return 1;
+}
+
+// "00000a3c <dram_read_fpm>:"
+static int parse_symbol(const char *line) {
+    char name[64];
+    unsigned long addr;
+
+    if (sscanf(line, "%lx <%63[^>]>:", &addr, name) == 2) {
+        add_symbol(addr, name);
+        return 1;
+    }
+    return 0;
+}
+
+// " 20000000 01020102 00000000 01000000 00000000  ................"
+static void parse_contents(const char *line) {
+    char *end;
+    uint32_t addr = strtoul(line + 1, &end, 16);
+    const char *p = end + 1;
+
+    if (end == line + 1 || *end != ' ') {
+        return;
+    }
+    // Four groups of up to 8 hex digits in a fixed 35 column field
+    for (int col = 0; col + 1 < 35 && p[col]; ) {
+        if (p[col] == ' ') {
+            col++;
+            continue;
+        }
+        if (!isxdigit((unsigned char)p[col]) || !isxdigit((unsigned char)p[col + 1])) {
+            break;
+        }
+        char hex[3] = {p[col], p[col + 1], 0};
+        uint8_t *m = mem_ptr(addr++);
+        if (m) {
+            *m = strtoul(hex, 0, 16);
+        }
+        col += 2;
+    }
+}
+
+// Sections that are part of the memory image, not debug or symbol data
+static int loaded_section(const char *name) {
+    static const char *skip[] = {".debug", ".comment", ".riscv", ".sym", ".str", ".shstr", ".rel", ".note"};
+
+    for (size_t i = 0; i < sizeof(skip) / sizeof(skip[0]); i++) {
+        if (!strncmp(name, skip[i], strlen(skip[i]))) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int load_disassembly(const char *path) {
+    char line[512];
+    int contents = 0;
+    FILE *f = fopen(path, "r");
+
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        instr_t in;
+        if (!strncmp(line, "Contents of section", 19)) {
+            contents = loaded_section(line + 20);
+        } else if (!strncmp(line, "Disassembly of section", 22)) {
+            contents = 0;
+        } else if (contents && line[0] == ' ') {
+            parse_contents(line);
+        } else if (parse_symbol(line)) {
+        } else if (parse_instr(line, &in)) {
+            // Branch and jump targets are printed as the last hex operand
+            if (in.nops) {
+                char *end;
+                uint32_t target = strtoul(in.ops[in.nops - 1], &end, 16);
+                if (!*end) {
+                    in.target = target;
+                }
+            }
+            if (code_len == code_cap) {
+                code_cap = code_cap ? 2 * code_cap : 4096;
+                code = realloc(code, code_cap * sizeof(*code));
+            }
+            code[code_len++] = in;
+        }
+    }
+    fclose(f);
+    return 0;
+}
+
+static const instr_t *find_instr(uint32_t addr) {
+    size_t lo = 0, hi = code_len;
+
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (code[mid].addr < addr) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return (lo < code_len && code[lo].addr == addr) ? &code[lo] : 0;
+}
+
+static int cmp_instr(const void *a, const void *b) {
+    uint32_t x = ((const instr_t *)a)->addr, y = ((const instr_t *)b)->addr;
+    return x < y ? -1 : x > y;
+}
+
+static const symbol_t *find_symbol(const char *name) {
+    for (size_t i = 0; i < symbols_len; i++) {
+        if (!strcmp(symbols[i].name, name)) {
+            return &symbols[i];
+        }
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Interpreter
+// ---------------------------------------------------------------------------
+
+static const char *reg_names[16] = {
+    "zero", "ra", "sp", "gp", "tp", "t0", "t1", "t2", "s0", "s1", "a0", "a1", "a2", "a3", "a4", "a5"
+};
+
+typedef struct {
+    uint32_t x[16];
+    uint32_t pc;
+    uint64_t cycle;         // issue time of the next instruction
+    uint64_t fetch_base;    // flash: time the word at fetch_addr arrives
+    uint32_t fetch_addr;    // flash: word address the fetch restarted at
+    uint32_t outdr[2];      // address port, control port
+} cpu_t;
+
+// Strobe edges for the interval checks
+typedef struct {
+    uint64_t ras_fall, ras_rise, cas_fall;
+    int ras_fall_tag, ras_rise_tag, cas_fall_tag;
+    int ras_fall_seen, ras_rise_seen, cas_fall_seen;
+    int rcd_checked;
+} edges_t;
+
+static int limit_rcd = DRAM_RULE_RCD, limit_cas = DRAM_RULE_CAS, limit_rp = DRAM_RULE_RP;
+static int allow[DRAM_RULE_TAGS] = DRAM_RULE_ALLOW_DEFAULT;
+static int run_tag;         // tag of the modelled function
+static int verbose;
+static int violations, allowed, stores;
+static uint64_t start_cycle, last_store;
+static edges_t edges;
+static const char *error;
+
+static int reg_index(const char *s) {
+    if (!strcmp(s, "fp")) {
+        return 8;
+    }
+    if (s[0] == 'x' && isdigit((unsigned char)s[1])) {
+        int r = atoi(s + 1);
+        return r < 16 ? r : -1;
+    }
+    for (int i = 0; i < 16; i++) {
+        if (!strcmp(s, reg_names[i])) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int reg(cpu_t *c, const instr_t *in, int i, uint32_t *value) {
+    int r = i < in->nops ? reg_index(in->ops[i]) : -1;
+
+    if (r < 0) {
+        error = "bad register operand";
+        return -1;
+    }
+    *value = c->x[r];
+    return r;
+}
+
+static void set_reg(cpu_t *c, const instr_t *in, int i, uint32_t value) {
+    int r = i < in->nops ? reg_index(in->ops[i]) : -1;
+
+    if (r < 0) {
+        error = "bad register operand";
+    } else if (r) {
+        c->x[r] = value;
+    }
+}
+
+static int32_t imm(const instr_t *in, int i) {
+    if (i >= in->nops) {
+        error = "missing immediate";
+        return 0;
+    }
+    return (int32_t)strtol(in->ops[i], 0, 0);
+}
+
+// "16(sp)" -> address
+static uint32_t mem_addr(cpu_t *c, const instr_t *in, int i) {
+    char base[24];
+    long offset;
+    int r;
+
+    if (i >= in->nops || sscanf(in->ops[i], "%li(%23[^)])", &offset, base) != 2 || (r = reg_index(base)) < 0) {
+        error = "bad memory operand";
+        return 0;
+    }
+    return c->x[r] + (uint32_t)offset;
+}
+
+// Tag of the code a function belongs to, 0 for none
+static int func_tag(const char *name) {
+    for (size_t t = 1; t < DRAM_RULE_TAGS; t++) {
+        if (!strncmp(name, dram_rule_tag_funcs[t], strlen(dram_rule_tag_funcs[t]))) {
+            return (int)t;
+        }
+    }
+    return 0;
+}
+
+// Tag of the store at 'pc': the modelled function's, else that of the
+// function containing pc
+static int store_tag(uint32_t pc) {
+    const symbol_t *best = 0;
+
+    if (run_tag) {
+        return run_tag;
+    }
+    for (size_t i = 0; i < symbols_len; i++) {
+        if (symbols[i].addr <= pc && (!best || symbols[i].addr > best->addr)) {
+            best = &symbols[i];
+        }
+    }
+    return best ? func_tag(best->name) : 0;
+}
+
+static void check(const char *name, uint64_t from, int from_tag, uint64_t to, int to_tag, int limit) {
+    int cycles = (int)(to - from);
+
+    printf("  %s %d", name, cycles);
+    if (cycles >= limit) {
+        return;
+    }
+    if (allow[from_tag] || allow[to_tag]) {
+        printf(" < %d allowed (%s)", limit, dram_rule_tags[allow[to_tag] ? to_tag : from_tag]);
+        allowed++;
+    } else {
+        printf(" < %d VIOLATION", limit);
+        violations++;
+    }
+}
+
+// Record a store to a GPIO register at cycle 'now'
+static void gpio_store(cpu_t *c, uint32_t addr, uint32_t value, uint64_t now) {
+    int port = (addr & ~0x3FFu) == CTRL_GPIO_BASE;
+    uint32_t reg_offset = addr & 0x3FF;
+    uint32_t before = c->outdr[1], after;
+    const char *reg_name;
+
+    if (reg_offset == 0x0C) {
+        reg_name = "OUTDR";
+        c->outdr[port] = value & 0xFFFF;
+    } else if (reg_offset == 0x10) {
+        reg_name = "BSHR";
+        c->outdr[port] = (c->outdr[port] | (value & 0xFFFF)) & ~(value >> 16);
+    } else if (reg_offset == 0x14) {
+        reg_name = "BCR";
+        c->outdr[port] &= ~(value & 0xFFFF);
+    } else {
+        return; // configuration registers
+    }
+    after = c->outdr[1];
+    stores++;
+
+    printf("%8llu %+6lld  %08x  GPIO%s->%-5s = 0x%08x ", (unsigned long long)(now - start_cycle),
+           stores > 1 ? (long long)(now - last_store) : 0LL, c->pc, port ? GPIO_NAME(DRAM_CTRL_GPIO) : GPIO_NAME(DRAM_ADDR_GPIO), reg_name, value);
+    last_store = now;
+    if (!port) {
+        printf(" A=0x%02x", c->outdr[0] & 0xFF);
+    } else {
+        uint32_t changed = before ^ after;
+        int tag = store_tag(c->pc);
+        if (changed & PIN_RAS) {
+            printf(" RAS %s", after & PIN_RAS ? "high" : "low");
+        }
+        if (changed & PIN_CAS) {
+            printf(" CAS %s", after & PIN_CAS ? "high" : "low");
+        }
+        if (changed & PIN_WR) {
+            printf(" W %s", after & PIN_WR ? "high" : "low");
+        }
+        if (changed & PIN_DIN) {
+            printf(" DIN %d", after & PIN_DIN ? 1 : 0);
+        }
+
+        // tRP: RAS high until RAS low
+        if ((changed & PIN_RAS) && !(after & PIN_RAS)) {
+            if (edges.ras_rise_seen) {
+                check("tRP", edges.ras_rise, edges.ras_rise_tag, now, tag, limit_rp);
+            }
+            edges.ras_fall = now;
+            edges.ras_fall_tag = tag;
+            edges.ras_fall_seen = 1;
+            edges.rcd_checked = 0;
+        }
+        if ((changed & PIN_RAS) && (after & PIN_RAS)) {
+            edges.ras_rise = now;
+            edges.ras_rise_tag = tag;
+            edges.ras_rise_seen = 1;
+        }
+        // tRCD: RAS low until the first CAS low, tCAS: CAS low until CAS high
+        if ((changed & PIN_CAS) && !(after & PIN_CAS)) {
+            if (!(after & PIN_RAS) && edges.ras_fall_seen && !edges.rcd_checked) {
+                check("tRCD", edges.ras_fall, edges.ras_fall_tag, now, tag, limit_rcd);
+                edges.rcd_checked = 1;
+            }
+            edges.cas_fall = now;
+            edges.cas_fall_tag = tag;
+            edges.cas_fall_seen = 1;
+        }
+        if ((changed & PIN_CAS) && (after & PIN_CAS) && edges.cas_fall_seen) {
+            check("tCAS", edges.cas_fall, edges.cas_fall_tag, now, tag, limit_cas);
+        }
+    }
+    printf("\n");
+}
+
+static uint32_t load(cpu_t *c, uint32_t addr, int size, int sign) {
+    uint8_t *m = mem_ptr(addr);
+    uint32_t value = 0;
+
+    if (addr == SYSTICK_CNT) {
+        return (uint32_t)c->cycle;
+    }
+    if (!m) {
+        return 0; // peripherals, including GPIO inputs
+    }
+    for (int i = 0; i < size; i++) {
+        value |= (uint32_t)m[i] << (8 * i);
+    }
+    if (sign && size < 4 && (value >> (8 * size - 1)) & 1) {
+        value |= ~0u << (8 * size);
+    }
+    return value;
+}
+
+static void store(cpu_t *c, uint32_t addr, uint32_t value, int size) {
+    uint8_t *m = mem_ptr(addr);
+
+    if (addr >= GPIO_BASE_A && addr < GPIO_END) {
+        gpio_store(c, addr, value, c->cycle);
+    } else if (m) {
+        for (int i = 0; i < size; i++) {
+            m[i] = value >> (8 * i);
+        }
+    }
+}
+
+static int is_flash(uint32_t addr) {
+    return addr - FLASH_BASE < FLASH_SIZE;
+}
+
+// Time instruction 'in' can issue, given the flash fetch state
+static uint64_t fetch_ready(cpu_t *c, const instr_t *in) {
+    uint32_t last_word = (in->addr + in->size - 1) & ~3u;
+
+    if (!is_flash(in->addr) || last_word < c->fetch_addr) {
+        return c->cycle;
+    }
+    uint64_t ready = c->fetch_base + 2 * ((last_word - c->fetch_addr) / 4);
+    return ready > c->cycle ? ready : c->cycle;
+}
+
+// Taken branch or jump: 2 cycle pipeline flush, and a flash fetch restarts on
+// the 2 cycle grid of the previous one
+static void redirect(cpu_t *c, uint32_t target) {
+    uint64_t ready = c->cycle + 2;
+
+    if (is_flash(target)) {
+        ready += 1;
+        if ((ready - c->fetch_base) & 1) {
+            ready++;
+        }
+        c->fetch_base = ready;
+        c->fetch_addr = target & ~3u;
+    }
+    c->cycle = ready;
+    c->pc = target;
+}
+
+static int branch(const char *m, uint32_t a, uint32_t b) {
+    if (!strcmp(m, "beq")) return a == b;
+    if (!strcmp(m, "bne")) return a != b;
+    if (!strcmp(m, "blt")) return (int32_t)a < (int32_t)b;
+    if (!strcmp(m, "bge")) return (int32_t)a >= (int32_t)b;
+    if (!strcmp(m, "bltu")) return a < b;
+    if (!strcmp(m, "bgeu")) return a >= b;
+    if (!strcmp(m, "bgt")) return (int32_t)a > (int32_t)b;
+    if (!strcmp(m, "ble")) return (int32_t)a <= (int32_t)b;
+    if (!strcmp(m, "bgtu")) return a > b;
+    if (!strcmp(m, "bleu")) return a <= b;
+    return -1;
+}
+
+static uint32_t alu(const char *m, uint32_t a, uint32_t b) {
+    if (!strcmp(m, "add")) return a + b;
+    if (!strcmp(m, "sub")) return a - b;
+    if (!strcmp(m, "and")) return a & b;
+    if (!strcmp(m, "or")) return a | b;
+    if (!strcmp(m, "xor")) return a ^ b;
+    if (!strcmp(m, "sll")) return a << (b & 31);
+    if (!strcmp(m, "srl")) return a >> (b & 31);
+    if (!strcmp(m, "sra")) return (uint32_t)((int32_t)a >> (b & 31));
+    if (!strcmp(m, "slt")) return (int32_t)a < (int32_t)b;
+    if (!strcmp(m, "sltu")) return a < b;
+    error = "unsupported instruction";
+    return 0;
+}
+
+// Register-immediate forms: the register-register operation, or 0
+static const char *immediate_op(const char *m) {
+    static const char *ops[][2] = {
+        {"addi", "add"}, {"andi", "and"}, {"ori", "or"}, {"xori", "xor"}, {"slli", "sll"},
+        {"srli", "srl"}, {"srai", "sra"}, {"slti", "slt"}, {"sltiu", "sltu"}
+    };
+    for (size_t i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+        if (!strcmp(m, ops[i][0])) {
+            return ops[i][1];
+        }
+    }
+    return 0;
+}
+
+// Execute one instruction and advance the cycle count
+static void step(cpu_t *c) {
+    const instr_t *in = find_instr(c->pc);
+    const char *m;
+    uint32_t a = 0, b = 0, next;
+    size_t len;
+
+    if (!in) {
+        error = "no instruction at pc";
+        return;
+    }
+    c->cycle = fetch_ready(c, in);
+    if (verbose) {
+        printf("%8llu          %08x  %s", (unsigned long long)(c->cycle - start_cycle), in->addr, in->mnemonic);
+        for (int i = 0; i < in->nops; i++) {
+            printf("%s%s", i ? "," : " ", in->ops[i]);
+        }
+        printf("\n");
+    }
+    m = in->mnemonic;
+    if (!strncmp(m, "c.", 2)) {
+        m += 2;
+    }
+    len = strlen(m);
+    next = c->pc + in->size;
+
+    // Loads and stores: 2 cycles on the shared bus
+    if (!strcmp(m, "lb") || !strcmp(m, "lh") || !strcmp(m, "lw") || !strcmp(m, "lbu") || !strcmp(m, "lhu")) {
+        int size = m[1] == 'b' ? 1 : m[1] == 'h' ? 2 : 4;
+        set_reg(c, in, 0, load(c, mem_addr(c, in, 1), size, len == 2));
+        c->cycle += 2;
+        c->pc = next;
+        return;
+    }
+    if (!strcmp(m, "sb") || !strcmp(m, "sh") || !strcmp(m, "sw")) {
+        reg(c, in, 0, &a);
+        store(c, mem_addr(c, in, 1), a, m[1] == 'b' ? 1 : m[1] == 'h' ? 2 : 4);
+        c->cycle += 2;
+        c->pc = next;
+        return;
+    }
+
+    c->cycle += 1;
+
+    // Branches, with the zero compare forms
+    if (m[0] == 'b') {
+        char cmp[8];
+        int taken;
+        reg(c, in, 0, &a);
+        if (len > 1 && m[len - 1] == 'z') {
+            static const char *zero_forms[][2] = {
+                {"beqz", "beq"}, {"bnez", "bne"}, {"bltz", "blt"}, {"bgez", "bge"}, {"blez", "ble"}, {"bgtz", "bgt"}
+            };
+            cmp[0] = 0;
+            for (int i = 0; i < 6; i++) {
+                if (!strcmp(m, zero_forms[i][0])) {
+                    strcpy(cmp, zero_forms[i][1]);
+                }
+            }
+            b = 0;
+        } else {
+            snprintf(cmp, sizeof(cmp), "%s", m);
+            reg(c, in, 1, &b);
+        }
+        taken = branch(cmp, a, b);
+        if (taken < 0) {
+            error = "unsupported instruction";
+        } else if (taken) {
+            redirect(c, in->target);
+        } else {
+            c->pc = next;
+        }
+        return;
+    }
+
+    // Jumps
+    if (!strcmp(m, "j")) {
+        redirect(c, in->target);
+        return;
+    }
+    if (!strcmp(m, "jal")) {
+        if (in->nops == 2) {
+            set_reg(c, in, 0, next);
+        } else {
+            c->x[1] = next;
+        }
+        redirect(c, in->target);
+        return;
+    }
+    if (!strcmp(m, "ret") || !strcmp(m, "jr") || !strcmp(m, "jalr")) {
+        uint32_t target;
+        int link = !strcmp(m, "jalr");
+        if (!strcmp(m, "ret")) {
+            target = c->x[1];
+        } else if (in->nops == 1 && strchr(in->ops[0], '(')) {
+            target = mem_addr(c, in, 0);                // jalr 0(a5)
+        } else if (in->nops == 2) {
+            target = mem_addr(c, in, 1);                // jalr ra,0(a5)
+            link = reg_index(in->ops[0]);
+        } else {
+            reg(c, in, 0, &target);
+            if (in->nops == 3) {                        // jalr ra,a5,0
+                link = reg_index(in->ops[0]);
+                reg(c, in, 1, &target);
+                target += imm(in, 2);
+            }
+        }
+        if (link > 0) {
+            c->x[link] = next;
+        }
+        redirect(c, target & ~1u);
+        return;
+    }
+
+    c->pc = next;
+    if (!strcmp(m, "nop") || !strcmp(m, "fence") || !strcmp(m, "wfi") || !strncmp(m, "csr", 3)) {
+        if (!strncmp(m, "csrr", 4) && in->nops == 2) {
+            set_reg(c, in, 0, 0);
+        }
+        return;
+    }
+    if (!strcmp(m, "li")) {
+        set_reg(c, in, 0, imm(in, 1));
+    } else if (!strcmp(m, "lui")) {
+        set_reg(c, in, 0, (uint32_t)imm(in, 1) << 12);
+    } else if (!strcmp(m, "auipc")) {
+        set_reg(c, in, 0, in->addr + ((uint32_t)imm(in, 1) << 12));
+    } else if (!strcmp(m, "mv")) {
+        reg(c, in, 1, &a);
+        set_reg(c, in, 0, a);
+    } else if (!strcmp(m, "not") || !strcmp(m, "neg") || !strcmp(m, "seqz") || !strcmp(m, "snez") ||
+               !strcmp(m, "sltz") || !strcmp(m, "sgtz")) {
+        reg(c, in, 1, &a);
+        set_reg(c, in, 0, m[0] == 'n' ? (m[1] == 'o' ? ~a : -a) :
+                          !strcmp(m, "seqz") ? a == 0 : !strcmp(m, "snez") ? a != 0 :
+                          !strcmp(m, "sltz") ? (int32_t)a < 0 : (int32_t)a > 0);
+    } else if (!strcmp(m, "zext.b")) {
+        reg(c, in, 1, &a);
+        set_reg(c, in, 0, a & 0xFF);
+    } else if (immediate_op(m)) {
+        reg(c, in, 1, &a);
+        set_reg(c, in, 0, alu(immediate_op(m), a, imm(in, 2)));
+    } else {
+        reg(c, in, 1, &a);
+        reg(c, in, 2, &b);
+        set_reg(c, in, 0, alu(m, a, b));
+    }
+}
+
+// Run 'name' with up to six arguments and report its GPIO stores
+static int run(const char *name, const uint32_t *args, int nargs) {
+    const symbol_t *sym = find_symbol(name);
+    cpu_t c;
+    int steps = 0;
+
+    if (!sym) {
+        fprintf(stderr, "%s: not in the disassembly\n", name);
+        return -1;
+    }
+    memset(&c, 0, sizeof(c));
+    for (int i = 0; i < nargs && i < 6; i++) {
+        c.x[10 + i] = args[i];
+    }
+    c.x[1] = RETURN_ADDR;
+    c.x[2] = SRAM_BASE + SRAM_SIZE;
+    c.pc = sym->addr;
+    c.fetch_addr = sym->addr & ~3u;
+    c.outdr[1] = PIN_RAS | PIN_CAS | PIN_WR;   // idle levels
+    start_cycle = 0;
+    memset(&edges, 0, sizeof(edges));
+    violations = 0;
+    allowed = 0;
+    run_tag = func_tag(name);
+    stores = 0;
+    error = 0;
+
+    printf("%s(", name);
+    for (int i = 0; i < nargs; i++) {
+        printf("%s0x%x", i ? ", " : "", args[i]);
+    }
+    printf(")  [%s]\n", is_flash(sym->addr) ? "flash" : "SRAM");
+    printf("   cycle  delta  pc        store\n");
+
+    while (c.pc != RETURN_ADDR && !error) {
+        if (++steps > MAX_STEPS) {
+            error = "no return after MAX_STEPS instructions";
+            break;
+        }
+        step(&c);
+    }
+    if (error) {
+        const instr_t *in = find_instr(c.pc);
+        fprintf(stderr, "%s: %s at 0x%08x (%s)\n", name, error, c.pc, in ? in->mnemonic : "?");
+        return -1;
+    }
+    printf("%d stores, %llu cycles, %d violations, %d allowed\n\n", stores, (unsigned long long)c.cycle, violations,
+           allowed);
+    return violations;
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: dram_timing_model [-t rcd,cas,rp] [-a tags] [-v] main.dis [function [arg ...]]\n");
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    int i = 1;
+
+    for (; i < argc && argv[i][0] == '-'; i++) {
+        if (!strcmp(argv[i], "-v")) {
+            verbose = 1;
+        } else if (!strcmp(argv[i], "-t") && i + 1 < argc) {
+            if (sscanf(argv[++i], "%d,%d,%d", &limit_rcd, &limit_cas, &limit_rp) != 3) {
+                usage();
+            }
+        } else if (!strcmp(argv[i], "-a") && i + 1 < argc) {
+            if (dram_rule_parse_allow(argv[++i], allow) < 0) {
+                usage();
+            }
+        } else {
+            usage();
+        }
+    }
+    if (i >= argc) {
+        usage();
+    }
+    if (load_disassembly(argv[i++]) < 0) {
+        return 1;
+    }
+    qsort(code, code_len, sizeof(*code), cmp_instr);
+
+    if (i < argc) {
+        uint32_t args[6];
+        const char *name = argv[i++];
+        int nargs = 0;
+        for (; i < argc && nargs < 6; i++) {
+            args[nargs++] = strtoul(argv[i], 0, 0);
+        }
+        return run(name, args, nargs) != 0;
+    }
+
+    static const uint32_t read_args[] = {0x55, 0, 8};
+    static const uint32_t write_args[] = {0x55, 0, 0xA5, 8};
+    static const uint32_t copy_args[] = {1, 2};
+    int failed = 0;
+    failed |= run("dram_read_fpm", read_args, 3) != 0;
+    failed |= run("dram_write_fpm", write_args, 4) != 0;
+    failed |= run("dram_copyrow", copy_args, 2) != 0;
+    return failed;
+}
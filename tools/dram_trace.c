@@ -0,0 +1,333 @@
+// Check GPIO traces (src/dram_trace.h) against the DRAM timing rules and
+// export them as VCD
+//
+//   dram_trace [-n index] [-o out.vcd] [-t rcd,cas,rp,ras_max,wr] [-a tags] capture.bin
+//
+// The capture is a recording of the debug output with DRAM_TRACE_FRAME
+// frames in it (tools/Makefile records one from the simulator). Frame 0
+// starts a trace; -n picks one when there are several (default: the last).
+//
+// Rules, in cycles at 48 MHz (-t, default the DRAM_RULE_* values of
+// dram_rules.h, shared with dram_timing_model):
+//   tRCD    RAS low to the first CAS low                      >= rcd
+//   tCAS    CAS low to CAS high, while RAS is low             >= cas
+//   tRP     RAS high to RAS low                               >= rp
+//   tRAS    RAS low to RAS high                               <= ras_max (10 us)
+//   tWR     last write (CAS low with W low) to RAS high       >= wr
+// An interval that starts or ends in code tagged with one of the -a tags
+// (default copyrow,set_row,triple,timing; "none" for none) is counted as
+// allowed. The exit status is 1 if any other interval breaks a rule.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/dram_dump.h"
+#include "../src/dram_trace.h"
+#include "dram_rules.h"
+
+#define CLOCK_HZ 48000000
+#define MAX_REPORTED 20
+
+typedef struct {
+    uint64_t cycle;     // unwrapped
+    uint8_t addr, ctrl, tag;
+} event_t;
+
+#define TAG_COUNT DRAM_RULE_TAGS
+
+enum { RULE_RCD, RULE_CAS, RULE_RP, RULE_RAS, RULE_WR, RULES };
+
+typedef struct {
+    const char *name;
+    int is_max;         // the limit is a maximum
+    long limit;
+    long checked, min, max, violations, allowed;
+} rule_t;
+
+static rule_t rules[RULES] = {
+    {"tRCD", 0, DRAM_RULE_RCD, 0, 0, 0, 0, 0},
+    {"tCAS", 0, DRAM_RULE_CAS, 0, 0, 0, 0, 0},
+    {"tRP", 0, DRAM_RULE_RP, 0, 0, 0, 0, 0},
+    {"tRAS", 1, DRAM_RULE_RAS_MAX, 0, 0, 0, 0, 0},
+    {"tWR", 0, DRAM_RULE_WR, 0, 0, 0, 0, 0},
+};
+static int allow[TAG_COUNT] = DRAM_RULE_ALLOW_DEFAULT;
+static int reported;
+
+static const char *tag_name(uint8_t tag) {
+    return tag < TAG_COUNT ? dram_rule_tags[tag] : "?";
+}
+
+// Check the interval from 'from' to 'to' against rule r
+static void check(int r, const event_t *from, const event_t *to, uint64_t base) {
+    rule_t *rule = &rules[r];
+    long cycles = (long)(to->cycle - from->cycle);
+
+    if (!rule->checked || cycles < rule->min) {
+        rule->min = cycles;
+    }
+    if (!rule->checked || cycles > rule->max) {
+        rule->max = cycles;
+    }
+    rule->checked++;
+    if (rule->is_max ? cycles <= rule->limit : cycles >= rule->limit) {
+        return;
+    }
+    if (allow[from->tag < TAG_COUNT ? from->tag : 0] || allow[to->tag < TAG_COUNT ? to->tag : 0]) {
+        rule->allowed++;
+        return;
+    }
+    rule->violations++;
+    if (reported++ < MAX_REPORTED) {
+        printf("VIOLATION %-4s %5ld %s %ld at cycle %llu (A=0x%02x, %s)\n", rule->name, cycles,
+               rule->is_max ? ">" : "<", rule->limit, (unsigned long long)(to->cycle - base), to->addr,
+               tag_name(to->tag));
+    }
+}
+
+static void check_trace(const event_t *ev, size_t n) {
+    const event_t *ras_fall = 0, *ras_rise = 0, *cas_fall = 0, *last_write = 0;
+    int rcd_pending = 0;
+
+    for (size_t i = 1; i < n; i++) {
+        uint8_t before = ev[i - 1].ctrl, after = ev[i].ctrl;
+        uint8_t fall = before & ~after, rise = ~before & after;
+        const event_t *e = &ev[i];
+
+        if (fall & PIN_RAS) {
+            if (ras_rise) {
+                check(RULE_RP, ras_rise, e, ev[0].cycle);
+            }
+            ras_fall = e;
+            rcd_pending = 1;
+            last_write = 0;
+        }
+        if ((fall & PIN_CAS) && !(after & PIN_RAS)) {
+            if (rcd_pending && ras_fall) {
+                check(RULE_RCD, ras_fall, e, ev[0].cycle);
+            }
+            rcd_pending = 0;
+            cas_fall = e;
+            if (!(after & PIN_WR)) {
+                last_write = e;     // early write
+            }
+        }
+        if ((fall & PIN_WR) && !(after & PIN_CAS) && !(after & PIN_RAS)) {
+            last_write = e;         // late write
+        }
+        if ((rise & PIN_CAS) && cas_fall && !(before & PIN_RAS)) {
+            check(RULE_CAS, cas_fall, e, ev[0].cycle);
+            cas_fall = 0;
+        }
+        if (rise & PIN_RAS) {
+            if (ras_fall) {
+                check(RULE_RAS, ras_fall, e, ev[0].cycle);
+            }
+            if (last_write) {
+                check(RULE_WR, last_write, e, ev[0].cycle);
+            }
+            ras_rise = e;
+            ras_fall = 0;
+            cas_fall = 0;
+            last_write = 0;
+            rcd_pending = 0;
+        }
+    }
+}
+
+static void vcd_bits(FILE *f, uint8_t value, char id) {
+    fputc('b', f);
+    for (int b = 7; b >= 0; b--) {
+        fputc('0' + ((value >> b) & 1), f);
+    }
+    fprintf(f, " %c\n", id);
+}
+
+static int write_vcd(const char *path, const event_t *ev, size_t n) {
+    static const struct { uint8_t pin; char id; const char *name; } pins[] = {
+        {PIN_RAS, 'r', "RAS"}, {PIN_CAS, 'c', "CAS"}, {PIN_WR, 'w', "W"}, {PIN_DIN, 'd', "DIN"}
+    };
+    FILE *f = fopen(path, "w");
+
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    fprintf(f, "$timescale 1 ps $end\n$scope module dram $end\n");
+    for (size_t p = 0; p < 4; p++) {
+        fprintf(f, "$var wire 1 %c %s $end\n", pins[p].id, pins[p].name);
+    }
+    fprintf(f, "$var wire 8 a A $end\n$var wire 8 t tag $end\n$upscope $end\n$enddefinitions $end\n");
+    for (size_t i = 0; i < n; i++) {
+        uint64_t ps = (ev[i].cycle - ev[0].cycle) * 1000000000000ULL / CLOCK_HZ;
+        fprintf(f, "#%llu\n", (unsigned long long)ps);
+        for (size_t p = 0; p < 4; p++) {
+            if (!i || ((ev[i].ctrl ^ ev[i - 1].ctrl) & pins[p].pin)) {
+                fprintf(f, "%c%c\n", (ev[i].ctrl & pins[p].pin) ? '1' : '0', pins[p].id);
+            }
+        }
+        if (!i || ev[i].addr != ev[i - 1].addr) {
+            vcd_bits(f, ev[i].addr, 'a');
+        }
+        if (!i || ev[i].tag != ev[i - 1].tag) {
+            vcd_bits(f, ev[i].tag, 't');
+        }
+    }
+    return fclose(f);
+}
+
+// 1 if a complete frame with a good CRC starts at buf[at]
+static int frame_ok(const uint8_t *buf, size_t size, size_t at) {
+    uint16_t crc = 0xFFFF;
+    size_t len;
+
+    if (at + 5 > size || buf[at] != DRAM_DUMP_SYNC0 || buf[at + 1] != DRAM_DUMP_SYNC1) {
+        return 0;
+    }
+    len = buf[at + 4];
+    if (at + DRAM_DUMP_OVERHEAD + len > size) {
+        return 0;
+    }
+    for (size_t i = at + 2; i < at + 5 + len; i++) {
+        crc = dram_dump_crc16(crc, buf[i]);
+    }
+    return buf[at + 5 + len] == (crc & 0xFF) && buf[at + 6 + len] == (crc >> 8);
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: dram_trace [-n index] [-o out.vcd] [-t rcd,cas,rp,ras_max,wr] [-a tags] capture.bin\n");
+    exit(2);
+}
+
+int main(int argc, char **argv) {
+    const char *in_path = NULL, *vcd_path = NULL;
+    event_t *ev = NULL;
+    size_t n = 0, cap = 0, chosen_start = 0, chosen_end = 0, start = 0;
+    int wanted = -1, traces = 0, found = 0;
+    long bad_frames = 0;
+    uint8_t *buf;
+    size_t size;
+    FILE *f;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+            wanted = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-o") && i + 1 < argc) {
+            vcd_path = argv[++i];
+        } else if (!strcmp(argv[i], "-t") && i + 1 < argc) {
+            if (sscanf(argv[++i], "%ld,%ld,%ld,%ld,%ld", &rules[RULE_RCD].limit, &rules[RULE_CAS].limit,
+                       &rules[RULE_RP].limit, &rules[RULE_RAS].limit, &rules[RULE_WR].limit) != 5) {
+                usage();
+            }
+        } else if (!strcmp(argv[i], "-a") && i + 1 < argc) {
+            if (dram_rule_parse_allow(argv[++i], allow) < 0) {
+                usage();
+            }
+        } else if (!in_path) {
+            in_path = argv[i];
+        } else {
+            usage();
+        }
+    }
+    if (!in_path) {
+        usage();
+    }
+
+    f = fopen(in_path, "rb");
+    if (!f) {
+        perror(in_path);
+        return 2;
+    }
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    buf = malloc(size ? size : 1);
+    if (fread(buf, 1, size, f) != size) {
+        perror(in_path);
+        return 2;
+    }
+    fclose(f);
+
+    // Collect the events of all traces, remembering where each one starts
+    for (size_t at = 0; at < size;) {
+        uint8_t len;
+        const uint8_t *payload;
+
+        if (!frame_ok(buf, size, at)) {
+            if (buf[at] == DRAM_DUMP_SYNC0 && at + 3 < size && buf[at + 1] == DRAM_DUMP_SYNC1 &&
+                buf[at + 2] == DRAM_TRACE_FRAME) {
+                bad_frames++;
+            }
+            at++;
+            continue;
+        }
+        len = buf[at + 4];
+        payload = buf + at + 5;
+        if (buf[at + 2] != DRAM_TRACE_FRAME) {
+            at += DRAM_DUMP_OVERHEAD + len;
+            continue;
+        }
+        if (buf[at + 3] == 0) {
+            if (traces && (wanted < 0 || wanted == traces - 1)) {
+                chosen_start = start;
+                chosen_end = n;
+                found = 1;
+            }
+            start = n;
+            traces++;
+        }
+        for (int i = 0; i + DRAM_TRACE_EVENT_BYTES <= len; i += DRAM_TRACE_EVENT_BYTES) {
+            uint32_t cycle = payload[i] | (payload[i + 1] << 8) | (payload[i + 2] << 16) | ((uint32_t)payload[i + 3] << 24);
+            if (n == cap) {
+                cap = cap ? 2 * cap : 1024;
+                ev = realloc(ev, cap * sizeof(*ev));
+            }
+            // Unwrap the 32 bit cycle counter
+            ev[n].cycle = cycle;
+            if (n > start) {
+                uint64_t prev = ev[n - 1].cycle;
+                ev[n].cycle = (prev & ~0xFFFFFFFFULL) | cycle;
+                if (ev[n].cycle < prev) {
+                    ev[n].cycle += 1ULL << 32;
+                }
+            }
+            ev[n].addr = payload[i + 4];
+            ev[n].ctrl = payload[i + 5];
+            ev[n].tag = payload[i + 6];
+            n++;
+        }
+        at += DRAM_DUMP_OVERHEAD + len;
+    }
+    if (traces && (wanted < 0 || wanted == traces - 1)) {
+        chosen_start = start;
+        chosen_end = n;
+        found = 1;
+    }
+    if (!found || chosen_end == chosen_start) {
+        fprintf(stderr, "%s: no trace%s (%d found, %ld bad frames)\n", in_path, wanted >= 0 ? " with that index" : "",
+                traces, bad_frames);
+        return 2;
+    }
+
+    ev += chosen_start;
+    n = chosen_end - chosen_start;
+    printf("trace %d of %d: %zu pin changes in %llu cycles, %ld bad frames\n", wanted >= 0 ? wanted : traces - 1, traces,
+           n, (unsigned long long)(ev[n - 1].cycle - ev[0].cycle), bad_frames);
+    if (vcd_path && write_vcd(vcd_path, ev, n) < 0) {
+        return 2;
+    }
+
+    check_trace(ev, n);
+    if (reported > MAX_REPORTED) {
+        printf("... %d more\n", reported - MAX_REPORTED);
+    }
+    printf("rule   limit  checked    min    max  violations  allowed\n");
+    long violations = 0;
+    for (int r = 0; r < RULES; r++) {
+        printf("%-5s %s%4ld  %7ld  %5ld  %5ld  %10ld  %7ld\n", rules[r].name, rules[r].is_max ? "<=" : ">=",
+               rules[r].limit, rules[r].checked, rules[r].min, rules[r].max, rules[r].violations, rules[r].allowed);
+        violations += rules[r].violations;
+    }
+    return violations ? 1 : 0;
+}